@@ -20,7 +20,414 @@
     SOFTWARE.
 */
 
+#pragma once
 #include"../NumberTheory/BigInt/bigint.hpp"
+#include"../NumberTheory/GCD/GCD.h"
+#include"../NumberTheory/ModContext/ModContext.h"
+#include"../NumberTheory/PrimeFactorization/PrimeFactorization.h"
+
+// 组合数取模：预处理一次，之后每次查询不再重复计算阶乘
+// 素数模数用阶乘与阶乘逆元表，n 超过模数时用 Lucas 定理；素数幂模数用 Granville 的推广；任意模数按素数幂分解后用中国剩余定理合并
+
+// 一个字的模乘，模数不超过 32 位时直接用 64 位乘法
+inline uint64_t binomialMultiply(uint64_t a, uint64_t b, uint64_t mod) {
+	return mod <= UINT32_MAX ? a * b % mod : mulmod(a, b, mod);
+}
+
+// 素数模数 p：表长 min(size, p)，n 小于表长时 C、A 都是 O(1)；
+// 表长达到 p 时任意 n 都可以查询，n >= p 时按 p 进制逐位用 Lucas 定理，O(log_p n)
+class BinomialTable {
+	private:
+		uint64_t modulus;
+		std::vector<uint64_t> factorials; // i! mod p
+		std::vector<uint64_t> inverseFactorials; // (i!)^(-1) mod p
+		
+		uint64_t multiply(uint64_t a, uint64_t b) const {
+			return binomialMultiply(a, b, modulus);
+		}
+		
+		// 查表要求 k <= n < 表长
+		uint64_t direct(uint64_t n, uint64_t k) const {
+			return multiply(factorials[n], multiply(inverseFactorials[k], inverseFactorials[n - k]));
+		}
+		
+		void checkRange(uint64_t n) const {
+			if (n >= factorials.size() && factorials.size() < modulus)
+				throw std::out_of_range("BinomialTable is too small for this n");
+		}
+		
+	public:
+		BinomialTable(uint64_t size, uint64_t modulus) : modulus(modulus) {
+			if (!isPrimeWord(modulus))
+				throw std::runtime_error("BinomialTable modulus must be prime");
+				
+			size_t length = static_cast<size_t>(std::max<uint64_t>(std::min(size, modulus), 1));
+			factorials.resize(length);
+			inverseFactorials.resize(length);
+			factorials[0] = 1;
+			
+			for (size_t i = 1; i < length; i++)
+				factorials[i] = multiply(factorials[i - 1], i);
+				
+			// 只做一次求逆（费马小定理），其余由 (i - 1)!^(-1) = i!^(-1) * i 倒推
+			inverseFactorials[length - 1] = powmod(factorials[length - 1], modulus - 2, modulus);
+			
+			for (size_t i = length - 1; i > 0; i--)
+				inverseFactorials[i - 1] = multiply(inverseFactorials[i], i);
+		}
+		
+		uint64_t getModulus() const {
+			return modulus;
+		}
+		
+		uint64_t factorial(uint64_t n) const {
+			if (n >= modulus)
+				return 0;
+				
+			checkRange(n);
+			return factorials[n];
+		}
+		
+		// 组合数 C(n, k) mod p
+		uint64_t C(uint64_t n, uint64_t k) const {
+			if (k > n)
+				return 0;
+				
+			if (n < factorials.size())
+				return direct(n, k);
+				
+			checkRange(n);
+			uint64_t result = 1;
+			
+			// Lucas 定理：C(n, k) ≡ Π C(n_i, k_i)，n_i、k_i 为 p 进制下的各位
+			while (n != 0) {
+				uint64_t ni = n % modulus;
+				uint64_t ki = k % modulus;
+				
+				if (ki > ni)
+					return 0;
+					
+				result = multiply(result, direct(ni, ki));
+				n /= modulus;
+				k /= modulus;
+			}
+			
+			return result;
+		}
+		
+		// 排列数 A(n, k) = n! / (n - k)! mod p
+		uint64_t A(uint64_t n, uint64_t k) const {
+			if (k > n)
+				return 0;
+				
+			if (n < factorials.size())
+				return multiply(factorials[n], inverseFactorials[n - k]);
+				
+			return multiply(C(n, k), factorial(k));
+		}
+};
+
+// 素数幂模数 q = p^e（Granville）：记 F(n) 为 n! 去掉全部因子 p 后模 q 的值，
+// 以 q 为周期预处理与 p 互素的数的前缀积，F(n) = (周期积)^(n / q) * 前缀积[n mod q] * F(n / p)，
+// C(n, k) = p^v * F(n) / (F(k) F(n - k))，v 由 Legendre 公式得到，v >= e 时为 0；每次查询 O(log_p n)
+// 前缀积表长 min(size, q)：表长达到 q 时任意 n 都可以查询，否则 n 要小于 size
+class PrimePowerBinomial {
+	private:
+		uint64_t prime;
+		uint64_t exponent;
+		uint64_t modulus;
+		std::vector<uint64_t> units; // units[i] = [1, i] 内与 p 互素的数之积 mod q
+		std::vector<uint64_t> inverseUnits; // units[i] 的逆元
+		
+		uint64_t multiply(uint64_t a, uint64_t b) const {
+			return binomialMultiply(a, b, modulus);
+		}
+		
+		void checkRange(uint64_t n) const {
+			if (n >= units.size() && units.size() < modulus)
+				throw std::out_of_range("PrimePowerBinomial is too small for this n");
+		}
+		
+		// F(n) 或 F(n)^(-1)；周期积为 ±1，只看 n / q 的奇偶
+		uint64_t reducedFactorial(uint64_t n, const std::vector<uint64_t>& table) const {
+			uint64_t result = 1 % modulus;
+			
+			for (; n != 0; n /= prime) {
+				if ((n / modulus) % 2 == 1)
+					result = multiply(result, table[modulus - 1]);
+					
+				result = multiply(result, table[n % modulus]);
+			}
+			
+			return result;
+		}
+		
+		// n! 中 p 的次数
+		uint64_t legendre(uint64_t n) const {
+			uint64_t count = 0;
+			
+			for (n /= prime; n != 0; n /= prime)
+				count += n;
+				
+			return count;
+		}
+		
+		// p^v mod q，v >= e 时为 0
+		uint64_t primePower(uint64_t v) const {
+			if (v >= exponent)
+				return 0;
+				
+			uint64_t result = 1;
+			
+			for (uint64_t i = 0; i < v; i++)
+				result *= prime;
+				
+			return result % modulus;
+		}
+		
+	public:
+		PrimePowerBinomial(uint64_t size, uint64_t prime, uint64_t exponent) : prime(prime), exponent(exponent), modulus(1) {
+			for (uint64_t i = 0; i < exponent; i++)
+				modulus *= prime;
+				
+			size_t length = static_cast<size_t>(std::max<uint64_t>(std::min(size, modulus), 1));
+			units.resize(length);
+			inverseUnits.resize(length);
+			units[0] = 1 % modulus;
+			
+			for (uint64_t i = 1; i < length; i++)
+				units[i] = i % prime == 0 ? units[i - 1] : multiply(units[i - 1], i);
+				
+			inverseUnits[length - 1] = modinvWord(units[length - 1], modulus);
+			
+			for (uint64_t i = length - 1; i > 0; i--)
+				inverseUnits[i - 1] = i % prime == 0 ? inverseUnits[i] : multiply(inverseUnits[i], i);
+		}
+		
+		uint64_t getModulus() const {
+			return modulus;
+		}
+		
+		uint64_t C(uint64_t n, uint64_t k) const {
+			if (k > n)
+				return 0;
+				
+			checkRange(n);
+			uint64_t power = primePower(legendre(n) - legendre(k) - legendre(n - k));
+			
+			if (power == 0)
+				return 0;
+				
+			uint64_t result = multiply(reducedFactorial(n, units), reducedFactorial(k, inverseUnits));
+			return multiply(multiply(result, reducedFactorial(n - k, inverseUnits)), power);
+		}
+		
+		uint64_t A(uint64_t n, uint64_t k) const {
+			if (k > n)
+				return 0;
+				
+			checkRange(n);
+			uint64_t power = primePower(legendre(n) - legendre(n - k));
+			
+			if (power == 0)
+				return 0;
+				
+			return multiply(multiply(reducedFactorial(n, units), reducedFactorial(n - k, inverseUnits)), power);
+		}
+};
+
+// 模数的素数幂分解，按素数升序给出 (p, e)
+inline std::vector<std::pair<uint64_t, uint64_t>> primePowers(uint64_t modulus) {
+	std::vector<BigInt> factors = factorize(BigInt::fromLimbs(BigInt::Limbs(1, modulus)));
+	std::vector<std::pair<uint64_t, uint64_t>> powers;
+	
+	for (const BigInt& factor : factors) {
+		uint64_t p = factor.getLimbs()[0];
+		
+		if (!powers.empty() && powers.back().first == p)
+			powers.back().second++;
+		else
+			powers.push_back(std::make_pair(p, 1));
+	}
+	
+	return powers;
+}
+
+// 任意模数：分解为素数幂，指数为 1 的分量用 BinomialTable，其余用 PrimePowerBinomial，结果用中国剩余定理合并
+// 素数分量的表长为 min(size, p)，素数幂分量的表长为 min(size, p^e)
+class ModularBinomial {
+	private:
+		uint64_t modulus;
+		std::vector<BinomialTable> primeTables;
+		std::vector<PrimePowerBinomial> powerTables;
+		std::vector<uint64_t> coefficients; // 与 primeTables、powerTables 依次对应：模分量为 1、模其余分量为 0 的数
+		
+		uint64_t coefficient(uint64_t component) const {
+			uint64_t rest = modulus / component;
+			return mulmod(rest, modinvWord(rest % component, component), modulus);
+		}
+		
+		template<typename Query>
+		uint64_t combine(Query query) const {
+			uint64_t result = 0;
+			size_t index = 0;
+			
+			for (const BinomialTable& table : primeTables)
+				result = (result + mulmod(query(table), coefficients[index++], modulus)) % modulus;
+				
+			for (const PrimePowerBinomial& table : powerTables)
+				result = (result + mulmod(query(table), coefficients[index++], modulus)) % modulus;
+				
+			return result;
+		}
+		
+	public:
+		// size 为之后查询的 n 的上界（不含），只影响大于 size 的分量
+		ModularBinomial(uint64_t size, uint64_t modulus) : modulus(modulus) {
+			if (modulus == 0)
+				throw std::runtime_error("Modulus must be positive");
+				
+			if (modulus == 1)
+				return;
+				
+			std::vector<std::pair<uint64_t, uint64_t>> powers = primePowers(modulus);
+			
+			for (const std::pair<uint64_t, uint64_t>& power : powers) {
+				if (power.second == 1) {
+					primeTables.push_back(BinomialTable(size, power.first));
+				}
+			}
+			
+			for (const std::pair<uint64_t, uint64_t>& power : powers) {
+				if (power.second > 1) {
+					powerTables.push_back(PrimePowerBinomial(size, power.first, power.second));
+				}
+			}
+			
+			for (const BinomialTable& table : primeTables)
+				coefficients.push_back(coefficient(table.getModulus()));
+				
+			for (const PrimePowerBinomial& table : powerTables)
+				coefficients.push_back(coefficient(table.getModulus()));
+		}
+		
+		uint64_t getModulus() const {
+			return modulus;
+		}
+		
+		uint64_t C(uint64_t n, uint64_t k) const {
+			return combine([n, k](const auto & table) {
+				return table.C(n, k);
+			});
+		}
+		
+		uint64_t A(uint64_t n, uint64_t k) const {
+			return combine([n, k](const auto & table) {
+				return table.A(n, k);
+			});
+		}
+};
+
+// 单次查询 C(n, k) mod p^e，不建表：按 C(n, k) = Π (n - k + i) / i 逐项除去因子 p 并计数，
+// 分子、分母的剩余部分与 p 互素，各自累乘后只求一次逆元；代价 O(min(k, n - k))
+inline uint64_t binomialPrimePower(uint64_t n, uint64_t k, uint64_t p, uint64_t e, uint64_t q) {
+	if (k > n)
+		return 0;
+		
+	k = std::min(k, n - k);
+	uint64_t numerator = 1 % q, denominator = 1 % q, up = 0, down = 0;
+	
+	for (uint64_t i = 1; i <= k; i++) {
+		uint64_t a = n - k + i, b = i;
+		
+		for (; a % p == 0; a /= p)
+			up++;
+			
+		for (; b % p == 0; b /= p)
+			down++;
+			
+		numerator = binomialMultiply(numerator, a % q, q);
+		denominator = binomialMultiply(denominator, b % q, q);
+	}
+	
+	// 分子中 p 的次数不少于分母（Kummer 定理），差达到 e 时结果为 0
+	if (up - down >= e)
+		return 0;
+		
+	for (uint64_t j = down; j < up; j++)
+		numerator = binomialMultiply(numerator, p, q);
+		
+	return binomialMultiply(numerator, modinvWord(denominator, q), q);
+}
+
+// 单次查询 C(n, k) mod p，p 为素数：按 p 进制逐位用 Lucas 定理，每位用 binomialPrimePower，代价 O(min(k_i, n_i - k_i))
+inline uint64_t lucasWord(uint64_t n, uint64_t k, uint64_t p) {
+	uint64_t result = 1 % p;
+	
+	for (; k != 0 && result != 0; n /= p, k /= p)
+		result = binomialMultiply(result, binomialPrimePower(n % p, k % p, p, 1, p), p);
+		
+	return result;
+}
+
+// 单次查询 C(n, k) mod modulus，按素数幂分量 q = p^e 分别计算后用中国剩余定理合并：
+// q <= min(k, n - k) 时建一张长为 q 的表（素数用 BinomialTable 与 Lucas 定理，素数幂用 PrimePowerBinomial），代价 O(q + log n)；
+// 否则素数分量在 p <= n 时用 lucasWord 逐位计算，其余用 binomialPrimePower，代价 O(min(k, n - k))，不分配内存
+inline uint64_t binomialWord(uint64_t n, uint64_t k, uint64_t modulus) {
+	if (modulus == 0)
+		throw std::runtime_error("Modulus must be positive");
+		
+	if (k > n || modulus == 1)
+		return 0;
+		
+	uint64_t result = 0;
+	
+	for (const std::pair<uint64_t, uint64_t>& power : primePowers(modulus)) {
+		uint64_t p = power.first, q = 1, value = 1;
+		
+		for (uint64_t j = 0; j < power.second; j++)
+			q *= p;
+			
+		if (q <= std::min(k, n - k)) {
+			value = power.second == 1 ? BinomialTable(q, p).C(n, k) : PrimePowerBinomial(q, p, power.second).C(n, k);
+		} else if (power.second == 1 && p <= n) {
+			value = lucasWord(n, k, p);
+		} else {
+			value = binomialPrimePower(n, k, p, power.second, q);
+		}
+		
+		uint64_t rest = modulus / q;
+		result = (result + mulmod(value, mulmod(rest, modinvWord(rest % q, q), modulus), modulus)) % modulus;
+	}
+	
+	return result;
+}
+
+// 单次查询 A(n, k) mod modulus：k >= modulus 时 modulus 整除 k!，从而整除 A(n, k)；否则直接连乘 k 项
+inline uint64_t permutationWord(uint64_t n, uint64_t k, uint64_t modulus) {
+	if (modulus == 0)
+		throw std::runtime_error("Modulus must be positive");
+		
+	if (k > n || k >= modulus)
+		return 0;
+		
+	uint64_t result = 1 % modulus;
+	
+	for (uint64_t i = n - k + 1; i <= n && i != 0; i++)
+		result = binomialMultiply(result, i % modulus, modulus);
+		
+	return result;
+}
+
+// 以下为 BigInt 接口：n 与模数都不超过一个字时用上面的单次查询，代价不超过 O(min(k, n - k))（A 为 O(k)），
+// 否则退回到精确计算组合数再取模，代价为 O(min(k, n - k)) 次大整数乘除；反复查询时应直接持有上面的表
+inline bool fitsWord(const BigInt& value) {
+	return value.sign() >= 0 && value.getLimbs().size() <= 1;
+}
+
+inline uint64_t toWord(const BigInt& value) {
+	return value.isZero() ? 0 : value.getLimbs()[0];
+}
 
 BigInt factorial(BigInt num, BigInt mod) {
 	BigInt ans("1");
@@ -33,17 +440,67 @@ BigInt factorial(BigInt num, BigInt mod) {
 	return ans;
 }
 
+// 组合数 C(a, b) mod mod
 BigInt C(BigInt a, BigInt b, BigInt mod) {
-	return factorial(a, mod) / (factorial(b, mod) * factorial(a - b, mod));
+	if (b < 0 || b > a)
+		return 0;
+		
+	if (fitsWord(a) && fitsWord(mod))
+		return BigInt::fromLimbs(BigInt::Limbs(1, binomialWord(toWord(a), toWord(b), toWord(mod))));
+		
+	if (a - b < b)
+		b = a - b;
+		
+	// C(a, i) = C(a, i - 1) * (a - i + 1) / i，每一步都能整除
+	BigInt ans = 1;
+	
+	for (BigInt i = 1; i <= b; i++)
+		ans = ans * (a - b + i) / i;
+		
+	return ans % mod;
 }
 
+// 排列数 A(a, b) = a! / (a - b)! mod mod
 BigInt A(BigInt a, BigInt b, BigInt mod) {
-	return factorial(a, mod) / factorial(b - a, mod);
+	if (b < 0 || b > a)
+		return 0;
+		
+	if (fitsWord(a) && fitsWord(mod))
+		return BigInt::fromLimbs(BigInt::Limbs(1, permutationWord(toWord(a), toWord(b), toWord(mod))));
+		
+	BigInt ans = BigInt(1) % mod;
+	
+	for (BigInt i = a - b + 1; i <= a; i++)
+		ans = ans * i % mod;
+		
+	return ans;
 }
 
+// Lucas 定理，p 为素数：逐位计算 C(n_i, k_i) mod p，不建与 p 同阶的阶乘表，每位代价 O(min(k_i, n_i - k_i))
 BigInt Lucas(BigInt n, BigInt k, BigInt p) {
-	if (k == 0)
-		return 1;
+	if (k < 0 || k > n)
+		return 0;
+		
+	if (!fitsWord(p))
+		throw std::runtime_error("Lucas modulus must fit in one word");
+		
+	uint64_t prime = toWord(p);
+	
+	if (!isPrimeWord(prime))
+		throw std::runtime_error("Lucas modulus must be prime");
+		
+	if (fitsWord(n))
+		return BigInt::fromLimbs(BigInt::Limbs(1, lucasWord(toWord(n), toWord(k), prime)));
 		
-	return (C(n % p, k % p, p) * Lucas(n / p, k / p, p)) % p;
+	uint64_t ans = 1 % prime;
+	
+	while (!k.isZero() && ans != 0) {
+		std::pair<BigInt, BigInt> nDigit = n.divmod(p);
+		std::pair<BigInt, BigInt> kDigit = k.divmod(p);
+		ans = binomialMultiply(ans, binomialPrimePower(toWord(nDigit.second), toWord(kDigit.second), prime, 1, prime), prime);
+		n = std::move(nDigit.first);
+		k = std::move(kDigit.first);
+	}
+	
+	return BigInt::fromLimbs(BigInt::Limbs(1, ans));
 }
@@ -22,407 +22,1347 @@
 
 #pragma once
 #include "bigint.hpp"
-#include <sstream>
+#include <deque>
+#include <mutex>
 
-// 去除前导零
+#define BIGINT_DECIMAL_BASE 10000000000000000000ULL // 10^19，一个字能容纳的最大 10 的幂
+#define BIGINT_DECIMAL_DIGITS 19
+#define BIGINT_RADIX_THRESHOLD 30 // 十进制转换：不超过此字数时逐段乘除 10^19，否则分治
+#define BIGINT_DESERIALIZE_CHUNK 4096 // 流式反序列化每次读取的字数，头部的字数不可信，内存只随实际读到的数据增长
+
+// 去除高位的零字
 void BigInt::trimLeadingZeros() {
-	while (digits.size() > 1 && digits.back() == 0) {
-		digits.pop_back();
+	while (!limbs.empty() && limbs.back() == 0) {
+		limbs.pop_back();
 	}
 	
-	if (digits.size() == 1 && digits[0] == 0) {
+	if (limbs.empty()) {
 		isNegative = false;
 	}
 }
 
-// 构造函数
-BigInt::BigInt() : isNegative(false), digits(1, 0) {}
+// 一个字的绝对值，零时为空
+inline BigInt::Limbs magnitudeLimbs(uint64_t magnitude) {
+	return magnitude == 0 ? BigInt::Limbs() : BigInt::Limbs(1, magnitude);
+}
 
-BigInt::BigInt(long long num) {
-	if (num == 0) {
-		isNegative = false;
-		digits = {0};
-		return;
+// long long 的绝对值：先转为无符号再取负，避免 LLONG_MIN 溢出
+inline uint64_t magnitudeOf(long long num) {
+	return num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+}
+
+// 带符号加法的原地版本：符号相同时绝对值相加，否则大减小，符号取绝对值较大者
+void BigInt::addSigned(const Limbs& magnitude, bool negative) {
+	if (isNegative == negative) {
+		addMagnitude(limbs, limbs, magnitude);
 	}
-	
-	if (num < 0) {
-		isNegative = true;
-		num = -num;
+	else if (compareMagnitude(limbs, magnitude) >= 0) {
+		subMagnitude(limbs, limbs, magnitude);
 	}
 	else {
-		isNegative = false;
+		subMagnitude(limbs, magnitude, limbs);
+		isNegative = negative;
 	}
 	
-	while (num > 0) {
-		digits.push_back(num % 10);
-		num /= 10;
+	trimLeadingZeros();
+}
+
+int BigInt::compare(long long other) const {
+	bool otherNegative = other < 0;
+	
+	if (isNegative != otherNegative) {
+		return isNegative ? -1 : 1;
 	}
+	
+	uint64_t magnitude = magnitudeOf(other);
+	uint64_t value = limbs.empty() ? 0 : limbs[0];
+	int order = limbs.size() > 1 || value > magnitude ? 1 : (value < magnitude ? -1 : 0);
+	return isNegative ? -order : order;
 }
 
-BigInt::BigInt(const std::string& numStr) {
-	if (numStr.empty()) {
-		throw std::invalid_argument("Invalid number string");
+// 比较绝对值：返回 -1、0 或 1
+int BigInt::compareMagnitude(const Limbs& a, const Limbs& b) {
+	if (a.size() != b.size()) {
+		return a.size() < b.size() ? -1 : 1;
 	}
 	
-	size_t i = 0;
-	isNegative = false;
+	for (size_t i = a.size(); i > 0; i--) {
+		if (a[i - 1] != b[i - 1]) {
+			return a[i - 1] < b[i - 1] ? -1 : 1;
+		}
+	}
 	
-	if (numStr[0] == '-') {
-		isNegative = true;
-		i = 1;
+	return 0;
+}
+
+// 绝对值相加
+void BigInt::addMagnitude(Limbs& result, const Limbs& a, const Limbs& b) {
+	const Limbs& longer = a.size() >= b.size() ? a : b;
+	const Limbs& shorter = a.size() >= b.size() ? b : a;
+	size_t shortSize = shorter.size();
+	size_t longSize = longer.size();
+	result.resize(longSize);
+	uint64_t carry = 0;
+	
+	for (size_t i = 0; i < shortSize; i++) {
+		result[i] = addCarry(longer[i], shorter[i], carry);
 	}
-	else if (numStr[0] == '+') {
-		i = 1;
+	
+	for (size_t i = shortSize; i < longSize; i++) {
+		result[i] = addCarry(longer[i], 0, carry);
 	}
 	
-	// 跳过前导零
-	while (i < numStr.size() && numStr[i] == '0') {
-		i++;
+	if (carry != 0) {
+		result.push_back(carry);
 	}
+}
+
+// 绝对值相减，要求 |a| >= |b|
+void BigInt::subMagnitude(Limbs& result, const Limbs& a, const Limbs& b) {
+	size_t size = a.size();
+	size_t shortSize = b.size();
+	result.resize(size);
+	uint64_t borrow = 0;
 	
-	if (i == numStr.size()) {
-		// 全零
-		isNegative = false;
-		digits = {0};
-		return;
+	for (size_t i = 0; i < shortSize; i++) {
+		result[i] = subBorrow(a[i], b[i], borrow);
 	}
 	
-	// 存储每一位数字，低位在前
-	for (size_t j = numStr.size(); j > i; j--) {
-		if (!isdigit(numStr[j - 1])) {
-			throw std::invalid_argument("Invalid character in number string");
-		}
-		
-		digits.push_back(numStr[j - 1] - '0');
+	for (size_t i = shortSize; i < size; i++) {
+		result[i] = subBorrow(a[i], 0, borrow);
+	}
+	
+	while (!result.empty() && result.back() == 0) {
+		result.pop_back();
 	}
 }
 
-// 拷贝构造
-BigInt::BigInt(const BigInt& other) : isNegative(other.isNegative), digits(other.digits) {}
+// 乘法的分级阈值（以较短操作数的字数计），由 16 ~ 65536 字操作数的基准测试确定
+#define BIGINT_KARATSUBA_THRESHOLD 40 // 低于此值使用竖式乘法
+#define BIGINT_TOOM3_THRESHOLD 1000 // 低于此值使用 Karatsuba
+#define BIGINT_NTT_THRESHOLD 12000 // 低于此值使用 Toom-3，否则使用三模数 NTT
+// 平方的对应阈值：竖式平方只算一半交叉项，分治与 NTT 的收益都出现得更晚
+#define BIGINT_KARATSUBA_SQR_THRESHOLD 64
+#define BIGINT_TOOM3_SQR_THRESHOLD 1000
+#define BIGINT_NTT_SQR_THRESHOLD 16000
 
-// 赋值运算符
-BigInt& BigInt::operator=(const BigInt& other) {
-	if (this != &other) {
-		isNegative = other.isNegative;
-		digits = other.digits;
+// r[0, n) += b[0, m)（n >= m），返回最高位的进位
+inline uint64_t limbAddInPlace(uint64_t* r, size_t n, const uint64_t* b, size_t m) {
+	uint64_t carry = 0;
+	size_t i = 0;
+	
+	for (; i < m; i++) {
+		r[i] = addCarry(r[i], b[i], carry);
 	}
 	
-	return *this;
+	for (; carry != 0 && i < n; i++) {
+		r[i] = addCarry(r[i], 0, carry);
+	}
+	
+	return carry;
 }
 
-// 移动构造
-BigInt::BigInt(BigInt&& other) noexcept : isNegative(other.isNegative), digits(std::move(other.digits)) {}
-
-// 移动赋值
-BigInt& BigInt::operator=(BigInt&& other) noexcept {
-	if (this != &other) {
-		isNegative = other.isNegative;
-		digits = std::move(other.digits);
+// r[0, n) -= b[0, m)（n >= m），返回最高位的借位
+inline uint64_t limbSubInPlace(uint64_t* r, size_t n, const uint64_t* b, size_t m) {
+	uint64_t borrow = 0;
+	size_t i = 0;
+	
+	for (; i < m; i++) {
+		r[i] = subBorrow(r[i], b[i], borrow);
 	}
 	
-	return *this;
+	for (; borrow != 0 && i < n; i++) {
+		r[i] = subBorrow(r[i], 0, borrow);
+	}
+	
+	return borrow;
 }
 
-// 析构函数
-BigInt::~BigInt() {}
+// r[0, n + 1) = a[0, n) + b[0, m)（n >= m）
+inline void limbAddTo(uint64_t* r, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	std::copy(a, a + n, r);
+	r[n] = limbAddInPlace(r, n, b, m);
+}
 
-// 比较运算符
-bool BigInt::operator==(const BigInt& other) const {
-	if (isNegative != other.isNegative) {
-		return false;
+// 去掉高位的零字后的长度
+inline size_t limbLength(const uint64_t* a, size_t n) {
+	while (n > 0 && a[n - 1] == 0) {
+		n--;
 	}
 	
-	if (digits.size() != other.digits.size()) {
-		return false;
+	return n;
+}
+
+// 竖式乘法：r[0, n + m) = a * b
+inline void mulBasecase(uint64_t* r, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	std::fill(r, r + m, 0);
+	
+	for (size_t i = 0; i < n; i++) {
+		uint64_t carry = 0;
+		
+		for (size_t j = 0; j < m; j++) {
+			uint64_t high;
+			uint64_t low = mulWide(a[i], b[j], high);
+			uint64_t c = 0;
+			low = addCarry(low, r[i + j], c);
+			high += c;
+			c = 0;
+			r[i + j] = addCarry(low, carry, c);
+			carry = high + c;
+		}
+		
+		r[i + m] = carry;
 	}
+}
+
+// 竖式平方：交叉项 a[i] * a[j]（i < j）只算一次，左移一位后再加上对角项 a[i]^2
+inline void sqrBasecase(uint64_t* r, const uint64_t* a, size_t n) {
+	std::fill(r, r + 2 * n, 0);
 	
-	for (size_t i = 0; i < digits.size(); i++) {
-		if (digits[i] != other.digits[i]) {
-			return false;
+	for (size_t i = 0; i + 1 < n; i++) {
+		uint64_t carry = 0;
+		
+		for (size_t j = i + 1; j < n; j++) {
+			uint64_t high;
+			uint64_t low = mulWide(a[i], a[j], high);
+			uint64_t c = 0;
+			low = addCarry(low, r[i + j], c);
+			high += c;
+			c = 0;
+			r[i + j] = addCarry(low, carry, c);
+			carry = high + c;
 		}
+		
+		r[i + n] = carry;
+	}
+	
+	uint64_t top = 0;
+	
+	for (size_t i = 0; i < 2 * n; i++) {
+		uint64_t next = r[i] >> 63;
+		r[i] = (r[i] << 1) | top;
+		top = next;
 	}
 	
-	return true;
+	uint64_t carry = 0;
+	
+	for (size_t i = 0; i < n; i++) {
+		uint64_t high;
+		uint64_t low = mulWide(a[i], a[i], high);
+		r[2 * i] = addCarry(r[2 * i], low, carry);
+		r[2 * i + 1] = addCarry(r[2 * i + 1], high, carry);
+	}
 }
 
-bool BigInt::operator!=(const BigInt& other) const {
-	return !(*this == other);
+// 绝对值相乘
+void BigInt::mulMagnitude(Limbs& result, const Limbs& a, const Limbs& b) {
+	if (a.empty() || b.empty()) {
+		result.clear();
+		return;
+	}
+	
+	Limbs product(a.size() + b.size());
+	
+	if (&a == &b) {
+		sqrLimbs(product.data(), a.data(), a.size());
+	}
+	else {
+		mulLimbs(product.data(), a.data(), a.size(), b.data(), b.size());
+	}
+	
+	while (!product.empty() && product.back() == 0) {
+		product.pop_back();
+	}
+	
+	result.swap(product);
 }
 
-bool BigInt::operator<(const BigInt& other) const {
-	if (isNegative != other.isNegative) {
-		return isNegative;
+// 分级乘法：短的操作数不到长的一半时把长的切成若干段分别相乘，否则按较短操作数的规模选择算法
+void BigInt::mulLimbs(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	if (n < m) {
+		std::swap(a, b);
+		std::swap(n, m);
+	}
+	
+	if (m == 0) {
+		std::fill(result, result + n, 0);
+		return;
 	}
 	
-	if (digits.size() != other.digits.size()) {
-		return (isNegative ? digits.size() > other.digits.size() : digits.size() < other.digits.size());
+	if (a == b && n == m) {
+		sqrLimbs(result, a, n);
+		return;
+	}
+	
+	if (m < BIGINT_KARATSUBA_THRESHOLD) {
+		mulBasecase(result, a, n, b, m);
+		return;
 	}
 	
-	for (int i = digits.size() - 1; i >= 0; i--) {
-		if (digits[i] != other.digits[i]) {
-			return (isNegative ? digits[i] > other.digits[i] : digits[i] < other.digits[i]);
+	if (2 * m <= n) {
+		std::fill(result, result + n + m, 0);
+		std::vector<uint64_t> part(2 * m);
+		
+		for (size_t i = 0; i < n; i += m) {
+			size_t length = std::min(m, n - i);
+			mulLimbs(part.data(), a + i, length, b, m);
+			limbAddInPlace(result + i, n + m - i, part.data(), length + m);
 		}
+		
+		return;
 	}
 	
-	return false;
+	if (m < BIGINT_TOOM3_THRESHOLD) {
+		mulKaratsuba(result, a, n, b, m);
+	}
+	else if (m < BIGINT_NTT_THRESHOLD) {
+		mulToom3(result, a, n, b, m);
+	}
+	else {
+		mulNtt(result, a, n, b, m);
+	}
 }
 
-bool BigInt::operator>(const BigInt& other) const {
-	return other < *this;
+// 平方的分级
+void BigInt::sqrLimbs(uint64_t* result, const uint64_t* a, size_t n) {
+	if (n < BIGINT_KARATSUBA_SQR_THRESHOLD) {
+		sqrBasecase(result, a, n);
+	}
+	else if (n < BIGINT_TOOM3_SQR_THRESHOLD) {
+		mulKaratsuba(result, a, n, a, n);
+	}
+	else if (n < BIGINT_NTT_SQR_THRESHOLD) {
+		mulToom3(result, a, n, a, n);
+	}
+	else {
+		mulNtt(result, a, n, a, n);
+	}
 }
 
-bool BigInt::operator<=(const BigInt& other) const {
-	return !(other < *this);
+// Karatsuba：a = a1 * B^h + a0，b = b1 * B^h + b0，
+// a * b = z2 * B^2h + ((a0 + a1)(b0 + b1) - z0 - z2) * B^h + z0，三次递归乘法代替四次
+// 要求 n >= m > n / 2；a 与 b 为同一段内存时三次乘法都是平方
+void BigInt::mulKaratsuba(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	bool square = a == b && n == m;
+	size_t h = (n + 1) / 2;
+	size_t highA = n - h;
+	size_t highB = m - h;
+	// z0 与 z2 直接写入结果的低半部分与高半部分
+	mulLimbs(result, a, h, b, h);
+	mulLimbs(result + 2 * h, a + h, highA, square ? a + h : b + h, highB);
+	// 中间项：两段之和各有 h + 1 个字，乘积有 2h + 2 个字
+	std::vector<uint64_t> buffer(4 * h + 4);
+	uint64_t* sumA = buffer.data();
+	uint64_t* sumB = sumA + h + 1;
+	uint64_t* middle = sumB + h + 1;
+	limbAddTo(sumA, a, h, a + h, highA);
+	size_t lengthA = limbLength(sumA, h + 1);
+	
+	if (square) {
+		mulLimbs(middle, sumA, lengthA, sumA, lengthA);
+	}
+	else {
+		limbAddTo(sumB, b, h, b + h, highB);
+		mulLimbs(middle, sumA, lengthA, sumB, limbLength(sumB, h + 1));
+	}
+	
+	size_t lengthMiddle = limbLength(middle, 2 * h + 2);
+	limbSubInPlace(middle, lengthMiddle, result, limbLength(result, 2 * h));
+	limbSubInPlace(middle, lengthMiddle, result + 2 * h, limbLength(result + 2 * h, highA + highB));
+	limbAddInPlace(result + h, n + m - h, middle, limbLength(middle, lengthMiddle));
 }
 
-bool BigInt::operator>=(const BigInt& other) const {
-	return !(*this < other);
+// Toom-3：各操作数按 k = ceil(n / 3) 个字分成三段，看作 x = B^k 处的二次多项式，
+// 在 0、1、-1、-2、∞ 五个点求值后做五次递归乘法，再按 Bodrato 的序列插值；
+// 求值点上的值可能为负，插值中有精确的除以 2 与除以 3，这些都借助带符号的 BigInt 完成
+void BigInt::mulToom3(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	bool square = a == b && n == m;
+	size_t k = (n + 2) / 3;
+	auto part = [k](const uint64_t* x, size_t length, size_t index) {
+		size_t begin = std::min(length, index * k);
+		size_t end = std::min(length, begin + k);
+		return fromLimbs(Limbs(x + begin, x + end));
+	};
+	// 在各点求值：p(0) = x0，p(1) = x0 + x1 + x2，p(-1) = x0 - x1 + x2，p(-2) = 2 * (p(-1) + x2) - x0，p(∞) = x2
+	auto evaluate = [](const BigInt& x0, const BigInt& x1, const BigInt& x2, BigInt* values) {
+		BigInt even = x0 + x2;
+		values[0] = x0;
+		values[1] = even + x1;
+		values[2] = even - x1;
+		values[3] = (values[2] + x2) * BigInt(2) - x0;
+		values[4] = x2;
+	};
+	BigInt p[5];
+	BigInt q[5];
+	BigInt r[5];
+	evaluate(part(a, n, 0), part(a, n, 1), part(a, n, 2), p);
+	
+	if (!square) {
+		evaluate(part(b, m, 0), part(b, m, 1), part(b, m, 2), q);
+	}
+	
+	for (int i = 0; i < 5; i++) {
+		r[i] = square ? p[i].square() : p[i] * q[i];
+	}
+	
+	// 插值：r[0..4] 依次为乘积在 0、1、-1、-2、∞ 处的值，得到各次项系数 c0..c4
+	BigInt two(2);
+	BigInt c3 = (r[3] - r[1]) / BigInt(3);
+	BigInt c1 = (r[1] - r[2]) / two;
+	BigInt c2 = r[2] - r[0];
+	c3 = (c2 - c3) / two + r[4] * two;
+	c2 = c2 + c1 - r[4];
+	c1 = c1 - c3;
+	const BigInt* coefficients[5] = {&r[0], &c1, &c2, &c3, &r[4]};
+	std::fill(result, result + n + m, 0);
+	
+	for (int i = 0; i < 5; i++) {
+		const Limbs& limbs = coefficients[i]->limbs;
+		
+		if (!limbs.empty()) {
+			limbAddInPlace(result + i * k, n + m - i * k, limbs.data(), limbs.size());
+		}
+	}
 }
 
-// 加法运算符
-BigInt BigInt::operator+(const BigInt& other) const {
-	if (isNegative == other.isNegative) {
-		// 符号相同，绝对值相加，符号不变
-		BigInt result;
-		result.isNegative = isNegative;
-		size_t maxSize = std::max(digits.size(), other.digits.size());
-		result.digits.resize(maxSize);
-		int carry = 0;
-		
-		for (size_t i = 0; i < maxSize || carry != 0; i++) {
-			if (i == result.digits.size()) {
-				result.digits.push_back(0);
+// NTT 使用的三个 64 位素数 p = c * 2^t + 1，三者之积约为 2^183，
+// 足以精确表示长度不超过 2^55 的 64 位字卷积的每一项，再用中国剩余定理合并
+struct NttPrime {
+	uint64_t mod;
+	uint64_t negativeInverse; // -p^(-1) mod 2^64
+	uint64_t one; // 2^64 mod p，即 Montgomery 形式的 1
+	uint64_t squaredRadix; // 2^128 mod p，用于转换到 Montgomery 形式
+	uint64_t roots[64]; // roots[k] 为 2^k 次单位根（Montgomery 形式）
+	uint64_t inverseRoots[64];
+	
+	NttPrime(uint64_t mod, uint64_t generator) : mod(mod) {
+		uint64_t inverse = mod; // 牛顿迭代求 2^64 下的逆元，每次有效位翻倍
+		
+		for (int i = 0; i < 5; i++) {
+			inverse *= 2 - mod * inverse;
+		}
+		
+		negativeInverse = 0 - inverse;
+		one = (0 - mod) % mod;
+		uint64_t remainder;
+		divWide(one, 0, mod, remainder);
+		squaredRadix = remainder;
+		int order = 0;
+		
+		while (((mod - 1) >> order & 1) == 0) {
+			order++;
+		}
+		
+		for (int k = 0; k <= order; k++) {
+			roots[k] = power(toMontgomery(generator), (mod - 1) >> k);
+			inverseRoots[k] = power(roots[k], mod - 2);
+		}
+	}
+	
+	// Montgomery 乘法：返回 a * b / 2^64 mod p，要求 b < p（a 可以是任意 64 位数）
+	uint64_t multiply(uint64_t a, uint64_t b) const {
+		uint64_t high;
+		uint64_t low = mulWide(a, b, high);
+		uint64_t reductionHigh;
+		mulWide(low * negativeInverse, mod, reductionHigh);
+		uint64_t result = high + reductionHigh + (low != 0);
+		return result >= mod ? result - mod : result;
+	}
+	
+	uint64_t add(uint64_t a, uint64_t b) const {
+		uint64_t sum = a + b;
+		return sum >= mod ? sum - mod : sum;
+	}
+	
+	uint64_t sub(uint64_t a, uint64_t b) const {
+		return a >= b ? a - b : a + mod - b;
+	}
+	
+	uint64_t toMontgomery(uint64_t a) const {
+		return multiply(a % mod, squaredRadix);
+	}
+	
+	// base 为 Montgomery 形式，结果也是
+	uint64_t power(uint64_t base, uint64_t exponent) const {
+		uint64_t result = one;
+		
+		for (; exponent != 0; exponent >>= 1) {
+			if (exponent & 1) {
+				result = multiply(result, base);
 			}
 			
-			int sum = carry;
-			sum += (i < digits.size() ? digits[i] : 0);
-			sum += (i < other.digits.size() ? other.digits[i] : 0);
-			result.digits[i] = sum % 10;
-			carry = sum / 10;
+			base = multiply(base, base);
 		}
 		
-		result.trimLeadingZeros();
 		return result;
 	}
-	else {
-		// 符号不同，绝对值相减，符号取绝对值较大的数的符号
-		const BigInt* absThis = this;
-		const BigInt* absOther = &other;
-		// 比较绝对值大小
-		bool thisBigger = false;
+	
+	// 原地变换（数据为 Montgomery 形式），size 为 2 的幂；inverse 为真时做逆变换（不含除以 size）
+	void transform(std::vector<uint64_t>& data, bool inverse) const {
+		size_t size = data.size();
 		
-		if (digits.size() != other.digits.size()) {
-			thisBigger = digits.size() > other.digits.size();
+		for (size_t i = 1, j = 0; i < size; i++) {
+			size_t bit = size >> 1;
+			
+			for (; j & bit; bit >>= 1) {
+				j ^= bit;
+			}
+			
+			j |= bit;
+			
+			if (i < j) {
+				std::swap(data[i], data[j]);
+			}
 		}
-		else {
-			for (int i = digits.size() - 1; i >= 0; i--) {
-				if (digits[i] != other.digits[i]) {
-					thisBigger = digits[i] > other.digits[i];
-					break;
+		
+		std::vector<uint64_t> twiddles(size / 2);
+		
+		for (size_t length = 2, level = 1; length <= size; length <<= 1, level++) {
+			uint64_t step = inverse ? inverseRoots[level] : roots[level];
+			size_t half = length / 2;
+			twiddles[0] = one;
+			
+			for (size_t j = 1; j < half; j++) {
+				twiddles[j] = multiply(twiddles[j - 1], step);
+			}
+			
+			for (size_t i = 0; i < size; i += length) {
+				for (size_t j = 0; j < half; j++) {
+					uint64_t u = data[i + j];
+					uint64_t v = multiply(data[i + j + half], twiddles[j]);
+					data[i + j] = add(u, v);
+					data[i + j + half] = sub(u, v);
 				}
 			}
 		}
-		
-		if (!thisBigger) {
-			std::swap(absThis, absOther);
+	}
+	
+	// 循环卷积 a * b mod p（普通形式的结果写回 a）；square 为真时 b 不使用
+	void convolve(std::vector<uint64_t>& a, std::vector<uint64_t>& b, bool square) const {
+		for (uint64_t& x : a) {
+			x = toMontgomery(x);
 		}
 		
-		BigInt result;
-		result.isNegative = (absThis == this) ? isNegative : other.isNegative;
-		size_t maxSize = absThis->digits.size();
-		result.digits.resize(maxSize);
-		int borrow = 0;
+		transform(a, false);
 		
-		for (size_t i = 0; i < maxSize; i++) {
-			int diff = (i < absThis->digits.size() ? absThis->digits[i] : 0)
-			           - (i < absOther->digits.size() ? absOther->digits[i] : 0)
-			           - borrow;
-			           
-			if (diff < 0) {
-				diff += 10;
-				borrow = 1;
+		if (square) {
+			for (uint64_t& x : a) {
+				x = multiply(x, x);
 			}
-			else {
-				borrow = 0;
+		}
+		else {
+			for (uint64_t& x : b) {
+				x = toMontgomery(x);
 			}
 			
-			result.digits[i] = diff;
+			transform(b, false);
+			
+			for (size_t i = 0; i < a.size(); i++) {
+				a[i] = multiply(a[i], b[i]);
+			}
 		}
 		
-		result.trimLeadingZeros();
-		return result;
+		transform(a, true);
+		// 乘以普通形式的 size^(-1)：Montgomery 乘法在除以 size 的同时消去 Montgomery 因子，得到普通形式
+		uint64_t factor = multiply(power(toMontgomery(a.size()), mod - 2), 1);
+		
+		for (uint64_t& x : a) {
+			x = multiply(x, factor);
+		}
 	}
-}
-
-// 减法运算符
-BigInt BigInt::operator-(const BigInt& other) const {
-	// a - b 等价于 a + (-b)
-	BigInt negOther = other;
-	negOther.isNegative = !other.isNegative;
-	return *this + negOther;
-}
+};
 
-// 乘法运算符
-BigInt BigInt::operator*(const BigInt& other) const {
-	if (isZero() || other.isZero()) {
-		return BigInt(0);
+// 三模数 NTT 乘法：分别在三个素数下做卷积，用 Garner 算法逐项合并为 3 个字的精确值后进位累加
+void BigInt::mulNtt(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+	static const NttPrime primes[3] = {NttPrime(4179340454199820289ULL, 3), NttPrime(2485986994308513793ULL, 5), NttPrime(1945555039024054273ULL, 5)};
+	bool square = a == b && n == m;
+	size_t size = 1;
+	
+	while (size < n + m) {
+		size <<= 1;
 	}
 	
-	BigInt result;
-	result.isNegative = isNegative ^ other.isNegative;
-	result.digits.resize(digits.size() + other.digits.size(), 0);
+	std::vector<uint64_t> residues[3];
+	std::vector<uint64_t> other;
 	
-	for (size_t i = 0; i < digits.size(); i++) {
-		int carry = 0;
+	for (int k = 0; k < 3; k++) {
+		residues[k].assign(size, 0);
+		std::copy(a, a + n, residues[k].begin());
 		
-		for (size_t j = 0; j < other.digits.size() || carry != 0; j++) {
-			long long cur = result.digits[i + j] +
-			                (long long)digits[i] * (j < other.digits.size() ? other.digits[j] : 0) +
-			                carry;
-			result.digits[i + j] = cur % 10;
-			carry = cur / 10;
+		if (!square) {
+			other.assign(size, 0);
+			std::copy(b, b + m, other.begin());
 		}
+		
+		primes[k].convolve(residues[k], other, square);
 	}
 	
-	result.trimLeadingZeros();
-	return result;
+	const NttPrime& p1 = primes[0];
+	const NttPrime& p2 = primes[1];
+	const NttPrime& p3 = primes[2];
+	// Garner：x = x1 + p1 * y2 + p1 * p2 * y3；逆元保持 Montgomery 形式，与普通形式的数相乘时直接得到普通形式的结果
+	static const uint64_t inverse12 = p2.power(p2.toMontgomery(p1.mod), p2.mod - 2);
+	static const uint64_t inverse13 = p3.power(p3.toMontgomery(p1.mod), p3.mod - 2);
+	static const uint64_t inverse23 = p3.power(p3.toMontgomery(p2.mod), p3.mod - 2);
+	uint64_t p12High;
+	uint64_t p12Low = mulWide(p1.mod, p2.mod, p12High);
+	uint64_t carry[3] = {0, 0, 0};
+	
+	for (size_t i = 0; i < n + m; i++) {
+		uint64_t x1 = residues[0][i];
+		uint64_t y2 = p2.multiply(p2.sub(residues[1][i], x1 % p2.mod), inverse12);
+		uint64_t y3 = p3.multiply(p3.sub(p3.multiply(p3.sub(residues[2][i], x1 % p3.mod), inverse13), y2 % p3.mod), inverse23);
+		// value = x1 + p1 * y2 + (p12High * 2^64 + p12Low) * y3，共 3 个字
+		uint64_t value[3];
+		uint64_t high;
+		value[0] = mulWide(p1.mod, y2, high);
+		uint64_t c = 0;
+		value[0] = addCarry(value[0], x1, c);
+		value[1] = high + c;
+		value[2] = 0;
+		uint64_t lowHigh;
+		uint64_t low = mulWide(p12Low, y3, lowHigh);
+		uint64_t topHigh;
+		uint64_t top = mulWide(p12High, y3, topHigh);
+		c = 0;
+		value[0] = addCarry(value[0], low, c);
+		value[1] = addCarry(value[1], lowHigh, c);
+		value[2] = addCarry(value[2], topHigh, c);
+		c = 0;
+		value[1] = addCarry(value[1], top, c);
+		value[2] += c;
+		// 累加到进位上，输出最低的字
+		c = 0;
+		carry[0] = addCarry(carry[0], value[0], c);
+		carry[1] = addCarry(carry[1], value[1], c);
+		carry[2] = addCarry(carry[2], value[2], c);
+		result[i] = carry[0];
+		carry[0] = carry[1];
+		carry[1] = carry[2];
+		carry[2] = 0;
+	}
 }
 
-// 除法运算符
-BigInt BigInt::operator/(const BigInt& other) const {
-	if (other.isZero()) {
-		throw std::runtime_error("Division by zero");
-	}
+// a = a * factor + addend
+void BigInt::mulSmall(Limbs& a, uint64_t factor, uint64_t addend) {
+	uint64_t carry = addend;
 	
-	if (isZero()) {
-		return BigInt(0);
+	for (uint64_t& limb : a) {
+		uint64_t high;
+		uint64_t low = mulWide(limb, factor, high);
+		uint64_t c = 0;
+		limb = addCarry(low, carry, c);
+		carry = high + c;
 	}
 	
-	BigInt dividend = *this;
-	BigInt divisor = other;
-	dividend.isNegative = false;
-	divisor.isNegative = false;
+	if (carry != 0) {
+		a.push_back(carry);
+	}
+}
+
+// a /= divisor，返回余数
+uint64_t BigInt::divSmall(Limbs& a, uint64_t divisor) {
+	uint64_t remainder = 0;
 	
-	if (dividend < divisor) {
-		return BigInt(0);
+	for (size_t i = a.size(); i > 0; i--) {
+		a[i - 1] = divWide(remainder, a[i - 1], divisor, remainder);
 	}
 	
-	BigInt quotient;
-	quotient.isNegative = isNegative ^ other.isNegative;
-	BigInt current;
-	current.digits.clear();
-	
-	for (int i = dividend.digits.size() - 1; i >= 0; i--) {
-		// 左移一位并加上当前位
-		current.digits.insert(current.digits.begin(), dividend.digits[i]);
-		current.trimLeadingZeros();
-		// 计算当前部分商
-		int x = 0;
-		int left = 0, right = 9;
-		
-		while (left <= right) {
-			int mid = (left + right) / 2;
-			BigInt tmp = divisor * BigInt(mid);
-			
-			if (tmp <= current) {
-				x = mid;
-				left = mid + 1;
-			}
-			else {
-				right = mid - 1;
-			}
-		}
-		
-		quotient.digits.insert(quotient.digits.begin(), x);
-		// 减去已经计算的部分
-		current = current - (divisor * BigInt(x));
+	while (!a.empty() && a.back() == 0) {
+		a.pop_back();
 	}
 	
-	quotient.trimLeadingZeros();
-	return quotient;
+	return remainder;
 }
 
-// 取模运算符
-BigInt BigInt::operator%(const BigInt& other) const {
-	if (other.isZero()) {
-		throw std::runtime_error("Modulo by zero");
-	}
+// 除法的分级阈值（以除数与商中较短者的字数计），由基准测试确定：低于此值使用 Knuth 算法 D，否则使用牛顿迭代求倒数
+#define BIGINT_NEWTON_THRESHOLD 800
+#define BIGINT_RECIPROCAL_THRESHOLD 100 // 倒数精度不超过此字数时直接用算法 D 求
+#define BIGINT_NEWTON_GUARD_BITS 16 // 牛顿迭代每层多保留的精度，吸收截断误差
+
+// a % divisor，不修改 a
+uint64_t BigInt::modSmall(const Limbs& a, uint64_t divisor) {
+	uint64_t remainder = 0;
 	
-	if (isZero()) {
-		return BigInt(0);
+	for (size_t i = a.size(); i > 0; i--) {
+		divWide(remainder, a[i - 1], divisor, remainder);
 	}
 	
-	BigInt dividend = *this;
-	BigInt divisor = other;
-	dividend.isNegative = false;
-	divisor.isNegative = false;
-	
-	if (dividend < divisor) {
-		return *this;
+	return remainder;
+}
+
+// 绝对值的带余除法：除数只有一个字时逐字相除，否则按规模选择 Knuth 算法 D 或牛顿迭代
+void BigInt::divModMagnitude(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b) {
+	if (b.empty()) {
+		throw std::runtime_error("Division by zero");
 	}
 	
-	BigInt current;
-	current.digits.clear();
+	if (compareMagnitude(a, b) < 0) {
+		remainder = a;
+		quotient.clear();
+		return;
+	}
 	
-	for (int i = dividend.digits.size() - 1; i >= 0; i--) {
-		// 左移一位并加上当前位
-		current.digits.insert(current.digits.begin(), dividend.digits[i]);
-		current.trimLeadingZeros();
-		// 计算当前部分商
-		int x = 0;
-		int left = 0, right = 9;
+	if (b.size() == 1) {
+		Limbs q = a;
+		uint64_t r = divSmall(q, b[0]);
+		quotient.swap(q);
+		remainder.clear();
 		
-		while (left <= right) {
-			int mid = (left + right) / 2;
-			BigInt tmp = divisor * BigInt(mid);
-			
-			if (tmp <= current) {
-				x = mid;
-				left = mid + 1;
-			}
-			else {
-				right = mid - 1;
-			}
+		if (r != 0) {
+			remainder.push_back(r);
 		}
 		
-		// 减去已经计算的部分
-		current = current - (divisor * BigInt(x));
+		return;
 	}
 	
-	current.isNegative = isNegative;
-	current.trimLeadingZeros();
-	return current;
-}
-
-// 复合赋值运算符
-BigInt& BigInt::operator+=(const BigInt& other) {
-	*this = *this + other;
-	return *this;
+	if (std::min(b.size(), a.size() - b.size() + 1) < BIGINT_NEWTON_THRESHOLD) {
+		divKnuth(quotient, remainder, a, b);
+	}
+	else {
+		divNewton(quotient, remainder, a, b);
+	}
 }
 
-BigInt& BigInt::operator-=(const BigInt& other) {
-	*this = *this - other;
-	return *this;
+// result = a * 2^bits；result 可以与 a 是同一个对象，此时原地完成
+void BigInt::shiftLeftMagnitude(Limbs& result, const Limbs& a, size_t bits) {
+	if (a.empty()) {
+		result.clear();
+		return;
+	}
+	
+	size_t size = a.size();
+	size_t words = bits / 64;
+	unsigned shift = bits % 64;
+	result.resize(size + words + 1);
+	// 从高位向低位写，写入位置总不低于尚未读取的位置
+	result[size + words] = shift != 0 ? a[size - 1] >> (64 - shift) : 0;
+	
+	for (size_t i = size - 1; i > 0; i--) {
+		result[i + words] = a[i] << shift | (shift != 0 ? a[i - 1] >> (64 - shift) : 0);
+	}
+	
+	result[words] = a[0] << shift;
+	std::fill(result.begin(), result.begin() + words, 0);
+	
+	while (!result.empty() && result.back() == 0) {
+		result.pop_back();
+	}
 }
 
-BigInt& BigInt::operator*=(const BigInt& other) {
-	*this = *this * other;
-	return *this;
+// result = a / 2^bits（向下取整）；result 可以与 a 是同一个对象，此时原地完成
+void BigInt::shiftRightMagnitude(Limbs& result, const Limbs& a, size_t bits) {
+	size_t size = a.size();
+	size_t words = bits / 64;
+	unsigned shift = bits % 64;
+	
+	if (words >= size) {
+		result.clear();
+		return;
+	}
+	
+	if (&result != &a) {
+		result.resize(size - words);
+	}
+	
+	// 从低位向高位写，写入位置总不高于尚未读取的位置
+	for (size_t i = 0; i + words < size; i++) {
+		result[i] = a[i + words] >> shift;
+		
+		if (shift != 0 && i + words + 1 < size) {
+			result[i] |= a[i + words + 1] << (64 - shift);
+		}
+	}
+	
+	result.resize(size - words);
+	
+	while (!result.empty() && result.back() == 0) {
+		result.pop_back();
+	}
 }
 
-BigInt& BigInt::operator/=(const BigInt& other) {
-	*this = *this / other;
-	return *this;
-}
+// Knuth 算法 D：先把除数左移到最高位为 1，用被除数最高两个字除以除数最高字估计每个商字，
+// 再用除数的次高字修正估计（此后最多偏大 1），乘减后若出现借位则加回一次
+void BigInt::divKnuth(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b) {
+	size_t n = b.size();
+	size_t m = a.size() - n;
+	int shift = leadingZeros(b.back());
+	Limbs v;
+	Limbs u;
+	shiftLeftMagnitude(v, b, shift);
+	shiftLeftMagnitude(u, a, shift);
+	u.resize(a.size() + 1, 0);
+	Limbs q(m + 1, 0);
+	uint64_t divisorHigh = v[n - 1];
+	uint64_t divisorNext = v[n - 2];
+	
+	for (size_t j = m + 1; j > 0; j--) {
+		size_t k = j - 1;
+		uint64_t estimate;
+		uint64_t rest;
+		bool restOverflow = false;
+		
+		if (u[k + n] >= divisorHigh) {
+			// 估计值超过一个字时取 2^64 - 1，rest = u[k + n] * 2^64 + u[k + n - 1] - estimate * divisorHigh
+			estimate = ~0ULL;
+			uint64_t carry = 0;
+			rest = addCarry(u[k + n - 1], divisorHigh, carry);
+			restOverflow = carry != 0 || u[k + n] > divisorHigh;
+		}
+		else {
+			estimate = divWide(u[k + n], u[k + n - 1], divisorHigh, rest);
+		}
+		
+		// estimate * divisorNext > rest * 2^64 + u[k + n - 2] 时估计偏大
+		while (!restOverflow) {
+			uint64_t productHigh;
+			uint64_t productLow = mulWide(estimate, divisorNext, productHigh);
+			
+			if (productHigh < rest || (productHigh == rest && productLow <= u[k + n - 2])) {
+				break;
+			}
+			
+			estimate--;
+			uint64_t carry = 0;
+			rest = addCarry(rest, divisorHigh, carry);
+			restOverflow = carry != 0;
+		}
+		
+		// u[k, k + n] -= estimate * v
+		uint64_t carry = 0;
+		uint64_t borrow = 0;
+		
+		for (size_t i = 0; i < n; i++) {
+			uint64_t high;
+			uint64_t low = mulWide(estimate, v[i], high);
+			uint64_t c = 0;
+			low = addCarry(low, carry, c);
+			carry = high + c;
+			u[k + i] = subBorrow(u[k + i], low, borrow);
+		}
+		
+		u[k + n] = subBorrow(u[k + n], carry, borrow);
+		
+		if (borrow != 0) {
+			estimate--;
+			carry = 0;
+			
+			for (size_t i = 0; i < n; i++) {
+				u[k + i] = addCarry(u[k + i], v[i], carry);
+			}
+			
+			u[k + n] += carry;
+		}
+		
+		q[k] = estimate;
+	}
+	
+	while (!q.empty() && q.back() == 0) {
+		q.pop_back();
+	}
+	
+	u.resize(n);
+	
+	while (!u.empty() && u.back() == 0) {
+		u.pop_back();
+	}
+	
+	quotient.swap(q);
+	shiftRightMagnitude(remainder, u, shift);
+}
+
+// 2^bits
+inline BigInt::Limbs powerOfTwoLimbs(size_t bits) {
+	BigInt::Limbs power(bits / 64 + 1, 0);
+	power.back() = 1ULL << (bits % 64);
+	return power;
+}
+
+// 牛顿迭代求倒数：先以约一半的精度递归求出 y ≈ 2^(2h) / top_h，放大为 x ≈ 2^(2k) / top_k，
+// 再做一步 x = x + x * (2^(2k) - top_k * x) / 2^(2k)，相对误差平方；精度足够小时直接用算法 D 求
+void BigInt::reciprocalMagnitude(Limbs& result, const Limbs& b, size_t bits) {
+	Limbs top;
+	shiftRightMagnitude(top, b, b.size() * 64 - bits);
+	Limbs power = powerOfTwoLimbs(2 * bits);
+	
+	if (bits <= 64 * BIGINT_RECIPROCAL_THRESHOLD) {
+		Limbs remainder;
+		divKnuth(result, remainder, power, top);
+		return;
+	}
+	
+	size_t half = bits / 2 + BIGINT_NEWTON_GUARD_BITS;
+	Limbs x;
+	reciprocalMagnitude(x, b, half);
+	shiftLeftMagnitude(x, x, bits - half);
+	Limbs product;
+	mulMagnitude(product, top, x);
+	Limbs error;
+	Limbs correction;
+	
+	if (compareMagnitude(power, product) >= 0) {
+		subMagnitude(error, power, product);
+		mulMagnitude(correction, x, error);
+		shiftRightMagnitude(correction, correction, 2 * bits);
+		addMagnitude(result, x, correction);
+	}
+	else {
+		subMagnitude(error, product, power);
+		mulMagnitude(correction, x, error);
+		shiftRightMagnitude(correction, correction, 2 * bits);
+		subMagnitude(result, x, correction);
+	}
+}
+
+// 牛顿迭代除法：除数左移到最高位为 1 后求出 n 个字精度的倒数 x ≈ 2^(128n) / v，
+// 被除数按 n 个字分段从高到低处理：t = r * 2^(64n) + 当前段，商估计为 (t * x) >> 128n，
+// 误差只有几个单位，用余数修正即可；每段的代价约为两次 n 字规模的乘法
+void BigInt::divNewton(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b) {
+	size_t n = b.size();
+	int shift = leadingZeros(b.back());
+	Limbs v;
+	Limbs u;
+	shiftLeftMagnitude(v, b, shift);
+	shiftLeftMagnitude(u, a, shift);
+	Limbs inverse;
+	reciprocalMagnitude(inverse, v, 64 * n);
+	size_t chunks = (u.size() + n - 1) / n;
+	Limbs q(chunks * n, 0);
+	Limbs r;
+	Limbs t;
+	Limbs estimate;
+	Limbs product;
+	const Limbs one(1, 1);
+	
+	for (size_t i = chunks; i > 0; i--) {
+		size_t begin = (i - 1) * n;
+		size_t end = std::min(begin + n, u.size());
+		t.assign(u.begin() + begin, u.begin() + end);
+		
+		if (!r.empty()) {
+			t.resize(n, 0);
+			t.insert(t.end(), r.begin(), r.end());
+		}
+		
+		while (!t.empty() && t.back() == 0) {
+			t.pop_back();
+		}
+		
+		// 只用 t 的高 n + 1 个字估计，舍去的低位对估计值的影响小于 1
+		shiftRightMagnitude(estimate, t, 64 * (n - 1));
+		mulMagnitude(estimate, estimate, inverse);
+		shiftRightMagnitude(estimate, estimate, 64 * (n + 1));
+		mulMagnitude(product, estimate, v);
+		
+		while (compareMagnitude(product, t) > 0) {
+			subMagnitude(estimate, estimate, one);
+			subMagnitude(product, product, v);
+		}
+		
+		subMagnitude(r, t, product);
+		
+		while (compareMagnitude(r, v) >= 0) {
+			addMagnitude(estimate, estimate, one);
+			subMagnitude(r, r, v);
+		}
+		
+		std::copy(estimate.begin(), estimate.end(), q.begin() + begin);
+	}
+	
+	while (!q.empty() && q.back() == 0) {
+		q.pop_back();
+	}
+	
+	quotient.swap(q);
+	shiftRightMagnitude(remainder, r, shift);
+}
+
+// 构造函数
+BigInt::BigInt() : isNegative(false) {}
+
+BigInt::BigInt(long long num) : isNegative(num < 0) {
+	uint64_t magnitude = magnitudeOf(num);
+	
+	if (magnitude != 0) {
+		limbs.push_back(magnitude);
+	}
+}
+
+BigInt::BigInt(const std::string& numStr) : isNegative(false) {
+	if (numStr.empty()) {
+		throw std::invalid_argument("Invalid number string");
+	}
+	
+	size_t i = 0;
+	bool negative = false;
+	
+	if (numStr[0] == '-') {
+		negative = true;
+		i = 1;
+	}
+	else if (numStr[0] == '+') {
+		i = 1;
+	}
+	
+	if (i == numStr.size()) {
+		throw std::invalid_argument("Invalid number string");
+	}
+	
+	for (size_t j = i; j < numStr.size(); j++) {
+		if (!isdigit(static_cast<unsigned char>(numStr[j]))) {
+			throw std::invalid_argument("Invalid character in number string");
+		}
+	}
+	
+	parseDecimal(limbs, numStr.data() + i, numStr.size() - i);
+	trimLeadingZeros();
+	isNegative = negative && !limbs.empty();
+}
+
+// 拷贝构造
+BigInt::BigInt(const BigInt& other) : isNegative(other.isNegative), limbs(other.limbs) {}
+
+// 赋值运算符
+BigInt& BigInt::operator=(const BigInt& other) {
+	if (this != &other) {
+		isNegative = other.isNegative;
+		limbs = other.limbs;
+	}
+	
+	return *this;
+}
+
+// 移动构造
+BigInt::BigInt(BigInt&& other) noexcept : isNegative(other.isNegative), limbs(std::move(other.limbs)) {
+	other.isNegative = false;
+	other.limbs.clear();
+}
+
+// 移动赋值
+BigInt& BigInt::operator=(BigInt&& other) noexcept {
+	if (this != &other) {
+		isNegative = other.isNegative;
+		limbs = std::move(other.limbs);
+		other.isNegative = false;
+		other.limbs.clear();
+	}
+	
+	return *this;
+}
+
+// 析构函数
+BigInt::~BigInt() {}
+
+// 比较运算符
+bool BigInt::operator==(const BigInt& other) const {
+	return isNegative == other.isNegative && limbs == other.limbs;
+}
+
+bool BigInt::operator!=(const BigInt& other) const {
+	return !(*this == other);
+}
+
+bool BigInt::operator<(const BigInt& other) const {
+	if (isNegative != other.isNegative) {
+		return isNegative;
+	}
+	
+	int order = compareMagnitude(limbs, other.limbs);
+	return isNegative ? order > 0 : order < 0;
+}
+
+bool BigInt::operator>(const BigInt& other) const {
+	return other < *this;
+}
+
+bool BigInt::operator<=(const BigInt& other) const {
+	return !(other < *this);
+}
+
+bool BigInt::operator>=(const BigInt& other) const {
+	return !(*this < other);
+}
+
+// 加法运算符
+BigInt BigInt::operator+(const BigInt& other) const {
+	BigInt result = *this;
+	result.addSigned(other.limbs, other.isNegative);
+	return result;
+}
+
+// 减法运算符
+BigInt BigInt::operator-(const BigInt& other) const {
+	// a - b 等价于 a + (-b)，零的符号在 addSigned 中会被规范化
+	BigInt result = *this;
+	result.addSigned(other.limbs, !other.isNegative);
+	return result;
+}
+
+// 乘法运算符
+BigInt BigInt::operator*(const BigInt& other) const {
+	BigInt result;
+	mulMagnitude(result.limbs, limbs, other.limbs);
+	result.isNegative = isNegative != other.isNegative;
+	result.trimLeadingZeros();
+	return result;
+}
+
+// 平方
+BigInt BigInt::square() const {
+	BigInt result;
+	mulMagnitude(result.limbs, limbs, limbs);
+	result.trimLeadingZeros();
+	return result;
+}
+
+// 除法运算符
+BigInt BigInt::operator/(const BigInt& other) const {
+	if (other.isZero()) {
+		throw std::runtime_error("Division by zero");
+	}
+	
+	BigInt quotient;
+	Limbs remainder;
+	divModMagnitude(quotient.limbs, remainder, limbs, other.limbs);
+	quotient.isNegative = isNegative != other.isNegative;
+	quotient.trimLeadingZeros();
+	return quotient;
+}
+
+// 取模运算符
+BigInt BigInt::operator%(const BigInt& other) const {
+	if (other.isZero()) {
+		throw std::runtime_error("Modulo by zero");
+	}
+	
+	BigInt remainder;
+	
+	if (other.limbs.size() == 1) {
+		remainder.limbs = magnitudeLimbs(modSmall(limbs, other.limbs[0]));
+	}
+	else {
+		Limbs quotient;
+		divModMagnitude(quotient, remainder.limbs, limbs, other.limbs);
+	}
+	
+	remainder.isNegative = isNegative;
+	remainder.trimLeadingZeros();
+	return remainder;
+}
+
+// 带余除法：一次求出商与余数
+std::pair<BigInt, BigInt> BigInt::divmod(const BigInt& other) const {
+	if (other.isZero()) {
+		throw std::runtime_error("Division by zero");
+	}
+	
+	std::pair<BigInt, BigInt> result;
+	divModMagnitude(result.first.limbs, result.second.limbs, limbs, other.limbs);
+	result.first.isNegative = isNegative != other.isNegative;
+	result.second.isNegative = isNegative;
+	result.first.trimLeadingZeros();
+	result.second.trimLeadingZeros();
+	return result;
+}
+
+// 复合赋值运算符：结果直接写入自身的字数组，除数只有一个字时乘除也在原地完成
+BigInt& BigInt::operator+=(const BigInt& other) {
+	addSigned(other.limbs, other.isNegative);
+	return *this;
+}
+
+BigInt& BigInt::operator-=(const BigInt& other) {
+	addSigned(other.limbs, !other.isNegative);
+	return *this;
+}
+
+BigInt& BigInt::operator*=(const BigInt& other) {
+	if (other.limbs.size() == 1) {
+		mulSmall(limbs, other.limbs[0], 0);
+	}
+	else {
+		mulMagnitude(limbs, limbs, other.limbs);
+	}
+	
+	isNegative = isNegative != other.isNegative;
+	trimLeadingZeros();
+	return *this;
+}
+
+BigInt& BigInt::operator/=(const BigInt& other) {
+	if (other.isZero()) {
+		throw std::runtime_error("Division by zero");
+	}
+	
+	if (other.limbs.size() == 1) {
+		divSmall(limbs, other.limbs[0]);
+	}
+	else {
+		Limbs remainder;
+		divModMagnitude(limbs, remainder, limbs, other.limbs);
+	}
+	
+	isNegative = isNegative != other.isNegative;
+	trimLeadingZeros();
+	return *this;
+}
 
 BigInt& BigInt::operator%=(const BigInt& other) {
-	*this = *this % other;
+	if (other.isZero()) {
+		throw std::runtime_error("Modulo by zero");
+	}
+	
+	if (other.limbs.size() == 1) {
+		uint64_t remainder = modSmall(limbs, other.limbs[0]);
+		limbs.clear();
+		
+		if (remainder != 0) {
+			limbs.push_back(remainder);
+		}
+	}
+	else {
+		Limbs quotient;
+		divModMagnitude(quotient, limbs, limbs, other.limbs);
+	}
+	
+	trimLeadingZeros();
+	return *this;
+}
+
+// 与 long long 的比较
+bool BigInt::operator==(long long other) const {
+	return compare(other) == 0;
+}
+
+bool BigInt::operator!=(long long other) const {
+	return compare(other) != 0;
+}
+
+bool BigInt::operator<(long long other) const {
+	return compare(other) < 0;
+}
+
+bool BigInt::operator>(long long other) const {
+	return compare(other) > 0;
+}
+
+bool BigInt::operator<=(long long other) const {
+	return compare(other) <= 0;
+}
+
+bool BigInt::operator>=(long long other) const {
+	return compare(other) >= 0;
+}
+
+// 与 long long 的算术运算
+BigInt BigInt::operator+(long long other) const {
+	BigInt result = *this;
+	result += other;
+	return result;
+}
+
+BigInt BigInt::operator-(long long other) const {
+	BigInt result = *this;
+	result -= other;
+	return result;
+}
+
+BigInt BigInt::operator*(long long other) const {
+	BigInt result = *this;
+	result *= other;
+	return result;
+}
+
+BigInt BigInt::operator/(long long other) const {
+	BigInt result = *this;
+	result /= other;
+	return result;
+}
+
+BigInt BigInt::operator%(long long other) const {
+	if (other == 0) {
+		throw std::runtime_error("Modulo by zero");
+	}
+	
+	BigInt result;
+	result.limbs = magnitudeLimbs(modSmall(limbs, magnitudeOf(other)));
+	result.isNegative = isNegative;
+	result.trimLeadingZeros();
+	return result;
+}
+
+BigInt& BigInt::operator+=(long long other) {
+	addSigned(magnitudeLimbs(magnitudeOf(other)), other < 0);
+	return *this;
+}
+
+BigInt& BigInt::operator-=(long long other) {
+	// -other 对 LLONG_MIN 会溢出，直接翻转符号标志
+	addSigned(magnitudeLimbs(magnitudeOf(other)), other > 0);
+	return *this;
+}
+
+BigInt& BigInt::operator*=(long long other) {
+	mulSmall(limbs, magnitudeOf(other), 0);
+	isNegative = isNegative != (other < 0);
+	trimLeadingZeros();
+	return *this;
+}
+
+BigInt& BigInt::operator/=(long long other) {
+	if (other == 0) {
+		throw std::runtime_error("Division by zero");
+	}
+	
+	divSmall(limbs, magnitudeOf(other));
+	isNegative = isNegative != (other < 0);
+	trimLeadingZeros();
+	return *this;
+}
+
+BigInt& BigInt::operator%=(long long other) {
+	if (other == 0) {
+		throw std::runtime_error("Modulo by zero");
+	}
+	
+	uint64_t remainder = modSmall(limbs, magnitudeOf(other));
+	limbs.clear();
+	
+	if (remainder != 0) {
+		limbs.push_back(remainder);
+	}
+	
+	trimLeadingZeros();
+	return *this;
+}
+
+// 移位运算符
+BigInt BigInt::operator<<(size_t bits) const {
+	BigInt result = *this;
+	result <<= bits;
+	return result;
+}
+
+BigInt BigInt::operator>>(size_t bits) const {
+	BigInt result = *this;
+	result >>= bits;
+	return result;
+}
+
+BigInt& BigInt::operator<<=(size_t bits) {
+	shiftLeftMagnitude(limbs, limbs, bits);
+	return *this;
+}
+
+BigInt& BigInt::operator>>=(size_t bits) {
+	shiftRightMagnitude(limbs, limbs, bits);
+	trimLeadingZeros();
 	return *this;
 }
 
 // 自增运算符
 BigInt& BigInt::operator++() {
-	*this += BigInt(1);
+	*this += 1LL;
 	return *this;
 }
 
@@ -434,7 +1374,7 @@ BigInt BigInt::operator++(int) {
 
 // 自减运算符
 BigInt& BigInt::operator--() {
-	*this -= BigInt(1);
+	*this -= 1LL;
 	return *this;
 }
 
@@ -461,15 +1401,7 @@ BigInt BigInt::operator-() const {
 
 // 输出流
 std::ostream& operator<<(std::ostream& os, const BigInt& num) {
-	if (num.isNegative) {
-		os << '-';
-	}
-	
-	for (int i = num.digits.size() - 1; i >= 0; i--) {
-		os << num.digits[i];
-	}
-	
-	return os;
+	return os << num.toString();
 }
 
 // 输入流
@@ -489,12 +1421,276 @@ std::istream& operator>>(std::istream& is, BigInt& num) {
 
 // 判断是否为零
 bool BigInt::isZero() const {
-	return digits.size() == 1 && digits[0] == 0;
+	return limbs.empty();
 }
 
-// 转换为字符串
+bool BigInt::isOdd() const {
+	return !limbs.empty() && (limbs[0] & 1) != 0;
+}
+
+int BigInt::sign() const {
+	return limbs.empty() ? 0 : (isNegative ? -1 : 1);
+}
+
+size_t BigInt::bitLength() const {
+	if (limbs.empty()) {
+		return 0;
+	}
+	
+	return limbs.size() * 64 - leadingZeros(limbs.back());
+}
+
+size_t BigInt::trailingZeroBits() const {
+	for (size_t i = 0; i < limbs.size(); i++) {
+		if (limbs[i] != 0) {
+			return i * 64 + trailingZeros(limbs[i]);
+		}
+	}
+	
+	return 0;
+}
+
+const BigInt::Limbs& BigInt::getLimbs() const {
+	return limbs;
+}
+
+BigInt BigInt::fromLimbs(const Limbs& limbs, bool negative) {
+	BigInt result;
+	result.limbs = limbs;
+	result.isNegative = negative;
+	result.trimLeadingZeros();
+	return result;
+}
+
+// 转换为字符串：大数分治转换，见 formatDecimal
 std::string BigInt::toString() const {
-	std::stringstream ss;
-	ss << *this;
-	return ss.str();
+	if (limbs.empty()) {
+		return "0";
+	}
+	
+	std::string result;
+	result.reserve(limbs.size() * 64 * 3 / 10 + 22); // log10(2) < 0.302，每个字不超过 19.3 位
+	
+	if (isNegative) {
+		result += '-';
+	}
+	
+	formatDecimal(result, limbs, 0);
+	return result;
+}
+
+// 10^(19 * 2^level)：每层只计算一次，deque 追加元素时不会使已返回的引用失效
+const BigInt::Limbs& BigInt::decimalPower(size_t level) {
+	static std::deque<Limbs> powers;
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
+	
+	if (powers.empty()) {
+		powers.push_back(Limbs(1, BIGINT_DECIMAL_BASE));
+	}
+	
+	while (powers.size() <= level) {
+		Limbs next;
+		mulMagnitude(next, powers.back(), powers.back());
+		powers.push_back(std::move(next));
+	}
+	
+	return powers[level];
+}
+
+// 十进制数字串转为绝对值：位数多时把末尾 19 * 2^level 位（不少于一半）作为低半，
+// 结果为 高半 * 10^(19 * 2^level) + 低半，两半递归转换，复杂度 O(M(n) log n)
+void BigInt::parseDecimal(Limbs& result, const char* digits, size_t length) {
+	if (length <= BIGINT_RADIX_THRESHOLD * BIGINT_DECIMAL_DIGITS) {
+		// 每次读入 19 位十进制数：乘以 10^19 再加上这一段的值；第一段取余下的位数
+		result.clear();
+		result.reserve(length / BIGINT_DECIMAL_DIGITS + 1);
+		size_t chunk = length % BIGINT_DECIMAL_DIGITS == 0 ? BIGINT_DECIMAL_DIGITS : length % BIGINT_DECIMAL_DIGITS;
+		
+		for (size_t i = 0; i < length; i += chunk, chunk = BIGINT_DECIMAL_DIGITS) {
+			uint64_t value = 0;
+			uint64_t scale = 1;
+			
+			for (size_t j = i; j < i + chunk; j++) {
+				value = value * 10 + (digits[j] - '0');
+				scale *= 10;
+			}
+			
+			mulSmall(result, scale, value);
+		}
+		
+		while (!result.empty() && result.back() == 0) {
+			result.pop_back();
+		}
+		
+		return;
+	}
+	
+	size_t level = 0;
+	
+	while ((size_t(BIGINT_DECIMAL_DIGITS) << (level + 1)) < length) {
+		level++;
+	}
+	
+	size_t lowLength = size_t(BIGINT_DECIMAL_DIGITS) << level;
+	Limbs high;
+	Limbs low;
+	parseDecimal(high, digits, length - lowLength);
+	parseDecimal(low, digits + length - lowLength, lowLength);
+	mulMagnitude(result, high, decimalPower(level));
+	addMagnitude(result, result, low);
+}
+
+// 一段 19 位以内的十进制数从后往前写入 buffer，返回写入的位数；width 不为 0 时补 0 到 width 位
+inline size_t formatChunk(char* end, uint64_t value, size_t width) {
+	size_t count = 0;
+	
+	do {
+		*--end = static_cast<char>('0' + value % 10);
+		value /= 10;
+		count++;
+	}
+	while (value != 0);
+	
+	for (; count < width; count++) {
+		*--end = '0';
+	}
+	
+	return count;
+}
+
+// 绝对值转为十进制追加到 out；width 不为 0 时补 0 到恰好 width 位。
+// 字数多时除以约为其平方根的 10^(19 * 2^level)，商与余数（补足 19 * 2^level 位）递归转换，复杂度 O(M(n) log n)
+void BigInt::formatDecimal(std::string& out, const Limbs& value, size_t width) {
+	if (value.size() <= BIGINT_RADIX_THRESHOLD) {
+		// 反复除以 10^19，每次得到 19 位十进制数，低位在前
+		Limbs rest = value;
+		uint64_t chunks[BIGINT_RADIX_THRESHOLD * 64 / 63 + 1];
+		size_t count = 0;
+		
+		while (!rest.empty()) {
+			chunks[count++] = divSmall(rest, BIGINT_DECIMAL_BASE);
+		}
+		
+		char buffer[(BIGINT_RADIX_THRESHOLD * 64 / 63 + 1) * BIGINT_DECIMAL_DIGITS];
+		char* end = buffer + sizeof(buffer);
+		char* begin = end;
+		
+		for (size_t i = 0; i + 1 < count; i++) {
+			begin -= formatChunk(begin, chunks[i], BIGINT_DECIMAL_DIGITS);
+		}
+		
+		if (count > 0) {
+			begin -= formatChunk(begin, chunks[count - 1], 0);
+		}
+		
+		size_t length = static_cast<size_t>(end - begin);
+		
+		if (width > length) {
+			out.append(width - length, '0');
+		}
+		
+		out.append(begin, end);
+		return;
+	}
+	
+	size_t level = 0;
+	
+	while (decimalPower(level + 1).size() * 2 <= value.size()) {
+		level++;
+	}
+	
+	size_t lowWidth = size_t(BIGINT_DECIMAL_DIGITS) << level;
+	Limbs quotient;
+	Limbs remainder;
+	divModMagnitude(quotient, remainder, value, decimalPower(level));
+	formatDecimal(out, quotient, width > lowWidth ? width - lowWidth : 0);
+	formatDecimal(out, remainder, lowWidth);
+}
+
+// 二进制序列化：8 字节小端头部为 字数 * 2 + 符号位，随后各字按小端顺序写出，不经过十进制
+std::string BigInt::serialize() const {
+	std::string bytes(8 * (limbs.size() + 1), '\0');
+	uint64_t header = static_cast<uint64_t>(limbs.size()) << 1 | (isNegative ? 1 : 0);
+	
+	for (size_t i = 0; i <= limbs.size(); i++) {
+		uint64_t word = i == 0 ? header : limbs[i - 1];
+		
+		for (size_t j = 0; j < 8; j++) {
+			bytes[8 * i + j] = static_cast<char>(word >> (8 * j) & 0xFF);
+		}
+	}
+	
+	return bytes;
+}
+
+void BigInt::serialize(std::ostream& os) const {
+	std::string bytes = serialize();
+	os.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// 读取一个小端的字
+inline uint64_t readLittleEndian(const char* bytes) {
+	uint64_t word = 0;
+	
+	for (size_t j = 0; j < 8; j++) {
+		word |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[j])) << (8 * j);
+	}
+	
+	return word;
+}
+
+// 由头部与各字构造结果；符号位置位而数值为 0（-0）不是 serialize 的输出，视为格式错误
+inline BigInt fromSerialized(const BigInt::Limbs& limbs, uint64_t header) {
+	BigInt result = BigInt::fromLimbs(limbs, header & 1);
+	
+	if ((header & 1) && result.isZero()) {
+		throw std::invalid_argument("Invalid serialized BigInt");
+	}
+	
+	return result;
+}
+
+BigInt BigInt::deserialize(const std::string& bytes) {
+	if (bytes.size() < 8 || bytes.size() % 8 != 0 || readLittleEndian(bytes.data()) >> 1 != bytes.size() / 8 - 1) {
+		throw std::invalid_argument("Invalid serialized BigInt");
+	}
+	
+	Limbs limbs(bytes.size() / 8 - 1);
+	
+	for (size_t i = 0; i < limbs.size(); i++) {
+		limbs[i] = readLittleEndian(bytes.data() + 8 * (i + 1));
+	}
+	
+	return fromSerialized(limbs, readLittleEndian(bytes.data()));
+}
+
+// 按块读取：字数来自不可信的头部，不预先按它分配内存，读到的数据不足时抛出 invalid_argument
+BigInt BigInt::deserialize(std::istream& is) {
+	char header[8];
+	
+	if (!is.read(header, 8)) {
+		throw std::invalid_argument("Invalid serialized BigInt");
+	}
+	
+	uint64_t count = readLittleEndian(header) >> 1;
+	Limbs limbs;
+	std::string chunk;
+	
+	for (uint64_t read = 0; read < count;) {
+		size_t words = static_cast<size_t>(std::min<uint64_t>(count - read, BIGINT_DESERIALIZE_CHUNK));
+		chunk.resize(8 * words);
+		
+		if (!is.read(&chunk[0], static_cast<std::streamsize>(chunk.size()))) {
+			throw std::invalid_argument("Invalid serialized BigInt");
+		}
+		
+		for (size_t i = 0; i < words; i++) {
+			limbs.push_back(readLittleEndian(chunk.data() + 8 * i));
+		}
+		
+		read += words;
+	}
+	
+	return fromSerialized(limbs, readLittleEndian(header));
 }
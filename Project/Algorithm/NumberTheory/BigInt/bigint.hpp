@@ -26,15 +26,353 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+// 64 位字（limb）上的基本运算：带进位加、带借位减、64x64->128 乘法与 128/64 除法
+// 有 __int128 时直接使用，MSVC 上使用对应的内建函数
+
+// 返回 a + b + carry 的低 64 位，carry 更新为新的进位
+inline uint64_t addCarry(uint64_t a, uint64_t b, uint64_t& carry) {
+	uint64_t sum = a + carry;
+	uint64_t next = sum < carry;
+	sum += b;
+	carry = next + (sum < b);
+	return sum;
+}
+
+// 返回 a - b - borrow 的低 64 位，borrow 更新为新的借位
+inline uint64_t subBorrow(uint64_t a, uint64_t b, uint64_t& borrow) {
+	uint64_t difference = a - b;
+	uint64_t next = a < b;
+	next += difference < borrow;
+	difference -= borrow;
+	borrow = next;
+	return difference;
+}
+
+// 返回 a * b 的低 64 位，high 为高 64 位
+inline uint64_t mulWide(uint64_t a, uint64_t b, uint64_t& high) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+	high = static_cast<uint64_t>(product >> 64);
+	return static_cast<uint64_t>(product);
+#else
+	return _umul128(a, b, &high);
+#endif
+}
+
+// (high * 2^64 + low) / divisor，要求 high < divisor；remainder 为余数
+inline uint64_t divWide(uint64_t high, uint64_t low, uint64_t divisor, uint64_t& remainder) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 dividend = (static_cast<unsigned __int128>(high) << 64) | low;
+	remainder = static_cast<uint64_t>(dividend % divisor);
+	return static_cast<uint64_t>(dividend / divisor);
+#else
+	return _udiv128(high, low, divisor, &remainder);
+#endif
+}
+
+// 最高位之前 0 的个数，要求 x != 0
+inline int leadingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_clzll(x);
+#else
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return 63 - static_cast<int>(index);
+#endif
+}
+
+// 最低位之后 0 的个数，要求 x != 0
+inline int trailingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(x);
+#else
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return static_cast<int>(index);
+#endif
+}
+
+// 内联存储的字数，绝对值不超过 2^128 - 1 的数不分配堆内存
+#define BIGINT_INLINE_LIMBS 2
+
+// 带内联存储的字数组：长度不超过 BIGINT_INLINE_LIMBS 时直接存放在对象内，超过后才转到堆上；
+// 清空或缩短时保留已有容量，接口是 BigInt 用到的 std::vector 子集
+class LimbVector {
+	public:
+		using value_type = uint64_t;
+		using iterator = uint64_t*;
+		using const_iterator = const uint64_t*;
+		
+	private:
+		uint64_t* pointer; // 指向 local 或堆上的缓冲区
+		size_t length;
+		size_t capacityLimbs;
+		uint64_t local[BIGINT_INLINE_LIMBS];
+		
+		bool isLocal() const {
+			return pointer == local;
+		}
+		
+		void release() {
+			if (!isLocal()) {
+				delete[] pointer;
+			}
+		}
+		
+		// 换用至少 required 个字的堆缓冲区，保留前 length 个字
+		void grow(size_t required) {
+			size_t newCapacity = std::max(required, 2 * capacityLimbs);
+			uint64_t* buffer = new uint64_t[newCapacity];
+			std::copy(pointer, pointer + length, buffer);
+			release();
+			pointer = buffer;
+			capacityLimbs = newCapacity;
+		}
+		
+		// 放弃堆缓冲区，回到内联存储的空数组
+		void reset() {
+			pointer = local;
+			length = 0;
+			capacityLimbs = BIGINT_INLINE_LIMBS;
+		}
+		
+		// 接管 other 的内容：堆缓冲区直接转移，内联存储逐字复制
+		void take(LimbVector& other) {
+			if (other.isLocal()) {
+				assign(other.begin(), other.end());
+			}
+			else {
+				release();
+				pointer = other.pointer;
+				length = other.length;
+				capacityLimbs = other.capacityLimbs;
+				other.reset();
+			}
+		}
+		
+	public:
+		LimbVector() : pointer(local), length(0), capacityLimbs(BIGINT_INLINE_LIMBS) {}
+		
+		explicit LimbVector(size_t count, uint64_t value = 0) : LimbVector() {
+			assign(count, value);
+		}
+		
+		template<typename Iterator, typename = typename std::enable_if<!std::is_integral<Iterator>::value>::type>
+		LimbVector(Iterator first, Iterator last) : LimbVector() {
+			assign(first, last);
+		}
+		
+		LimbVector(const std::vector<uint64_t>& values) : LimbVector(values.begin(), values.end()) {}
+		
+		LimbVector(const LimbVector& other) : LimbVector() {
+			assign(other.begin(), other.end());
+		}
+		
+		LimbVector(LimbVector&& other) noexcept : LimbVector() {
+			take(other);
+		}
+		
+		~LimbVector() {
+			release();
+		}
+		
+		LimbVector& operator=(const LimbVector& other) {
+			if (this != &other) {
+				assign(other.begin(), other.end());
+			}
+			
+			return *this;
+		}
+		
+		LimbVector& operator=(LimbVector&& other) noexcept {
+			if (this != &other) {
+				take(other);
+			}
+			
+			return *this;
+		}
+		
+		size_t size() const {
+			return length;
+		}
+		
+		size_t capacity() const {
+			return capacityLimbs;
+		}
+		
+		bool empty() const {
+			return length == 0;
+		}
+		
+		uint64_t* data() {
+			return pointer;
+		}
+		
+		const uint64_t* data() const {
+			return pointer;
+		}
+		
+		iterator begin() {
+			return pointer;
+		}
+		
+		iterator end() {
+			return pointer + length;
+		}
+		
+		const_iterator begin() const {
+			return pointer;
+		}
+		
+		const_iterator end() const {
+			return pointer + length;
+		}
+		
+		uint64_t& operator[](size_t index) {
+			return pointer[index];
+		}
+		
+		const uint64_t& operator[](size_t index) const {
+			return pointer[index];
+		}
+		
+		uint64_t& back() {
+			return pointer[length - 1];
+		}
+		
+		const uint64_t& back() const {
+			return pointer[length - 1];
+		}
+		
+		void reserve(size_t count) {
+			if (count > capacityLimbs) {
+				grow(count);
+			}
+		}
+		
+		void resize(size_t count, uint64_t value = 0) {
+			reserve(count);
+			
+			if (count > length) {
+				std::fill(pointer + length, pointer + count, value);
+			}
+			
+			length = count;
+		}
+		
+		void assign(size_t count, uint64_t value) {
+			length = 0;
+			resize(count, value);
+		}
+		
+		// [first, last) 不能位于本数组之内
+		template<typename Iterator, typename = typename std::enable_if<!std::is_integral<Iterator>::value>::type>
+		void assign(Iterator first, Iterator last) {
+			length = 0;
+			reserve(static_cast<size_t>(std::distance(first, last)));
+			length = std::copy(first, last, pointer) - pointer;
+		}
+		
+		// [first, last) 不能位于本数组之内
+		template<typename Iterator>
+		iterator insert(const_iterator position, Iterator first, Iterator last) {
+			size_t index = position - pointer;
+			size_t count = static_cast<size_t>(std::distance(first, last));
+			reserve(length + count);
+			std::copy_backward(pointer + index, pointer + length, pointer + length + count);
+			std::copy(first, last, pointer + index);
+			length += count;
+			return pointer + index;
+		}
+		
+		void clear() {
+			length = 0;
+		}
+		
+		void push_back(uint64_t value) {
+			if (length == capacityLimbs) {
+				grow(length + 1);
+			}
+			
+			pointer[length++] = value;
+		}
+		
+		void pop_back() {
+			length--;
+		}
+		
+		void swap(LimbVector& other) {
+			if (!isLocal() && !other.isLocal()) {
+				std::swap(pointer, other.pointer);
+				std::swap(length, other.length);
+				std::swap(capacityLimbs, other.capacityLimbs);
+				return;
+			}
+			
+			LimbVector temporary(std::move(other));
+			other = std::move(*this);
+			*this = std::move(temporary);
+		}
+		
+		bool operator==(const LimbVector& other) const {
+			return length == other.length && std::equal(begin(), end(), other.begin());
+		}
+		
+		bool operator!=(const LimbVector& other) const {
+			return !(*this == other);
+		}
+};
 
 class BigInt {
+	public:
+		using Limbs = LimbVector;
+		
 	private:
 		bool isNegative; // 符号位，true表示负数
-		std::vector<int> digits; // 存储每一位数字，低位在前
+		Limbs limbs; // 绝对值按 2^64 进制存储，低位在前；零时为空
 		
-		// 去除前导零
+		// 去除高位的零字
 		void trimLeadingZeros();
 		
+		// *this += (negative ? -magnitude : magnitude)，原地完成
+		void addSigned(const Limbs& magnitude, bool negative);
+		
+		// 与 long long 比较：返回 -1、0 或 1
+		int compare(long long other) const;
+		
+		// 绝对值上的运算，均不处理符号；结果可以与操作数是同一个对象
+		static int compareMagnitude(const Limbs& a, const Limbs& b);
+		static void addMagnitude(Limbs& result, const Limbs& a, const Limbs& b);
+		static void subMagnitude(Limbs& result, const Limbs& a, const Limbs& b); // 要求 |a| >= |b|
+		static void mulMagnitude(Limbs& result, const Limbs& a, const Limbs& b);
+		// 按规模分级的乘法：result 为 n + m 个字，覆盖写入，不能与操作数重叠；a 与 b 为同一段内存时按平方计算
+		static void mulLimbs(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m);
+		static void sqrLimbs(uint64_t* result, const uint64_t* a, size_t n);
+		static void mulKaratsuba(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m);
+		static void mulToom3(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m);
+		static void mulNtt(uint64_t* result, const uint64_t* a, size_t n, const uint64_t* b, size_t m);
+		static void mulSmall(Limbs& a, uint64_t factor, uint64_t addend); // a = a * factor + addend
+		static uint64_t divSmall(Limbs& a, uint64_t divisor); // a /= divisor，返回余数
+		static uint64_t modSmall(const Limbs& a, uint64_t divisor); // a % divisor，不修改 a
+		static void divModMagnitude(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b);
+		static void divKnuth(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b); // 要求 b 至少两个字
+		static void divNewton(Limbs& quotient, Limbs& remainder, const Limbs& a, const Limbs& b);
+		static void reciprocalMagnitude(Limbs& result, const Limbs& b, size_t bits); // 约为 2^(2 * bits) / (b 的高 bits 位)，b 最高位为 1
+		static void shiftLeftMagnitude(Limbs& result, const Limbs& a, size_t bits);
+		static void shiftRightMagnitude(Limbs& result, const Limbs& a, size_t bits);
+		// 十进制转换：分治时用到的 10^(19 * 2^level) 缓存，以及数字串与绝对值的互相转换
+		static const Limbs& decimalPower(size_t level);
+		static void parseDecimal(Limbs& result, const char* digits, size_t length);
+		static void formatDecimal(std::string& out, const Limbs& value, size_t width); // width 不为 0 时补 0 到恰好 width 位
+		
 	public:
 		// 构造函数
 		BigInt();
@@ -64,16 +402,41 @@ class BigInt {
 		BigInt operator+(const BigInt& other) const;
 		BigInt operator-(const BigInt& other) const;
 		BigInt operator*(const BigInt& other) const;
-		BigInt operator/(const BigInt& other) const;
-		BigInt operator%(const BigInt& other) const;
+		BigInt operator/(const BigInt& other) const; // 向零取整
+		BigInt operator%(const BigInt& other) const; // 余数与被除数同号
+		std::pair<BigInt, BigInt> divmod(const BigInt& other) const; // 一次除法同时得到商与余数，规则同 / 与 %
 		
-		// 复合赋值运算符
+		// 复合赋值运算符：原地修改，尽量复用已有容量
 		BigInt& operator+=(const BigInt& other);
 		BigInt& operator-=(const BigInt& other);
 		BigInt& operator*=(const BigInt& other);
 		BigInt& operator/=(const BigInt& other);
 		BigInt& operator%=(const BigInt& other);
 		
+		// 与 long long 直接运算：不构造临时 BigInt，乘除只做一趟逐字运算
+		bool operator==(long long other) const;
+		bool operator!=(long long other) const;
+		bool operator<(long long other) const;
+		bool operator>(long long other) const;
+		bool operator<=(long long other) const;
+		bool operator>=(long long other) const;
+		BigInt operator+(long long other) const;
+		BigInt operator-(long long other) const;
+		BigInt operator*(long long other) const;
+		BigInt operator/(long long other) const;
+		BigInt operator%(long long other) const;
+		BigInt& operator+=(long long other);
+		BigInt& operator-=(long long other);
+		BigInt& operator*=(long long other);
+		BigInt& operator/=(long long other);
+		BigInt& operator%=(long long other);
+		
+		// 移位运算符：作用于绝对值，符号不变（右移向零取整）
+		BigInt operator<<(size_t bits) const;
+		BigInt operator>>(size_t bits) const;
+		BigInt& operator<<=(size_t bits);
+		BigInt& operator>>=(size_t bits);
+		
 		// 自增自减运算符
 		BigInt& operator++(); // 前置++
 		BigInt operator++(int); // 后置++
@@ -89,8 +452,21 @@ class BigInt {
 		friend std::istream& operator>>(std::istream& is, BigInt& num);
 		
 		// 其他方法
+		BigInt square() const; // 平方：交叉项只算一次，约为一般乘法的一半工作量
 		bool isZero() const;
+		bool isOdd() const;
+		int sign() const; // -1、0 或 1
+		size_t bitLength() const; // 绝对值的二进制位数，零为 0
+		size_t trailingZeroBits() const; // 绝对值末尾 0 的个数，零为 0
+		const Limbs& getLimbs() const; // 绝对值的各字，低位在前
+		static BigInt fromLimbs(const Limbs& limbs, bool negative = false);
 		std::string toString() const;
+		
+		// 二进制序列化，格式与平台字节序无关；deserialize 在数据不完整或格式错误时抛出异常
+		std::string serialize() const;
+		void serialize(std::ostream& os) const;
+		static BigInt deserialize(const std::string& bytes);
+		static BigInt deserialize(std::istream& is);
 };
 
 BigInt abs(BigInt num) {
@@ -22,49 +22,33 @@
 
 #pragma once
 #include"../BigInt/bigint.hpp"
+#include"../PrimeFactorization/PrimeFactorization.h"
+#include"../Sieve/Sieve.h"
 
+// 由质因数分解计算：φ(n) = n Π (1 - 1/p)，p 取遍 n 的不同质因子
 BigInt euler_phi(BigInt n) {
+	if (n <= 1)
+		return n;
+		
 	BigInt ans = n;
+	std::vector<BigInt> factors = factorize(n);
 	
-	for (BigInt i = 2; i * i <= n; i++)
-		if (n % i == 0) {
-			ans = ans / i * (i - 1);
+	for (size_t i = 0; i < factors.size(); i++) {
+		if (i > 0 && factors[i] == factors[i - 1])
+			continue;
 			
-			while (n % i == 0)
-				n /= i;
-		}
-		
-	if (n > 1)
-		ans = ans / n * (n - 1);
-		
+		ans /= factors[i];
+		ans *= factors[i] - 1;
+	}
+	
 	return ans;
 }
 
-// 线性筛法求欧拉函数
+// 欧拉函数表 phi[0..n]，phi[0] = 0；由分段筛逐段填入，需要更大的范围时直接使用 sieveEulerPhi 流式处理
 std::vector<int> linearEulerSieve(int n) {
 	std::vector<int> phi(n + 1);
-	std::vector<bool> isPrime(n + 1, true);
-	std::vector<int> primes;
-	phi[1] = 1;
-	
-	for (int i = 2; i <= n; ++i) {
-		if (isPrime[i]) {
-			primes.push_back(i);
-			phi[i] = i - 1;
-		}
-		
-		for (size_t j = 0; j < primes.size() && i * primes[j] <= n; ++j) {
-			isPrime[i * primes[j]] = false;
-			
-			if (i % primes[j] == 0) {
-				phi[i * primes[j]] = phi[i] * primes[j];
-				break;
-			}
-			else {
-				phi[i * primes[j]] = phi[i] * (primes[j] - 1);
-			}
-		}
-	}
-	
+	sieveEulerPhi(1, uint64_t(n) + 1, [&phi](uint64_t i, uint64_t value) {
+		phi[i] = static_cast<int>(value);
+	});
 	return phi;
 }
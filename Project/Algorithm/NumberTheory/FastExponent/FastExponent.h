@@ -22,32 +22,23 @@
 
 #pragma once
 #include"../BigInt/bigint.hpp"
+#include"../ModContext/ModContext.h"
 
 BigInt fastPow(BigInt a, BigInt b) {
 	BigInt res = 1;
 	
 	while (b > 0) {
-		if (b % BigInt("2") == 0)
+		if (b.isOdd())
 			res = res * a;
 			
-		a = a * a;
+		a = a.square();
 		b /= 2;
 	}
 	
 	return res;
 }
 
+// 模数只用一次时也借助 ModContext：预计算的代价远小于逐次取模的除法
 BigInt fastPowMod(BigInt a, BigInt b, BigInt mod) {
-	a %= mod;
-	BigInt res = 1;
-	
-	while (b > 0) {
-		if (b % BigInt("2") == 0)
-			res = res * a % mod;
-			
-		a = a * a % mod;
-		b /= 2;
-	}
-	
-	return res;
+	return ModContext(mod).powmod(a, b);
 }
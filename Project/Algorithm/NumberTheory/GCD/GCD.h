@@ -23,12 +23,210 @@
 #pragma once
 #include"../BigInt/bigint.hpp"
 
-BigInt gcd(BigInt a, BigInt b) {
+// 两数都不超过此字数时只用二进制 GCD，更大时先用 Lehmer 算法把规模降下来
+#define GCD_LEHMER_THRESHOLD 2
+
+// 一个字的二进制 GCD（Stein 算法）：只用移位与减法
+inline uint64_t binaryGcd(uint64_t a, uint64_t b) {
+	if (a == 0)
+		return b;
+		
+	if (b == 0)
+		return a;
+		
+	int shift = trailingZeros(a | b);
+	a >>= trailingZeros(a);
+	
 	while (b != 0) {
-		BigInt tmp = a;
-		a = b;
-		b = tmp % b;
+		b >>= trailingZeros(b);
+		
+		if (a > b)
+			std::swap(a, b);
+			
+		b -= a;
+	}
+	
+	return a << shift;
+}
+
+// 多字的二进制 GCD：a、b 非负，原地移位与相减，两数都降到一个字后转为单字版本
+inline BigInt binaryGcd(BigInt a, BigInt b) {
+	if (a.isZero())
+		return b;
+		
+	if (b.isZero())
+		return a;
+		
+	size_t shift = std::min(a.trailingZeroBits(), b.trailingZeroBits());
+	a >>= a.trailingZeroBits();
+	
+	while (!b.isZero()) {
+		b >>= b.trailingZeroBits();
+		
+		if (a.getLimbs().size() == 1 && b.getLimbs().size() == 1) {
+			a = BigInt::fromLimbs(BigInt::Limbs(1, binaryGcd(a.getLimbs()[0], b.getLimbs()[0])));
+			break;
+		}
+		
+		if (a > b)
+			std::swap(a, b);
+			
+		b -= a;
+	}
+	
+	return a << shift;
+}
+
+// x >> shift 的低 64 位
+inline uint64_t topBits(const BigInt& x, size_t shift) {
+	const BigInt::Limbs& limbs = x.getLimbs();
+	size_t index = shift / 64;
+	unsigned offset = shift % 64;
+	uint64_t low = index < limbs.size() ? limbs[index] >> offset : 0;
+	uint64_t high = offset != 0 && index + 1 < limbs.size() ? limbs[index + 1] << (64 - offset) : 0;
+	return low | high;
+}
+
+// Lehmer 算法的一步（Knuth 算法 L）：a >= b > 0，取两数对齐后的最高 62 位模拟辗转相除，
+// 只要两个端点估计出的商相同就继续，得到矩阵 [[A, B], [C, D]]，
+// 使 (A * a + B * b, C * a + D * b) 等于真正做这些步之后的结果；模拟一步都不能确定时返回 false
+inline bool lehmerMatrix(const BigInt& a, const BigInt& b, long long matrix[4]) {
+	size_t bits = a.bitLength();
+	size_t shift = bits > 62 ? bits - 62 : 0;
+	long long ah = static_cast<long long>(topBits(a, shift));
+	long long bh = static_cast<long long>(topBits(b, shift));
+	long long A = 1, B = 0, C = 0, D = 1;
+	
+	while (bh + C > 0 && bh + D > 0 && ah + A >= 0 && ah + B >= 0) {
+		long long q = (ah + A) / (bh + C);
+		
+		if (q != (ah + B) / (bh + D))
+			break;
+			
+		long long t = A - q * C;
+		A = C;
+		C = t;
+		t = B - q * D;
+		B = D;
+		D = t;
+		t = ah - q * bh;
+		ah = bh;
+		bh = t;
+	}
+	
+	matrix[0] = A;
+	matrix[1] = B;
+	matrix[2] = C;
+	matrix[3] = D;
+	return B != 0;
+}
+
+// 最大公约数（非负）：大数先用 Lehmer 算法，每步用单字运算代替约 30 位的多字除法，
+// 降到 GCD_LEHMER_THRESHOLD 个字以内后用二进制 GCD
+BigInt gcd(const BigInt& a, const BigInt& b) {
+	BigInt x = abs(a);
+	BigInt y = abs(b);
+	
+	if (x < y)
+		std::swap(x, y);
+		
+	while (y.getLimbs().size() > GCD_LEHMER_THRESHOLD) {
+		long long m[4];
+		
+		if (lehmerMatrix(x, y, m)) {
+			BigInt nextX = x * m[0] + y * m[1];
+			y = x * m[2] + y * m[3];
+			x = std::move(nextX);
+		}
+		else {
+			x %= y;
+			std::swap(x, y);
+		}
+	}
+	
+	// 两数规模相差悬殊时先做一次除法
+	if (!y.isZero() && x.getLimbs().size() > y.getLimbs().size() + 1)
+		x %= y;
+		
+	return binaryGcd(std::move(x), std::move(y));
+}
+
+// 扩展欧几里得：返回 g = gcd(a, b) >= 0，并求出 x、y 使 a * x + b * y = g；
+// 与 gcd 共用 Lehmer 步，同时用同一矩阵更新 a 的系数，b 的系数最后由 (g - a * x) / b 得到
+BigInt extended_gcd(const BigInt& a, const BigInt& b, BigInt& x, BigInt& y) {
+	BigInt r0 = abs(a);
+	BigInt r1 = abs(b);
+	BigInt s0 = 1;
+	BigInt s1 = 0;
+	
+	while (!r1.isZero()) {
+		long long m[4];
+		
+		if (r0 >= r1 && r1.getLimbs().size() > 1 && lehmerMatrix(r0, r1, m)) {
+			BigInt nextR = r0 * m[0] + r1 * m[1];
+			r1 = r0 * m[2] + r1 * m[3];
+			r0 = std::move(nextR);
+			BigInt nextS = s0 * m[0] + s1 * m[1];
+			s1 = s0 * m[2] + s1 * m[3];
+			s0 = std::move(nextS);
+		}
+		else {
+			std::pair<BigInt, BigInt> qr = r0.divmod(r1);
+			r0 = std::move(r1);
+			r1 = std::move(qr.second);
+			s0 -= qr.first * s1;
+			std::swap(s0, s1);
+		}
+	}
+	
+	x = a < 0 ? -s0 : s0;
+	y = b.isZero() ? BigInt(0) : (r0 - abs(a) * s0) / abs(b);
+	
+	if (b < 0)
+		y = -y;
+		
+	return r0;
+}
+
+// 模逆元：返回 [0, m) 内的 x 使 a * x ≡ 1 (mod m)，不存在时抛出异常
+BigInt modinv(const BigInt& a, const BigInt& m) {
+	if (m <= 0)
+		throw std::runtime_error("Modulus must be positive");
+		
+	BigInt x, y;
+	
+	if (extended_gcd(a, m, x, y) != 1)
+		throw std::runtime_error("Modular inverse does not exist");
+		
+	x %= m;
+	return x < 0 ? x + m : x;
+}
+
+// 一个字的模逆元：扩展欧几里得只用单字运算，系数只记绝对值，它们的符号逐步交替；
+// 单独命名而不重载 modinv，以免 int 实参（包括负数）被隐式转换为 uint64_t
+inline uint64_t modinvWord(uint64_t a, uint64_t m) {
+	if (m == 0)
+		throw std::runtime_error("Modulus must be positive");
+		
+	uint64_t r0 = m;
+	uint64_t r1 = a % m;
+	uint64_t s0 = 0;
+	uint64_t s1 = 1;
+	bool negative = true; // r0 ≡ ±s0 * a (mod m) 中的符号
+	
+	while (r1 != 0) {
+		uint64_t q = r0 / r1;
+		uint64_t r = r0 - q * r1;
+		r0 = r1;
+		r1 = r;
+		uint64_t s = s0 + q * s1;
+		s0 = s1;
+		s1 = s;
+		negative = !negative;
 	}
 	
-	return a;
+	if (r0 != 1)
+		throw std::runtime_error("Modular inverse does not exist");
+		
+	return negative ? (m - s0) % m : s0 % m;
 }
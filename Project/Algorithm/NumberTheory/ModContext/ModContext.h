@@ -0,0 +1,533 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+#include"../BigInt/bigint.hpp"
+
+// 同一个模数下反复做模乘时使用的上下文：构造时一次性预计算常数，之后的 mulmod、sqrmod、powmod 不再做大整数除法
+// 模数不超过一个字时用 128 位乘除直接计算；奇数模数用 Montgomery 约化；偶数模数用 Barrett 约化
+
+// 一个字的模乘：a、b 都小于 mod
+inline uint64_t mulmod(uint64_t a, uint64_t b, uint64_t mod) {
+	uint64_t high;
+	uint64_t low = mulWide(a, b, high);
+	uint64_t remainder;
+	divWide(high, low, mod, remainder);
+	return remainder;
+}
+
+// 一个字的模幂
+inline uint64_t powmod(uint64_t base, uint64_t exponent, uint64_t mod) {
+	uint64_t result = 1 % mod;
+	base %= mod;
+	
+	for (; exponent != 0; exponent >>= 1) {
+		if (exponent & 1) {
+			result = mulmod(result, base, mod);
+		}
+		
+		base = mulmod(base, base, mod);
+	}
+	
+	return result;
+}
+
+// 滑动窗口快速幂：只预计算底数的奇数次幂 base^1, base^3, ..., base^(2^width - 1)，
+// 从高位扫描指数，每遇到一段以 1 结尾的窗口做一次乘法，窗口宽度随指数位数增大
+// multiply(target, a, b) 计算 target = a * b，target 可以与 a、b 是同一个对象
+template<typename Element, typename Multiply>
+Element slidingWindowPower(const Element& one, const Element& base, const BigInt& exponent, Multiply multiply) {
+	size_t bits = exponent.bitLength();
+	
+	if (bits == 0) {
+		return one;
+	}
+	
+	size_t width = bits > 671 ? 6 : bits > 239 ? 5 : bits > 79 ? 4 : bits > 23 ? 3 : bits > 6 ? 2 : 1;
+	size_t tableSize = size_t(1) << (width - 1);
+	Element table[32]; // 窗口宽度不超过 6，放在栈上避免每次分配
+	table[0] = base;
+	
+	if (tableSize > 1) {
+		Element baseSquared = base;
+		multiply(baseSquared, base, base);
+		
+		for (size_t i = 1; i < tableSize; i++) {
+			multiply(table[i], table[i - 1], baseSquared);
+		}
+	}
+	
+	const BigInt::Limbs& limbs = exponent.getLimbs();
+	auto bit = [&limbs](size_t index) {
+		return (limbs[index / 64] >> (index % 64)) & 1;
+	};
+	Element result = one;
+	bool started = false;
+	
+	for (size_t i = bits; i > 0;) {
+		if (!bit(i - 1)) {
+			multiply(result, result, result);
+			i--;
+			continue;
+		}
+		
+		// 窗口为指数的第 low 位到第 i - 1 位，最低位为 1
+		size_t low = i > width ? i - width : 0;
+		
+		while (!bit(low)) {
+			low++;
+		}
+		
+		size_t value = 0;
+		
+		for (size_t j = i; j > low; j--) {
+			value = value << 1 | bit(j - 1);
+		}
+		
+		if (started) {
+			for (size_t j = low; j < i; j++) {
+				multiply(result, result, result);
+			}
+			
+			multiply(result, result, table[value >> 1]);
+		}
+		else {
+			result = table[value >> 1];
+			started = true;
+		}
+		
+		i = low;
+	}
+	
+	return result;
+}
+
+// 一个字的 Montgomery 约化：奇数模数 m < 2^64，R = 2^64；剩余类 x 表示为 x * R mod m，
+// 模乘只需要两次 64 位乘法与一次比较，没有 128 位除法
+class MontgomeryWord {
+	private:
+		uint64_t modulus;
+		uint64_t inverse; // m^(-1) mod 2^64
+		uint64_t radix; // R mod m，即 Montgomery 形式的 1
+		uint64_t squaredRadix; // R^2 mod m
+		
+		// (high * 2^64 + low) / R mod m，要求 high < m
+		uint64_t reduce(uint64_t high, uint64_t low) const {
+			// factor * m 与 low 的低 64 位相同，相减后低位恰好为 0
+			uint64_t factorHigh;
+			mulWide(low * inverse, modulus, factorHigh);
+			return high >= factorHigh ? high - factorHigh : high - factorHigh + modulus;
+		}
+		
+	public:
+		MontgomeryWord() : modulus(1), inverse(1), radix(0), squaredRadix(0) {}
+		
+		explicit MontgomeryWord(uint64_t modulus) : modulus(modulus), inverse(modulus) {
+			if (modulus % 2 == 0) {
+				throw std::runtime_error("Montgomery modulus must be odd");
+			}
+			
+			// 牛顿迭代求 2^64 下的逆元，每次有效位翻倍
+			for (int i = 0; i < 5; i++) {
+				inverse *= 2 - modulus * inverse;
+			}
+			
+			radix = (0 - modulus) % modulus;
+			squaredRadix = ::mulmod(radix, radix, modulus);
+		}
+		
+		uint64_t getModulus() const {
+			return modulus;
+		}
+		
+		uint64_t one() const {
+			return radix;
+		}
+		
+		// 普通形式与 Montgomery 形式互相转换
+		uint64_t toMontgomery(uint64_t x) const {
+			return multiply(x % modulus, squaredRadix);
+		}
+		
+		uint64_t fromMontgomery(uint64_t x) const {
+			return reduce(0, x);
+		}
+		
+		// 参数与结果都是 Montgomery 形式
+		uint64_t multiply(uint64_t a, uint64_t b) const {
+			uint64_t high;
+			uint64_t low = mulWide(a, b, high);
+			return reduce(high, low);
+		}
+		
+		uint64_t power(uint64_t base, uint64_t exponent) const {
+			uint64_t result = radix;
+			
+			for (; exponent != 0; exponent >>= 1) {
+				if (exponent & 1) {
+					result = multiply(result, base);
+				}
+				
+				base = multiply(base, base);
+			}
+			
+			return result;
+		}
+		
+		// 普通形式的模乘与模幂
+		uint64_t mulmod(uint64_t a, uint64_t b) const {
+			return fromMontgomery(multiply(toMontgomery(a), toMontgomery(b)));
+		}
+		
+		uint64_t powmod(uint64_t base, uint64_t exponent) const {
+			return fromMontgomery(power(toMontgomery(base), exponent));
+		}
+};
+
+// Montgomery 约化：模数 m 为奇数、占 n 个字，R = 2^(64n)；剩余类 x 表示为 x * R mod m，
+// 两数相乘后逐字消去低位（CIOS），只用乘法与加法即可除以 R
+class MontgomeryContext {
+	private:
+		BigInt modulus;
+		size_t size; // 模数的字数 n
+		uint64_t negativeInverse; // -m^(-1) mod 2^64
+		BigInt::Limbs squaredRadix; // R^2 mod m，补齐为 n 个字
+		BigInt::Limbs radix; // R mod m，即 Montgomery 形式的 1
+		
+		// 把 [0, m) 内的数补齐为 n 个字
+		BigInt::Limbs pad(const BigInt& a) const {
+			BigInt::Limbs limbs = a.getLimbs();
+			limbs.resize(size, 0);
+			return limbs;
+		}
+		
+		// result = a * b / R mod m；buffer 至少 n + 2 个字，result 可以与 a、b 是同一个对象
+		void multiply(BigInt::Limbs& result, const BigInt::Limbs& a, const BigInt::Limbs& b, BigInt::Limbs& buffer) const {
+			const BigInt::Limbs& m = modulus.getLimbs();
+			size_t n = size;
+			uint64_t* t = buffer.data();
+			std::fill(t, t + n + 2, 0);
+			
+			for (size_t i = 0; i < n; i++) {
+				// t += a * b[i]
+				uint64_t carry = 0;
+				
+				for (size_t j = 0; j < n; j++) {
+					uint64_t high;
+					uint64_t low = mulWide(a[j], b[i], high);
+					uint64_t c = 0;
+					low = addCarry(low, t[j], c);
+					high += c;
+					c = 0;
+					t[j] = addCarry(low, carry, c);
+					carry = high + c;
+				}
+				
+				uint64_t c = 0;
+				t[n] = addCarry(t[n], carry, c);
+				t[n + 1] = c;
+				// t = (t + factor * m) / 2^64，factor 使最低字为 0
+				uint64_t factor = t[0] * negativeInverse;
+				uint64_t high;
+				uint64_t low = mulWide(factor, m[0], high);
+				c = 0;
+				addCarry(low, t[0], c);
+				carry = high + c;
+				
+				for (size_t j = 1; j < n; j++) {
+					low = mulWide(factor, m[j], high);
+					c = 0;
+					low = addCarry(low, t[j], c);
+					high += c;
+					c = 0;
+					t[j - 1] = addCarry(low, carry, c);
+					carry = high + c;
+				}
+				
+				c = 0;
+				t[n - 1] = addCarry(t[n], carry, c);
+				t[n] = t[n + 1] + c;
+			}
+			
+			// 此时 t < 2m，最多减一次 m
+			bool subtract = t[n] != 0;
+			
+			if (!subtract) {
+				size_t i = n;
+				
+				while (i > 0 && t[i - 1] == m[i - 1]) {
+					i--;
+				}
+				
+				subtract = i == 0 || t[i - 1] > m[i - 1];
+			}
+			
+			result.resize(n);
+			uint64_t borrow = 0;
+			
+			for (size_t i = 0; i < n; i++) {
+				result[i] = subtract ? subBorrow(t[i], m[i], borrow) : t[i];
+			}
+		}
+		
+	public:
+		MontgomeryContext() : size(0), negativeInverse(0) {}
+		
+		explicit MontgomeryContext(const BigInt& modulus) : modulus(modulus), size(modulus.getLimbs().size()) {
+			if (modulus.sign() <= 0 || !modulus.isOdd()) {
+				throw std::runtime_error("Montgomery modulus must be positive and odd");
+			}
+			
+			uint64_t low = modulus.getLimbs()[0];
+			uint64_t inverse = low; // 牛顿迭代求 2^64 下的逆元，每次有效位翻倍
+			
+			for (int i = 0; i < 5; i++) {
+				inverse *= 2 - low * inverse;
+			}
+			
+			negativeInverse = 0 - inverse;
+			BigInt::Limbs power(size + 1, 0);
+			power.back() = 1;
+			radix = pad(BigInt::fromLimbs(power) % modulus);
+			power.assign(2 * size + 1, 0);
+			power.back() = 1;
+			squaredRadix = pad(BigInt::fromLimbs(power) % modulus);
+		}
+		
+		const BigInt& getModulus() const {
+			return modulus;
+		}
+		
+		// 以下参数都要求在 [0, m) 内
+		BigInt mulmod(const BigInt& a, const BigInt& b) const {
+			BigInt::Limbs buffer(size + 2);
+			BigInt::Limbs result;
+			// a * b / R 再乘以 R^2 / R，恰好得到 a * b mod m
+			multiply(result, pad(a), pad(b), buffer);
+			multiply(result, result, squaredRadix, buffer);
+			return BigInt::fromLimbs(result);
+		}
+		
+		BigInt sqrmod(const BigInt& a) const {
+			BigInt::Limbs buffer(size + 2);
+			BigInt::Limbs result = pad(a);
+			multiply(result, result, result, buffer);
+			multiply(result, result, squaredRadix, buffer);
+			return BigInt::fromLimbs(result);
+		}
+		
+		BigInt powmod(const BigInt& base, const BigInt& exponent) const {
+			BigInt::Limbs buffer(size + 2);
+			BigInt::Limbs element;
+			multiply(element, pad(base), squaredRadix, buffer);
+			BigInt::Limbs result = slidingWindowPower(radix, element, exponent, [this, &buffer](BigInt::Limbs & target, const BigInt::Limbs & a, const BigInt::Limbs & b) {
+				multiply(target, a, b, buffer);
+			});
+			BigInt::Limbs one(size, 0);
+			one[0] = 1;
+			multiply(result, result, one, buffer);
+			return BigInt::fromLimbs(result);
+		}
+};
+
+// Barrett 约化：模数 m 占 n 个字，预计算 mu = floor(2^(128n) / m)，
+// 对 x < 2^(128n) 用 q = ((x >> 64(n - 1)) * mu) >> 64(n + 1) 估计商，估计值最多偏小 2
+class BarrettContext {
+	private:
+		BigInt modulus;
+		size_t size;
+		BigInt factor; // mu
+		
+		// x >> 64 * words
+		static BigInt dropLimbs(const BigInt& x, size_t words) {
+			const BigInt::Limbs& limbs = x.getLimbs();
+			
+			if (words >= limbs.size()) {
+				return BigInt();
+			}
+			
+			return BigInt::fromLimbs(BigInt::Limbs(limbs.begin() + words, limbs.end()));
+		}
+		
+	public:
+		BarrettContext() : size(0) {}
+		
+		explicit BarrettContext(const BigInt& modulus) : modulus(modulus), size(modulus.getLimbs().size()) {
+			if (modulus.sign() <= 0) {
+				throw std::runtime_error("Barrett modulus must be positive");
+			}
+			
+			BigInt::Limbs power(2 * size + 1, 0);
+			power.back() = 1;
+			factor = BigInt::fromLimbs(power) / modulus;
+		}
+		
+		const BigInt& getModulus() const {
+			return modulus;
+		}
+		
+		// 要求 0 <= x < m^2
+		BigInt reduce(const BigInt& x) const {
+			BigInt quotient = dropLimbs(dropLimbs(x, size - 1) * factor, size + 1);
+			BigInt remainder = x - quotient * modulus;
+			
+			while (remainder >= modulus) {
+				remainder -= modulus;
+			}
+			
+			return remainder;
+		}
+		
+		// 以下参数都要求在 [0, m) 内
+		BigInt mulmod(const BigInt& a, const BigInt& b) const {
+			return reduce(a * b);
+		}
+		
+		BigInt sqrmod(const BigInt& a) const {
+			return reduce(a.square());
+		}
+		
+		BigInt powmod(const BigInt& base, const BigInt& exponent) const {
+			return slidingWindowPower(reduce(BigInt(1)), base, exponent, [this](BigInt & target, const BigInt & a, const BigInt & b) {
+				target = &a == &b ? reduce(a.square()) : reduce(a * b);
+			});
+		}
+};
+
+class ModContext {
+	private:
+		enum class Method {
+			Word, // 模数不超过一个字
+			Montgomery, // 奇数模数
+			Barrett // 偶数模数
+		};
+		
+		BigInt modulus;
+		Method method;
+		uint64_t word;
+		MontgomeryContext montgomery;
+		BarrettContext barrett;
+		
+	public:
+		explicit ModContext(const BigInt& modulus) : modulus(modulus), word(0) {
+			if (modulus.sign() <= 0) {
+				throw std::runtime_error("Modulus must be positive");
+			}
+			
+			if (modulus.getLimbs().size() == 1) {
+				method = Method::Word;
+				word = modulus.getLimbs()[0];
+			}
+			else if (modulus.isOdd()) {
+				method = Method::Montgomery;
+				montgomery = MontgomeryContext(modulus);
+			}
+			else {
+				method = Method::Barrett;
+				barrett = BarrettContext(modulus);
+			}
+		}
+		
+		const BigInt& getModulus() const {
+			return modulus;
+		}
+		
+		// 任意整数约化到 [0, m)，已在范围内时不做除法
+		BigInt reduce(const BigInt& a) const {
+			if (a.sign() >= 0 && a < modulus) {
+				return a;
+			}
+			
+			BigInt remainder = a % modulus;
+			return remainder.sign() < 0 ? remainder + modulus : remainder;
+		}
+		
+		BigInt mulmod(const BigInt& a, const BigInt& b) const {
+			BigInt x = reduce(a);
+			BigInt y = reduce(b);
+			
+			switch (method) {
+				case Method::Word:
+					return BigInt::fromLimbs(BigInt::Limbs(1, ::mulmod(x.isZero() ? 0 : x.getLimbs()[0], y.isZero() ? 0 : y.getLimbs()[0], word)));
+					
+				case Method::Montgomery:
+					return montgomery.mulmod(x, y);
+					
+				default:
+					return barrett.mulmod(x, y);
+			}
+		}
+		
+		BigInt sqrmod(const BigInt& a) const {
+			BigInt x = reduce(a);
+			
+			switch (method) {
+				case Method::Word: {
+					uint64_t value = x.isZero() ? 0 : x.getLimbs()[0];
+					return BigInt::fromLimbs(BigInt::Limbs(1, ::mulmod(value, value, word)));
+				}
+				
+				case Method::Montgomery:
+					return montgomery.sqrmod(x);
+					
+				default:
+					return barrett.sqrmod(x);
+			}
+		}
+		
+		// 指数必须非负
+		BigInt powmod(const BigInt& base, const BigInt& exponent) const {
+			if (exponent.sign() < 0) {
+				throw std::runtime_error("Negative exponent");
+			}
+			
+			BigInt x = reduce(base);
+			
+			switch (method) {
+				case Method::Word: {
+					uint64_t value = x.isZero() ? 0 : x.getLimbs()[0];
+					
+					if (word % 2 == 1 && word != 1) {
+						MontgomeryWord context(word);
+						uint64_t result = slidingWindowPower(context.one(), context.toMontgomery(value), exponent, [&context](uint64_t& target, uint64_t a, uint64_t b) {
+							target = context.multiply(a, b);
+						});
+						return BigInt::fromLimbs(BigInt::Limbs(1, context.fromMontgomery(result)));
+					}
+					
+					uint64_t one = 1 % word;
+					uint64_t modulusWord = word;
+					uint64_t result = slidingWindowPower(one, value, exponent, [modulusWord](uint64_t& target, uint64_t a, uint64_t b) {
+						target = ::mulmod(a, b, modulusWord);
+					});
+					return BigInt::fromLimbs(BigInt::Limbs(1, result));
+				}
+				
+				case Method::Montgomery:
+					return montgomery.powmod(x, exponent);
+					
+				default:
+					return barrett.powmod(x, exponent);
+			}
+		}
+};
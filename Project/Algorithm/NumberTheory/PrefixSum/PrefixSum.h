@@ -0,0 +1,249 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+#include"../BigInt/bigint.hpp"
+#include"../Sieve/Sieve.h"
+#include<unordered_map>
+
+#define DU_SIEVE_TABLE_LIMIT (1 << 24) // 杜教筛预处理表长度的上限，表长取 n^(2/3) 与它的较小值
+
+// 亚线性的数论前缀和：素数计数 π(n) 用 Lucy_Hedgehog 算法，φ 与 μ 的前缀和用杜教筛
+
+// π(n)：只需要 S(v) = [2, v] 内素数个数在 v = n / i 这 O(sqrt(n)) 个值上的结果，
+// 初值 S(v) = v - 1，依次对每个素数 p <= sqrt(n) 从大到小更新 S(v) -= S(v / p) - S(p - 1)，
+// 时间 O(n^(3/4) / log n)，空间 O(sqrt(n))
+uint64_t primeCount(uint64_t n) {
+	if (n < 2)
+		return 0;
+		
+	uint64_t root = isqrt(n);
+	std::vector<uint64_t> small(root + 1); // small[v] = S(v)
+	std::vector<uint64_t> large(root + 1); // large[i] = S(n / i)
+	
+	for (uint64_t v = 1; v <= root; v++) {
+		small[v] = v - 1;
+		large[v] = n / v - 1;
+	}
+	
+	for (uint64_t p = 2; p <= root; p++) {
+		if (small[p] == small[p - 1])
+			continue;
+			
+		uint64_t primesBelow = small[p - 1];
+		uint64_t square = p * p;
+		uint64_t end = std::min(root, n / square);
+		uint64_t boundary = root / p; // i <= boundary 时 n / (i * p) 仍在 large 中
+		
+		for (uint64_t i = 1; i <= end; i++) {
+			uint64_t quotient = i <= boundary ? large[i * p] : small[n / (i * p)];
+			large[i] -= quotient - primesBelow;
+		}
+		
+		for (uint64_t v = root; v >= square; v--)
+			small[v] -= small[v / p] - primesBelow;
+	}
+	
+	return large[1];
+}
+
+// 两个字的无符号整数，φ 的前缀和在 n 超过约 4e9 时超出 64 位；运算按模 2^128 进行
+struct UInt128 {
+	uint64_t low;
+	uint64_t high;
+	
+	UInt128(uint64_t low = 0, uint64_t high = 0) : low(low), high(high) {}
+	
+	UInt128& operator+=(const UInt128& other) {
+		uint64_t carry = 0;
+		low = addCarry(low, other.low, carry);
+		high = high + other.high + carry;
+		return *this;
+	}
+	
+	UInt128& operator-=(const UInt128& other) {
+		uint64_t borrow = 0;
+		low = subBorrow(low, other.low, borrow);
+		high = high - other.high - borrow;
+		return *this;
+	}
+	
+	UInt128 operator*(uint64_t factor) const {
+		uint64_t productHigh;
+		uint64_t productLow = mulWide(low, factor, productHigh);
+		return UInt128(productLow, productHigh + high * factor);
+	}
+	
+	BigInt toBigInt() const {
+		BigInt::Limbs limbs(2);
+		limbs[0] = low;
+		limbs[1] = high;
+		return BigInt::fromLimbs(limbs);
+	}
+};
+
+// 杜教筛：f 与常函数 1 的狄利克雷卷积 h = f * 1 的前缀和 H 容易计算时，f 的前缀和满足
+// S(m) = H(m) - Σ_{d=2}^{m} S(m / d)，m / d 只有 O(sqrt(m)) 种取值；
+// m 不超过预处理表长时直接查表，更大的 S(m) 记忆化：从查询上限 n 递归出的都是 n / x 形式的值，按 x 存在数组里，
+// 其余的值放进哈希表，多次查询共用同一张表与缓存
+// Small 为表中元素的类型，Sum 为前缀和的类型，hPrefix(m) 返回 H(m)
+template<typename Small, typename Sum, typename HPrefix>
+class DuSieve {
+	private:
+		uint64_t limit;
+		std::vector<Small> table; // table[i] = S(i)
+		std::vector<Sum> large; // large[x] = S(limit / x)
+		std::vector<bool> known; // known[x] 表示 large[x] 已经算出
+		std::unordered_map<uint64_t, Sum> cache;
+		HPrefix hPrefix;
+		
+		Sum compute(uint64_t m) {
+			Sum result = hPrefix(m);
+			uint64_t root = isqrt(m);
+			
+			// d <= sqrt(m) 时逐个减去 S(m / d)
+			for (uint64_t d = 2; d <= root; d++)
+				result -= (*this)(m / d);
+				
+			// d > sqrt(m) 时 m / d = k <= m / (root + 1)，这样的 d 共有 m / k - m / (k + 1) 个
+			uint64_t upper = m;
+			
+			for (uint64_t k = 1; k <= m / (root + 1); k++) {
+				uint64_t lower = m / (k + 1);
+				result -= (*this)(k) * (upper - std::max(lower, root));
+				upper = lower;
+			}
+			
+			return result;
+		}
+		
+	public:
+		// limit 为之后查询的最大 m，更大的 m 也能查询但不走数组缓存
+		DuSieve(uint64_t limit, std::vector<Small> table, HPrefix hPrefix) :
+			limit(limit), table(std::move(table)), hPrefix(hPrefix) {
+			size_t count = limit / this->table.size() + 1;
+			large.resize(count);
+			known.resize(count, false);
+		}
+		
+		Sum operator()(uint64_t m) {
+			if (m < table.size())
+				return Sum(table[m]);
+				
+			uint64_t x = limit / m;
+			
+			if (m <= limit && limit / x == m) {
+				if (!known[x]) {
+					large[x] = compute(m);
+					known[x] = true;
+				}
+				
+				return large[x];
+			}
+			
+			auto found = cache.find(m);
+			
+			if (found != cache.end())
+				return found->second;
+				
+			Sum result = compute(m);
+			cache.emplace(m, result);
+			return result;
+		}
+};
+
+// 预处理表长：约为 n^(2/3)，不超过 DU_SIEVE_TABLE_LIMIT，但至少超过 sqrt(n)
+inline uint64_t duSieveTableSize(uint64_t n) {
+	uint64_t size = static_cast<uint64_t>(std::cbrt(static_cast<double>(n)));
+	size = size * size;
+	return std::max<uint64_t>(std::min<uint64_t>(size, DU_SIEVE_TABLE_LIMIT), isqrt(n) + 2);
+}
+
+// m (m + 1) / 2，先把偶数的一个除以 2
+inline UInt128 triangular(uint64_t m) {
+	uint64_t high;
+	uint64_t low = m % 2 == 0 ? mulWide(m / 2, m + 1, high) : mulWide(m, (m + 1) / 2, high);
+	return UInt128(low, high);
+}
+
+// Σ_{i=1}^{m} φ(i)：φ * 1 = id，H(m) = m (m + 1) / 2
+class EulerPhiSum {
+	private:
+		typedef UInt128(*HPrefix)(uint64_t);
+		DuSieve<uint64_t, UInt128, HPrefix> sieve;
+		
+		static std::vector<uint64_t> makeTable(uint64_t size) {
+			std::vector<uint64_t> table(size, 0);
+			uint64_t sum = 0;
+			sieveEulerPhi(1, size, [&table, &sum](uint64_t i, uint64_t value) {
+				sum += value;
+				table[i] = sum;
+			});
+			return table;
+		}
+		
+	public:
+		// limit 为之后查询的最大 m，用于确定预处理表长
+		explicit EulerPhiSum(uint64_t limit) : sieve(limit, makeTable(duSieveTableSize(limit)), triangular) {}
+		
+		BigInt operator()(uint64_t m) {
+			return sieve(m).toBigInt();
+		}
+};
+
+// 梅滕斯函数 M(m) = Σ_{i=1}^{m} μ(i)：μ * 1 = ε，H(m) = 1
+class MobiusSum {
+	private:
+		typedef long long(*HPrefix)(uint64_t);
+		DuSieve<int, long long, HPrefix> sieve;
+		
+		static long long one(uint64_t) {
+			return 1;
+		}
+		
+		static std::vector<int> makeTable(uint64_t size) {
+			std::vector<int> table(size, 0);
+			int sum = 0;
+			sieveMobius(1, size, [&table, &sum](uint64_t i, int value) {
+				sum += value;
+				table[i] = sum;
+			});
+			return table;
+		}
+		
+	public:
+		explicit MobiusSum(uint64_t limit) : sieve(limit, makeTable(duSieveTableSize(limit)), one) {}
+		
+		long long operator()(uint64_t m) {
+			return sieve(m);
+		}
+};
+
+// 单次查询的便捷接口
+BigInt eulerPhiSum(uint64_t n) {
+	return EulerPhiSum(n)(n);
+}
+
+long long mertens(uint64_t n) {
+	return MobiusSum(n)(n);
+}
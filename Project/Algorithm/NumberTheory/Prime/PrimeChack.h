@@ -20,54 +20,348 @@
     SOFTWARE.
 */
 
+
 #pragma once
 #include"../FastExponent/FastExponent.h"
 #include"../BigInt/bigint.hpp"
+#include"../ModContext/ModContext.h"
+#include"../../../Server/ThreadPool.h"
+#include<algorithm>
+
+#define PRIME_RANGE_BLOCK 4096 // 区间批量判定时每个任务负责的整数个数
+
+// 做模幂之前先试除的小素数，它们的乘积 614889782588491410 不超过 long long
+const uint64_t TRIAL_PRIMES[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47};
+const uint64_t TRIAL_PRIMES_PRODUCT = 614889782588491410ULL;
+
+// 以 a 为底的强伪素数检验，n 为奇数，n - 1 = d * 2^r；返回 false 时 n 一定是合数
+inline bool strongProbablePrime(const MontgomeryWord& context, uint64_t a, uint64_t d, int r) {
+	uint64_t n = context.getModulus();
+	a %= n;
+	
+	if (a == 0)
+		return true;
+		
+	uint64_t one = context.one();
+	uint64_t minusOne = n - one; // Montgomery 形式的 n - 1
+	uint64_t x = context.power(context.toMontgomery(a), d);
+	
+	if (x == one || x == minusOne)
+		return true;
+		
+	for (int i = 1; i < r; i++) {
+		x = context.multiply(x, x);
+		
+		if (x == minusOne)
+			return true;
+	}
+	
+	return false;
+}
 
-// Miller–Rabin素数测试
-bool millerRabin(BigInt num) {
-	if (num <= BigInt(1))
+// 一个字以内的确定性素数判定：先试除小素数，再用已证明覆盖对应范围的底数集合做 Miller–Rabin
+// n < 4759123141 时用 {2, 7, 61}，n < 2^64 时用 Jaeschke 与 Sinclair 的 7 个底数；
+// 单独命名而不重载 isPrime，以免 int 实参（包括负数）被隐式转换为 uint64_t
+inline bool isPrimeWord(uint64_t n) {
+	if (n < 2)
 		return false;
 		
-	if (num == BigInt(2) || num == BigInt(3))
+	for (uint64_t p : TRIAL_PRIMES) {
+		if (n % p == 0)
+			return n == p;
+	}
+	
+	if (n < 53 * 53)
+		return true;
+		
+	uint64_t d = n - 1;
+	int r = trailingZeros(d);
+	d >>= r;
+	MontgomeryWord context(n);
+	
+	if (n < 4759123141ULL) {
+		for (uint64_t a : {2, 7, 61}) {
+			if (!strongProbablePrime(context, a, d, r))
+				return false;
+		}
+		
+		return true;
+	}
+	
+	for (uint64_t a : {2ULL, 325ULL, 9375ULL, 28178ULL, 450775ULL, 9780504ULL, 1795265022ULL}) {
+		if (!strongProbablePrime(context, a, d, r))
+			return false;
+	}
+	
+	return true;
+}
+
+// 以 a 为底的强伪素数检验（多字版本），n 为大于 a 的奇数
+inline bool strongProbablePrime(const ModContext& context, const BigInt& a, const BigInt& d, size_t r) {
+	const BigInt& n = context.getModulus();
+	BigInt minusOne = n - 1;
+	BigInt x = context.powmod(a, d);
+	
+	if (x == 1 || x == minusOne)
 		return true;
 		
-	if (num % BigInt(2) == BigInt(0))
+	for (size_t i = 1; i < r; i++) {
+		x = context.sqrmod(x);
+		
+		if (x == minusOne)
+			return true;
+	}
+	
+	return false;
+}
+
+// 试除 TRIAL_PRIMES：一次多字取余得到 n 模全部小素数乘积的余数，之后只做单字运算
+// 返回 1 表示 n 是其中某个素数，0 表示 n 有小素因子，-1 表示无法判定
+inline int trialDivisionTest(const BigInt& n) {
+	if (n.getLimbs().size() == 1 && n.getLimbs()[0] <= TRIAL_PRIMES[14])
+		return std::find(std::begin(TRIAL_PRIMES), std::end(TRIAL_PRIMES), n.getLimbs()[0]) != std::end(TRIAL_PRIMES) ? 1 : 0;
+		
+	BigInt remainder = n % static_cast<long long>(TRIAL_PRIMES_PRODUCT);
+	uint64_t rest = remainder.isZero() ? 0 : remainder.getLimbs()[0];
+	
+	for (uint64_t p : TRIAL_PRIMES) {
+		if (rest % p == 0)
+			return 0;
+	}
+	
+	return -1;
+}
+
+// Miller–Rabin 素数测试，结果可复现且线程安全：
+// n < 2^64 时走单字路径，结果确定；更大的 n 以前 13 个素数（2 到 41）为底，n < 3317044064679887385961981 时结果确定
+// （只用到 37 时 318665857834031151167461 = 399165290221 * 798330580441 会被误判为素数），
+// 超出这个范围时仍是概率性的，需要确定性更强的结果请使用 bailliePSW 或 isPrime
+bool millerRabin(const BigInt& num) {
+	if (num <= 1)
 		return false;
 		
+	if (num.getLimbs().size() == 1)
+		return isPrimeWord(num.getLimbs()[0]);
+		
+	int trial = trialDivisionTest(num);
+	
+	if (trial >= 0)
+		return trial == 1;
+		
 	// 将 num - 1 表示为 2^r * d 的形式
-	BigInt d = num - BigInt(1);
-	int r = 0;
+	BigInt d = num - 1;
+	size_t r = d.trailingZeroBits();
+	d >>= r;
+	ModContext context(num);
 	
-	while (d % BigInt(2) == BigInt(0)) {
-		d = d / BigInt(2);
-		r++;
+	for (long long a : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41}) {
+		if (!strongProbablePrime(context, BigInt(a), d, r))
+			return false;
 	}
 	
-	// 进行多次测试
-	const int k = 5; // 测试次数，可以根据需要调整
+	return true;
+}
+
+// 雅可比符号 (a / n)，n 为正奇数
+inline int jacobi(uint64_t a, uint64_t n) {
+	int result = 1;
+	a %= n;
 	
-	for (int i = 0; i < k; i++) {
-		BigInt a = BigInt(BigInt(std::rand()) % (num - BigInt(3)) + 2); // 随机选择一个底数 a
-		BigInt x = fastPowMod(a, d, num);
+	while (a != 0) {
+		int zeros = trailingZeros(a);
+		a >>= zeros;
 		
-		if (x == BigInt(1) || x == num - BigInt(1))
-			continue;
+		// (2 / n) = -1 当且仅当 n mod 8 为 3 或 5
+		if ((zeros & 1) && (n % 8 == 3 || n % 8 == 5))
+			result = -result;
 			
-		bool isComposite = true;
+		// 二次互反律：a、n 都模 4 余 3 时变号
+		if (a % 4 == 3 && n % 4 == 3)
+			result = -result;
+			
+		std::swap(a, n);
+		a %= n;
+	}
+	
+	return n == 1 ? result : 0;
+}
+
+// 雅可比符号 (D / n)，D 为奇数，n 为正奇数：借助二次互反律把 n 约化到 |D| 以内
+inline int jacobi(long long D, const BigInt& n) {
+	uint64_t m = D < 0 ? 0 - static_cast<uint64_t>(D) : static_cast<uint64_t>(D);
+	BigInt remainder = n % static_cast<long long>(m);
+	uint64_t nMod4 = n.getLimbs()[0] % 4;
+	int result = jacobi(remainder.isZero() ? 0 : remainder.getLimbs()[0], m);
+	
+	if (m % 4 == 3 && nMod4 == 3)
+		result = -result;
+		
+	// (-1 / n) = -1 当且仅当 n 模 4 余 3
+	if (D < 0 && nMod4 == 3)
+		result = -result;
 		
-		for (int j = 0; j < r - 1; j++) {
-			x = (x * x) % num;
+	return result;
+}
+
+// 整数平方根 floor(sqrt(n))，n 非负：牛顿迭代从不小于结果的初值单调下降
+inline BigInt isqrt(const BigInt& n) {
+	if (n.sign() <= 0)
+		return BigInt();
+		
+	BigInt x = BigInt(1) << ((n.bitLength() + 1) / 2);
+	
+	while (true) {
+		BigInt y = (x + n / x) >> 1;
+		
+		if (y >= x)
+			return x;
 			
-			if (x == num - BigInt(1)) {
-				isComposite = false;
-				break;
-			}
-		}
+		x = std::move(y);
+	}
+}
+
+// 强 Lucas 概率素数检验（Selfridge 方法 A）：n 为不是完全平方数的奇数，且没有小素因子
+// 取 5, -7, 9, -11, ... 中第一个满足 (D / n) = -1 的 D，P = 1，Q = (1 - D) / 4，
+// n + 1 = d * 2^s，若 U_d ≡ 0 或存在 0 <= r < s 使 V_(d * 2^r) ≡ 0 则通过
+inline bool strongLucasProbablePrime(const BigInt& n) {
+	long long D = 5;
+	
+	while (true) {
+		int symbol = jacobi(D, n);
 		
-		if (isComposite)
+		if (symbol == -1)
+			break;
+			
+		// (D / n) = 0 且 |D| < n 说明有公因子；完全平方数永远找不到 -1，尝试若干次之后检查一次
+		if (symbol == 0 && n > (D < 0 ? -D : D))
 			return false;
+			
+		if (D == 61) {
+			BigInt root = isqrt(n);
+			
+			if (root * root == n)
+				return false;
+		}
+		
+		D = D > 0 ? -(D + 2) : -D + 2;
 	}
 	
-	return true;
+	ModContext context(n);
+	BigInt Q = context.reduce(BigInt((1 - D) / 4));
+	BigInt DMod = context.reduce(BigInt(D));
+	// 模 n 下除以 2：奇数先加 n
+	auto half = [&n](BigInt x) {
+		if (x.isOdd())
+			x += n;
+			
+		return x >> 1;
+	};
+	auto subtract = [&n](const BigInt& a, const BigInt& b) {
+		BigInt x = a - b;
+		return x.sign() < 0 ? x + n : x;
+	};
+	BigInt d = n + 1;
+	size_t s = d.trailingZeroBits();
+	d >>= s;
+	// 从 k = 1 开始按 d 的二进制位从高到低做倍增与加一
+	BigInt U = 1;
+	BigInt V = 1;
+	BigInt Qk = Q;
+	
+	for (size_t i = d.bitLength() - 1; i > 0; i--) {
+		// U_2k = U_k V_k，V_2k = V_k^2 - 2Q^k
+		U = context.mulmod(U, V);
+		V = subtract(context.sqrmod(V), context.reduce(Qk << 1));
+		Qk = context.sqrmod(Qk);
+		
+		if ((d.getLimbs()[(i - 1) / 64] >> ((i - 1) % 64)) & 1) {
+			// U_(k+1) = (P U_k + V_k) / 2，V_(k+1) = (D U_k + P V_k) / 2
+			BigInt nextU = half(context.reduce(U + V));
+			V = half(context.reduce(context.mulmod(DMod, U) + V));
+			U = std::move(nextU);
+			Qk = context.mulmod(Qk, Q);
+		}
+	}
+	
+	if (U.isZero() || V.isZero())
+		return true;
+		
+	for (size_t r = 1; r < s; r++) {
+		// V_2k = V_k^2 - 2Q^k
+		V = subtract(context.sqrmod(V), context.reduce(Qk << 1));
+		
+		if (V.isZero())
+			return true;
+			
+		Qk = context.sqrmod(Qk);
+	}
+	
+	return false;
+}
+
+// Baillie–PSW 素数测试：以 2 为底的强伪素数检验加强 Lucas 检验，目前没有已知反例，
+// 代价约为三次模幂，多字输入比 millerRabin 的 13 个底数快；n < 2^64 时结果确定
+bool bailliePSW(const BigInt& num) {
+	if (num <= 1)
+		return false;
+		
+	if (num.getLimbs().size() == 1)
+		return isPrimeWord(num.getLimbs()[0]);
+		
+	int trial = trialDivisionTest(num);
+	
+	if (trial >= 0)
+		return trial == 1;
+		
+	BigInt d = num - 1;
+	size_t r = d.trailingZeroBits();
+	d >>= r;
+	
+	if (!strongProbablePrime(ModContext(num), BigInt(2), d, r))
+		return false;
+		
+	return strongLucasProbablePrime(num);
+}
+
+// 通用入口：在 millerRabin 的结果确定时用它，更大的数用 Baillie–PSW
+bool isPrime(const BigInt& num) {
+	if (num.getLimbs().size() == 1 || num < BigInt("3317044064679887385961981"))
+		return millerRabin(num);
+		
+	return bailliePSW(num);
+}
+
+// 数论模块共用的线程池
+inline ThreadPool& numberTheoryThreadPool() {
+	static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	return pool;
+}
+
+// [low, high) 内的全部素数，按 PRIME_RANGE_BLOCK 分块在线程池上并行判定，结果从小到大
+// 调用方会等待线程池中的任务，不能在同一个线程池的任务内部调用
+std::vector<uint64_t> primesInRange(uint64_t low, uint64_t high) {
+	std::vector<std::future<std::vector<uint64_t>>> futures;
+	
+	for (uint64_t begin = low, end; begin < high; begin = end) {
+		end = begin + std::min<uint64_t>(PRIME_RANGE_BLOCK, high - begin);
+		futures.push_back(numberTheoryThreadPool().enqueue([begin, end] {
+			std::vector<uint64_t> block;
+			
+			for (uint64_t n = begin; n < end; n++) {
+				if (isPrimeWord(n))
+					block.push_back(n);
+			}
+			
+			return block;
+		}));
+	}
+	
+	std::vector<uint64_t> primes;
+	
+	for (auto& future : futures) {
+		std::vector<uint64_t> block = future.get();
+		primes.insert(primes.end(), block.begin(), block.end());
+	}
+	
+	return primes;
 }
@@ -23,28 +23,233 @@
 #pragma once
 #include"../BigInt/bigint.hpp"
 #include"../GCD/GCD.h"
+#include"../ModContext/ModContext.h"
+#include"../Prime/PrimeChack.h"
+#include"../../../Server/ThreadPool.h"
+#include<algorithm>
 
-BigInt f(BigInt a, BigInt b, BigInt c) {
+#define FACTORIZE_TRIAL_LIMIT 65536 // 试除所用素数的上界
+#define FACTORIZE_BATCH 128 // Brent 算法中每求一次 gcd 之前累乘的步数
+
+BigInt f(const BigInt& a, const BigInt& b, const BigInt& c) {
 	return (a * a + b) % c;
 }
 
-BigInt Pollard_Rho(BigInt N) {
+// 同一模数下的 f：a 与 b 都在 [0, N) 内时不需要除法
+BigInt f(const BigInt& a, const BigInt& b, const ModContext& context) {
+	BigInt x = context.sqrmod(a) + b;
+	return x >= context.getModulus() ? x - context.getModulus() : x;
+}
+
+// Brent 改进的 Pollard rho（一个字的版本）：迭代 y = y^2 + c，
+// 每段把 y 往前走 r 步后与段首的 x 比较，r 逐段翻倍；|x - y| 先累乘 FACTORIZE_BATCH 次再求一次 gcd，
+// 累乘越过了因子（gcd 为 n）时从本批次开头逐步回溯；返回 n 的一个因子，失败时返回 n
+inline uint64_t pollardBrent(uint64_t n, uint64_t c) {
+	auto step = [n, c](uint64_t y) {
+		uint64_t next = mulmod(y, y, n) + c;
+		return next >= n || next < c ? next - n : next;
+	};
+	uint64_t x = 2;
+	uint64_t y = 2;
+	uint64_t ys = 2;
+	uint64_t q = 1;
+	uint64_t g = 1;
+	
+	for (uint64_t r = 1; g == 1; r <<= 1) {
+		x = y;
+		
+		for (uint64_t i = 0; i < r; i++)
+			y = step(y);
+			
+		for (uint64_t k = 0; k < r && g == 1; k += FACTORIZE_BATCH) {
+			ys = y;
+			uint64_t limit = std::min<uint64_t>(FACTORIZE_BATCH, r - k);
+			
+			for (uint64_t i = 0; i < limit; i++) {
+				y = step(y);
+				q = mulmod(q, x > y ? x - y : y - x, n);
+			}
+			
+			g = binaryGcd(q, n);
+		}
+	}
+	
+	if (g == n) {
+		do {
+			ys = step(ys);
+			g = binaryGcd(x > ys ? x - ys : ys - x, n);
+		} while (g == 1);
+	}
+	
+	return g;
+}
+
+// Brent 改进的 Pollard rho（多字的版本），步骤同上，模乘都经过同一个 ModContext
+BigInt pollardBrent(const BigInt& n, const BigInt& c) {
+	ModContext context(n);
+	BigInt x = 2;
+	BigInt y = 2;
+	BigInt ys = 2;
+	BigInt q = 1;
+	BigInt g = 1;
+	
+	for (uint64_t r = 1; g == 1; r <<= 1) {
+		x = y;
+		
+		for (uint64_t i = 0; i < r; i++)
+			y = f(y, c, context);
+			
+		for (uint64_t k = 0; k < r && g == 1; k += FACTORIZE_BATCH) {
+			ys = y;
+			uint64_t limit = std::min<uint64_t>(FACTORIZE_BATCH, r - k);
+			
+			for (uint64_t i = 0; i < limit; i++) {
+				y = f(y, c, context);
+				q = context.mulmod(q, abs(x - y));
+			}
+			
+			g = gcd(q, n);
+		}
+	}
+	
+	if (g == n) {
+		do {
+			ys = f(ys, c, context);
+			g = gcd(abs(x - ys), n);
+		} while (g == 1);
+	}
+	
+	return g;
+}
+
+BigInt Pollard_Rho(const BigInt& N) {
 	if (N == 4)
-		return 2; // 因为一开始跳了两步，所以需要特判一下 4
+		return 2; // y^2 + c 的迭代对 4 总是失败，需要特判一下 4
 		
 	BigInt c = BigInt(rand()) % (N - 1) + 1;
-	BigInt t = f(0, c, N);
-	BigInt r = f(f(0, c, N), c, N);
 	
-	while (t != r) {
-		BigInt d = gcd(abs(t - r), N);
+	if (N.getLimbs().size() == 1)
+		return BigInt::fromLimbs(BigInt::Limbs(1, pollardBrent(N.getLimbs()[0], c.getLimbs()[0])));
 		
-		if (d > 1)
+	return pollardBrent(N, c);
+}
+
+// 试除用的素数表：[2, FACTORIZE_TRIAL_LIMIT) 内的全部素数，首次使用时筛出
+inline const std::vector<uint32_t>& smallPrimes() {
+	static const std::vector<uint32_t> primes = [] {
+		std::vector<uint32_t> result;
+		std::vector<bool> composite(FACTORIZE_TRIAL_LIMIT, false);
+		
+		for (uint32_t i = 2; i < FACTORIZE_TRIAL_LIMIT; i++) {
+			if (composite[i])
+				continue;
+				
+			result.push_back(i);
+			
+			for (uint64_t j = uint64_t(i) * i; j < FACTORIZE_TRIAL_LIMIT; j += i)
+				composite[j] = true;
+		}
+		
+		return result;
+	}();
+	return primes;
+}
+
+// 试除：把若干个小素数的乘积凑成一个字，对 n 只做一趟单字取模，余数再逐个检查这些素数
+inline void trialDivide(BigInt& n, std::vector<BigInt>& factors) {
+	const std::vector<uint32_t>& primes = smallPrimes();
+	size_t i = 0;
+	
+	while (i < primes.size() && n > 1) {
+		size_t begin = i;
+		uint64_t product = 1;
+		
+		while (i < primes.size() && product <= UINT64_MAX / primes[i])
+			product *= primes[i++];
+			
+		uint64_t rest = 0;
+		
+		for (size_t k = n.getLimbs().size(); k > 0; k--)
+			divWide(rest, n.getLimbs()[k - 1], product, rest);
+			
+		for (size_t j = begin; j < i; j++) {
+			if (rest % primes[j] != 0)
+				continue;
+				
+			while (n % static_cast<long long>(primes[j]) == 0) {
+				n /= static_cast<long long>(primes[j]);
+				factors.push_back(primes[j]);
+			}
+		}
+		
+		// 剩下的部分小于下一个素数的平方时必为 1 或素数
+		if (i < primes.size() && n < static_cast<long long>(primes[i]) * primes[i]) {
+			if (n > 1) {
+				factors.push_back(n);
+				n = 1;
+			}
+			
+			break;
+		}
+	}
+}
+
+// 找出合数 n 的一个非平凡因子：依次换用 c = 1, 2, ... 直到 Brent 算法成功
+inline BigInt splitComposite(const BigInt& n) {
+	for (uint64_t c = 1;; c++) {
+		BigInt d = n.getLimbs().size() == 1 ? BigInt::fromLimbs(BigInt::Limbs(1, pollardBrent(n.getLimbs()[0], c))) : pollardBrent(n, BigInt::fromLimbs(BigInt::Limbs(1, c)));
+		
+		if (d != 1 && d != n)
 			return d;
+	}
+}
+
+// 完整的质因数分解：先试除小素数，剩下的部分用 isPrime 判断是否为素数，
+// 合数用 Brent 算法拆成两个互相独立的余因子，同一轮的多个合数在线程池上并行拆分；
+// 返回按从小到大排列、含重数的质因子
+std::vector<BigInt> factorize(const BigInt& n) {
+	if (n <= 0)
+		throw std::runtime_error("factorize requires a positive integer");
+		
+	std::vector<BigInt> factors;
+	BigInt rest = n;
+	trialDivide(rest, factors);
+	std::vector<BigInt> pending;
+	
+	if (rest > 1)
+		pending.push_back(rest);
+		
+	while (!pending.empty()) {
+		std::vector<BigInt> composites;
+		
+		for (BigInt& x : pending) {
+			if (isPrime(x))
+				factors.push_back(std::move(x));
+			else
+				composites.push_back(std::move(x));
+		}
+		
+		pending.clear();
+		std::vector<BigInt> divisors(composites.size());
+		
+		if (composites.size() == 1)
+			divisors[0] = splitComposite(composites[0]);
+		else {
+			std::vector<std::future<BigInt>> futures;
 			
-		t = f(t, c, N);
-		r = f(f(r, c, N), c, N);
+			for (const BigInt& x : composites)
+				futures.push_back(numberTheoryThreadPool().enqueue(splitComposite, std::cref(x)));
+				
+			for (size_t i = 0; i < futures.size(); i++)
+				divisors[i] = futures[i].get();
+		}
+		
+		for (size_t i = 0; i < composites.size(); i++) {
+			pending.push_back(composites[i] / divisors[i]);
+			pending.push_back(std::move(divisors[i]));
+		}
 	}
 	
-	return N;
+	std::sort(factors.begin(), factors.end());
+	return factors;
 }
@@ -0,0 +1,307 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+#include"../Prime/PrimeChack.h"
+#include<cmath>
+#include<deque>
+
+#define SIEVE_SEGMENT_BYTES (1 << 18) // 素数分段筛每段的位图字节数，约为一个 L2 缓存
+#define SIEVE_TABLE_SEGMENT (1 << 15) // 欧拉函数、莫比乌斯函数、最小质因子分段筛每段的整数个数
+#define SIEVE_WHEEL 15015 // 预筛轮 3 * 5 * 7 * 11 * 13
+
+// 分段筛引擎：只把不超过 sqrt(high) 的素数常驻内存，区间按段处理，每段的工作集放得进缓存；
+// 各段在线程池上并行计算，结果按从小到大的顺序在调用线程上交给回调，任意时刻只保留有限个段
+
+// floor(sqrt(n))
+inline uint64_t isqrt(uint64_t n) {
+	uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+	
+	while (root > 0 && root > n / root)
+		root--;
+		
+	while ((root + 1) <= n / (root + 1))
+		root++;
+		
+	return root;
+}
+
+// 把 [low, high) 切成长度为 segment 的段，work(begin, end) 在线程池上计算一段，emit(result) 在调用线程上按顺序消费；
+// 同时在途的段数是线程数的两倍，计算与消费流水进行
+template<typename Work, typename Emit>
+void runSegments(uint64_t low, uint64_t high, uint64_t segment, Work work, Emit emit) {
+	typedef decltype(work(low, high)) Result;
+	size_t window = 2 * std::max(1u, std::thread::hardware_concurrency());
+	std::deque<std::future<Result>> pending;
+	uint64_t begin = low;
+	
+	while (begin < high || !pending.empty()) {
+		while (begin < high && pending.size() < window) {
+			uint64_t end = begin + std::min(segment, high - begin);
+			pending.push_back(numberTheoryThreadPool().enqueue(work, begin, end));
+			begin = end;
+		}
+		
+		emit(pending.front().get());
+		pending.pop_front();
+	}
+}
+
+// 奇数位图的预筛模式：第 w 个字的第 b 位对应 k = 64w + b，即奇数 2k + 1，与 3、5、7、11、13 都互素时为 1；
+// 周期为 SIEVE_WHEEL 个字，段起点按 64 对齐后直接整字复制
+inline const std::vector<uint64_t>& sieveWheelPattern() {
+	static const std::vector<uint64_t> pattern = [] {
+		std::vector<uint64_t> result(SIEVE_WHEEL, 0);
+		
+		for (uint64_t k = 0; k < 64 * uint64_t(SIEVE_WHEEL); k++) {
+			uint64_t n = (2 * k + 1) % SIEVE_WHEEL;
+			
+			if (n % 3 != 0 && n % 5 != 0 && n % 7 != 0 && n % 11 != 0 && n % 13 != 0)
+				result[k / 64] |= 1ULL << (k % 64);
+		}
+		
+		return result;
+	}();
+	return pattern;
+}
+
+template<typename Callback>
+void forEachPrime(uint64_t low, uint64_t high, Callback callback);
+
+// 不超过 limit 的全部素数，用作筛子；limit 较大时自身也走分段筛
+// limit 不超过 sqrt(2^64)，素数都放得进 32 位，区间靠近 2^64 时筛子约 2 亿个，用 32 位存储省一半内存
+inline std::vector<uint32_t> sievingPrimes(uint64_t limit) {
+	std::vector<uint32_t> primes;
+	
+	if (limit > (1 << 20)) {
+		forEachPrime(0, limit + 1, [&primes](uint64_t p) {
+			primes.push_back(static_cast<uint32_t>(p));
+		});
+		return primes;
+	}
+	
+	std::vector<bool> composite(limit + 1, false);
+	
+	for (uint64_t i = 2; i <= limit; i++) {
+		if (composite[i])
+			continue;
+			
+		primes.push_back(static_cast<uint32_t>(i));
+		
+		for (uint64_t j = i * i; j <= limit; j += i)
+			composite[j] = true;
+	}
+	
+	return primes;
+}
+
+// 按从小到大的顺序对 [low, high) 内的每个素数调用 callback(p)
+// 位图只存奇数，先整字复制预筛轮去掉 3 到 13 的倍数，再用 17 到 sqrt(high) 的素数逐段划去合数
+template<typename Callback>
+void forEachPrime(uint64_t low, uint64_t high, Callback callback) {
+	if (low <= 2 && 2 < high)
+		callback(2);
+		
+	if (high <= 3)
+		return;
+		
+	// 奇数 2k + 1 对应下标 k，k 的范围为 [kLow, kHigh)
+	uint64_t kLow = low / 2;
+	uint64_t kHigh = high / 2;
+	std::vector<uint32_t> primes = sievingPrimes(isqrt(high - 1));
+	const std::vector<uint64_t>& pattern = sieveWheelPattern();
+	
+	struct Block {
+		uint64_t begin;
+		std::vector<uint64_t> words;
+	};
+	
+	auto work = [&](uint64_t begin, uint64_t end) {
+		Block block{begin, std::vector<uint64_t>((end - begin + 63) / 64)};
+		std::vector<uint64_t>& words = block.words;
+		
+		for (size_t i = 0; i < words.size(); i++)
+			words[i] = pattern[(begin / 64 + i) % SIEVE_WHEEL];
+			
+		// 预筛模式误删了 3 到 13 本身，保留了 1
+		for (uint64_t k : {1, 2, 3, 5, 6}) {
+			if (begin <= k && k < end)
+				words[(k - begin) / 64] |= 1ULL << ((k - begin) % 64);
+		}
+		
+		for (uint64_t p : primes) {
+			if (p < 17)
+				continue;
+				
+			// 从 max(p^2, 段内第一个 p 的奇数倍) 开始，奇数倍之间的下标差为 p；
+			// 区间靠近 2^64 时倍数可能越过 UINT64_MAX，这时段内没有要划去的数
+			uint64_t first = 2 * begin + 1;
+			uint64_t offset = (p - first % p) % p;
+			
+			if (offset > UINT64_MAX - first)
+				continue;
+				
+			uint64_t start = first + offset;
+			
+			if (start % 2 == 0) {
+				if (p > UINT64_MAX - start)
+					continue;
+					
+				start += p;
+			}
+			
+			if (p <= UINT32_MAX)
+				start = std::max(start, p * p);
+				
+			if ((start - 1) / 2 >= end)
+				continue;
+				
+			for (uint64_t k = (start - 1) / 2; k < end; k += p)
+				words[(k - begin) / 64] &= ~(1ULL << ((k - begin) % 64));
+		}
+		
+		// 去掉区间以外的位
+		for (uint64_t k = begin; k < std::min(kLow, end); k++)
+			words[(k - begin) / 64] &= ~(1ULL << ((k - begin) % 64));
+			
+		if (begin == 0)
+			words[0] &= ~1ULL;
+			
+		for (uint64_t k = end; k < begin + 64 * words.size(); k++)
+			words[(k - begin) / 64] &= ~(1ULL << ((k - begin) % 64));
+			
+		return block;
+	};
+	
+	runSegments(kLow / 64 * 64, kHigh, uint64_t(SIEVE_SEGMENT_BYTES) * 8, work, [&callback](const Block & block) {
+		for (size_t i = 0; i < block.words.size(); i++) {
+			for (uint64_t word = block.words[i]; word != 0; word &= word - 1)
+				callback(2 * (block.begin + 64 * i + trailingZeros(word)) + 1);
+		}
+	});
+}
+
+// 一段 [begin, end) 的分解：n 被 p^k 整除时调用一次 update(index, p, k)，index 为相对 begin 的下标
+// rest 记录尚未除尽的部分，整除用乘以 2^64 下的逆元代替除法；筛完后大于 1 的 rest 就是唯一一个大于 sqrt(end) 的质因子
+template<typename Update>
+void sieveFactorSegment(uint64_t begin, uint64_t end, const std::vector<uint32_t>& primes, Update update) {
+	std::vector<uint64_t> rest(end - begin);
+	
+	for (uint64_t n = begin; n < end; n++)
+		rest[n - begin] = n;
+		
+	for (uint64_t p : primes) {
+		if (p > (end - 1) / p)
+			break;
+			
+		uint64_t inverse = p; // 牛顿迭代求 2^64 下的逆元，p = 2 时改用移位
+		
+		for (int i = 0; i < 5; i++)
+			inverse *= 2 - p * inverse;
+			
+		uint64_t power = p;
+		
+		for (int k = 1;; k++) {
+			// 在段内下标上步进，区间靠近 2^64 时也不会溢出
+			for (uint64_t i = (power - begin % power) % power; i < end - begin; i += power) {
+				update(i, p, k);
+				rest[i] = p == 2 ? rest[i] >> 1 : rest[i] * inverse;
+			}
+			
+			if (power > (end - 1) / p)
+				break;
+				
+			power *= p;
+		}
+	}
+	
+	for (uint64_t n = std::max<uint64_t>(begin, 2); n < end; n++) {
+		if (rest[n - begin] > 1)
+			update(n - begin, rest[n - begin], 1);
+	}
+}
+
+// 逐段计算表值，按从小到大的顺序对 [max(low, 1), high) 内的每个 n 调用 callback(n, value)
+// segmentValues(begin, end, primes) 返回一段的值
+template<typename Value, typename SegmentValues, typename Callback>
+void sieveTable(uint64_t low, uint64_t high, SegmentValues segmentValues, Callback callback) {
+	low = std::max<uint64_t>(low, 1);
+	
+	if (low >= high)
+		return;
+		
+	std::vector<uint32_t> primes = sievingPrimes(isqrt(high - 1));
+	
+	struct Block {
+		uint64_t begin;
+		std::vector<Value> values;
+	};
+	
+	runSegments(low, high, SIEVE_TABLE_SEGMENT, [&](uint64_t begin, uint64_t end) {
+		return Block{begin, segmentValues(begin, end, primes)};
+	}, [&callback](const Block & block) {
+		for (size_t i = 0; i < block.values.size(); i++)
+			callback(block.begin + i, block.values[i]);
+	});
+}
+
+// 欧拉函数 φ(n)：p^k 贡献 (p - 1) p^(k - 1)
+template<typename Callback>
+void sieveEulerPhi(uint64_t low, uint64_t high, Callback callback) {
+	sieveTable<uint64_t>(low, high, [](uint64_t begin, uint64_t end, const std::vector<uint32_t>& primes) {
+		std::vector<uint64_t> phi(end - begin, 1);
+		sieveFactorSegment(begin, end, primes, [&phi](size_t index, uint64_t p, int k) {
+			phi[index] *= k == 1 ? p - 1 : p;
+		});
+		return phi;
+	}, callback);
+}
+
+// 莫比乌斯函数 μ(n)：每个质因子变一次号，含平方因子时为 0
+template<typename Callback>
+void sieveMobius(uint64_t low, uint64_t high, Callback callback) {
+	sieveTable<int>(low, high, [](uint64_t begin, uint64_t end, const std::vector<uint32_t>& primes) {
+		std::vector<int> mu(end - begin, 1);
+		sieveFactorSegment(begin, end, primes, [&mu](size_t index, uint64_t, int k) {
+			mu[index] = k == 1 ? -mu[index] : 0;
+		});
+		return mu;
+	}, callback);
+}
+
+// 最小质因子，约定 1 的最小质因子为 1
+template<typename Callback>
+void sieveSmallestPrimeFactor(uint64_t low, uint64_t high, Callback callback) {
+	sieveTable<uint64_t>(low, high, [](uint64_t begin, uint64_t end, const std::vector<uint32_t>& primes) {
+		std::vector<uint64_t> factor(end - begin, 0);
+		sieveFactorSegment(begin, end, primes, [&factor](size_t index, uint64_t p, int k) {
+			if (k == 1 && factor[index] == 0)
+				factor[index] = p;
+		});
+		
+		if (begin == 1)
+			factor[0] = 1;
+			
+		return factor;
+	}, callback);
+}
@@ -0,0 +1,302 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+// 编译期激活函数类型：每个类型提供标量的 value/derivative 以及整块缓冲区的 apply/applyDerivative
+// 缓冲区版本内层无分支、无函数调用，可以内联进矩阵乘法的收尾阶段（epilogue）
+// sigmoid/tanh/GELU 使用快速 exp 近似（相对误差约 1e-13），ReLU 为无分支实现
+
+#define FAST_EXP_MIN -708.0
+#define FAST_EXP_MAX 709.0
+
+// 快速 exp：x = n * ln2 + r，|r| <= ln2 / 2，e^r 用 11 阶多项式近似，再拼接 2^n 的指数位
+inline double fastExp(double x) {
+	const double log2e = 1.4426950408889634;
+	const double ln2Hi = 6.93145751953125e-1;
+	const double ln2Lo = 1.42860682030941723212e-6;
+	const double magic = 6755399441055744.0; // 2^52 + 2^51，加上后低位即为取整结果
+	x = x < FAST_EXP_MIN ? FAST_EXP_MIN : (x > FAST_EXP_MAX ? FAST_EXP_MAX : x);
+	double t = x * log2e + magic;
+	double n = t - magic;
+	double r = x - n * ln2Hi - n * ln2Lo;
+	double p = 1.0 / 39916800.0;
+	p = p * r + 1.0 / 3628800.0;
+	p = p * r + 1.0 / 362880.0;
+	p = p * r + 1.0 / 40320.0;
+	p = p * r + 1.0 / 5040.0;
+	p = p * r + 1.0 / 720.0;
+	p = p * r + 1.0 / 120.0;
+	p = p * r + 1.0 / 24.0;
+	p = p * r + 1.0 / 6.0;
+	p = p * r + 0.5;
+	p = p * r + 1.0;
+	p = p * r + 1.0;
+	uint64_t bits;
+	std::memcpy(&bits, &t, sizeof(bits));
+	bits = (bits + 1023) << 52;
+	double scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+#ifdef __AVX2__
+// 4 路 AVX2 版本的快速 exp，与标量版本使用相同的区间约简和多项式
+inline __m256d fastExp(__m256d x) {
+	const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+	x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(FAST_EXP_MIN)), _mm256_set1_pd(FAST_EXP_MAX));
+	__m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), magic);
+	__m256d n = _mm256_sub_pd(t, magic);
+	__m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(6.93145751953125e-1))), _mm256_mul_pd(n, _mm256_set1_pd(1.42860682030941723212e-6)));
+	const double coefficients[] = {1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0};
+	__m256d p = _mm256_set1_pd(1.0 / 39916800.0);
+	
+	for (double c : coefficients) {
+		p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(c));
+	}
+	
+	__m256i bits = _mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+#endif
+
+// 对缓冲区逐元素应用 Op::value；AVX2 可用时每次处理 4 个元素，余数走标量路径
+template<class Op>
+inline void applyElementwise(double* x, size_t n) {
+	size_t i = 0;
+	#ifdef __AVX2__
+	
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(x + i, Op::value(_mm256_loadu_pd(x + i)));
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		x[i] = Op::value(x[i]);
+	}
+}
+
+// 对缓冲区逐元素计算 Op::derivative，结果写入 out
+template<class Op>
+inline void applyElementwiseDerivative(const double* x, double* out, size_t n) {
+	size_t i = 0;
+	#ifdef __AVX2__
+	
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(out + i, Op::derivative(_mm256_loadu_pd(x + i)));
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		out[i] = Op::derivative(x[i]);
+	}
+}
+
+// float 缓冲区复用 double 的计算核：每次把 4 个 float 扩展为 double 计算后再收窄写回
+// 激活函数只占训练的一小部分时间，这样 float 与 double 的结果只差一次舍入
+template<class Op>
+inline void applyElementwise(float* x, size_t n) {
+	size_t i = 0;
+	#ifdef __AVX2__
+	
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(x + i, _mm256_cvtpd_ps(Op::value(_mm256_cvtps_pd(_mm_loadu_ps(x + i)))));
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		x[i] = static_cast<float>(Op::value(x[i]));
+	}
+}
+
+template<class Op>
+inline void applyElementwiseDerivative(const float* x, float* out, size_t n) {
+	size_t i = 0;
+	#ifdef __AVX2__
+	
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(out + i, _mm256_cvtpd_ps(Op::derivative(_mm256_cvtps_pd(_mm_loadu_ps(x + i)))));
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		out[i] = static_cast<float>(Op::derivative(x[i]));
+	}
+}
+
+// 恒等激活
+struct IdentityActivation {
+	static double value(double x) {
+		return x;
+	}
+	
+	static double derivative(double) {
+		return 1.0;
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		return x;
+	}
+	
+	static __m256d derivative(__m256d) {
+		return _mm256_set1_pd(1.0);
+	}
+	#endif
+};
+
+// 指数函数（用于 softmax 等需要整块求 exp 的场合）
+struct ExpActivation {
+	static double value(double x) {
+		return fastExp(x);
+	}
+	
+	static double derivative(double x) {
+		return fastExp(x);
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		return fastExp(x);
+	}
+	
+	static __m256d derivative(__m256d x) {
+		return fastExp(x);
+	}
+	#endif
+};
+
+// ReLU 激活（无分支）
+struct ReLUActivation {
+	static double value(double x) {
+		return x > 0.0 ? x : 0.0;
+	}
+	
+	static double derivative(double x) {
+		return x > 0.0 ? 1.0 : 0.0;
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		return _mm256_max_pd(x, _mm256_setzero_pd());
+	}
+	
+	static __m256d derivative(__m256d x) {
+		return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ), _mm256_set1_pd(1.0));
+	}
+	#endif
+};
+
+// Sigmoid 激活：1 / (1 + e^-x)
+struct SigmoidActivation {
+	static double value(double x) {
+		return 1.0 / (1.0 + fastExp(-x));
+	}
+	
+	static double derivative(double x) {
+		double s = value(x);
+		return s * (1.0 - s);
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		const __m256d one = _mm256_set1_pd(1.0);
+		return _mm256_div_pd(one, _mm256_add_pd(one, fastExp(_mm256_sub_pd(_mm256_setzero_pd(), x))));
+	}
+	
+	static __m256d derivative(__m256d x) {
+		__m256d s = value(x);
+		return _mm256_mul_pd(s, _mm256_sub_pd(_mm256_set1_pd(1.0), s));
+	}
+	#endif
+};
+
+// Tanh 激活：2 * sigmoid(2x) - 1
+struct TanhActivation {
+	static double value(double x) {
+		return 2.0 * SigmoidActivation::value(2.0 * x) - 1.0;
+	}
+	
+	static double derivative(double x) {
+		double t = value(x);
+		return 1.0 - t * t;
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		const __m256d two = _mm256_set1_pd(2.0);
+		return _mm256_sub_pd(_mm256_mul_pd(two, SigmoidActivation::value(_mm256_mul_pd(two, x))), _mm256_set1_pd(1.0));
+	}
+	
+	static __m256d derivative(__m256d x) {
+		__m256d t = value(x);
+		return _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(t, t));
+	}
+	#endif
+};
+
+// GELU 激活（tanh 近似）：0.5x(1 + tanh(sqrt(2/pi)(x + 0.044715x^3)))，即 x * sigmoid(2u)
+struct GELUActivation {
+	static double value(double x) {
+		double u = 0.7978845608028654 * (x + 0.044715 * x * x * x);
+		return x * SigmoidActivation::value(2.0 * u);
+	}
+	
+	static double derivative(double x) {
+		double u = 0.7978845608028654 * (x + 0.044715 * x * x * x);
+		double t = TanhActivation::value(u);
+		double du = 0.7978845608028654 * (1.0 + 3.0 * 0.044715 * x * x);
+		return 0.5 * (1.0 + t) + 0.5 * x * (1.0 - t * t) * du;
+	}
+	
+	#ifdef __AVX2__
+	static __m256d value(__m256d x) {
+		__m256d x3 = _mm256_mul_pd(_mm256_mul_pd(x, x), x);
+		__m256d u = _mm256_mul_pd(_mm256_set1_pd(0.7978845608028654), _mm256_add_pd(x, _mm256_mul_pd(_mm256_set1_pd(0.044715), x3)));
+		return _mm256_mul_pd(x, SigmoidActivation::value(_mm256_mul_pd(_mm256_set1_pd(2.0), u)));
+	}
+	
+	static __m256d derivative(__m256d x) {
+		alignas(32) double values[4];
+		_mm256_store_pd(values, x);
+		
+		for (double& value : values) {
+			value = derivative(value);
+		}
+		
+		return _mm256_load_pd(values);
+	}
+	#endif
+};
@@ -0,0 +1,148 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include "./Profiler.h"
+
+// 激活值竞技场（bump 分配器）
+// 一次性预留整块内存，之后的分配只移动偏移量；reset/release 不归还内存，
+// 因此在容量规划正确的前提下，稳态推理不会产生任何堆分配
+// T 为元素类型：默认的 ActivationArena 存放 double，混合精度训练使用 float 版本
+template<class T>
+class BasicActivationArena {
+		std::vector<T> buffer; // 底层内存，只在 reserve 时分配
+		T* base; // 按缓存行对齐后的起始地址
+		size_t capacity; // 可用容量（以元素计）
+		size_t offset; // 当前分配位置
+		size_t peak; // 历史最高使用量
+		
+	public:
+		// 每次分配按 8 个元素对齐（double 时即一个 64 字节的缓存行）；
+		// 与元素类型无关的对齐粒度使各容量规划函数对 double 与 float 竞技场同样适用
+		static constexpr size_t Alignment = 8;
+		
+		BasicActivationArena(size_t count = 0) : base(nullptr), capacity(0), offset(0), peak(0) {
+			reserve(count);
+		}
+		
+		// 拷贝时只复制容量，不复制内容（竞技场中的数据只在单次计算内有效）
+		BasicActivationArena(const BasicActivationArena& other) : base(nullptr), capacity(0), offset(0), peak(0) {
+			reserve(other.capacity);
+		}
+		
+		BasicActivationArena& operator=(const BasicActivationArena& other) {
+			if (this != &other) {
+				reserve(other.capacity);
+				reset();
+			}
+			
+			return *this;
+		}
+		
+		~BasicActivationArena() {}
+		
+		// 计算分配 count 个元素实际占用的空间（含对齐填充）
+		static size_t footprint(size_t count) {
+			return (count + Alignment - 1) / Alignment * Alignment;
+		}
+		
+		// 确保容量至少为 count 个元素；只有容量不足时才会重新分配，并清空已有分配
+		void reserve(size_t count) {
+			if (count <= capacity) {
+				return;
+			}
+			
+			// 起始地址总是对齐到 64 字节
+			size_t padding = 64 / sizeof(T);
+			buffer.assign(count + padding, T(0));
+			PROFILE_ALLOCATION((count + padding) * sizeof(T));
+			uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data());
+			uintptr_t aligned = (address + 63) & ~(uintptr_t)63;
+			base = reinterpret_cast<T*>(aligned);
+			capacity = count;
+			offset = 0;
+		}
+		
+		// 分配 count 个元素，内容未初始化
+		T* allocate(size_t count) {
+			size_t size = footprint(count);
+			
+			if (offset + size > capacity) {
+				throw std::runtime_error("ActivationArena exhausted: the buffer plan is too small.");
+			}
+			
+			T* result = base + offset;
+			offset += size;
+			
+			if (offset > peak) {
+				peak = offset;
+			}
+			
+			return result;
+		}
+		
+		// 分配 count 个元素并清零
+		T* allocateZeroed(size_t count) {
+			T* result = allocate(count);
+			
+			for (size_t i = 0; i < count; ++i) {
+				result[i] = T(0);
+			}
+			
+			return result;
+		}
+		
+		// 记录当前位置，配合 release 实现栈式的临时空间
+		size_t mark() const {
+			return offset;
+		}
+		
+		// 回退到 mark 记录的位置，其后的分配全部失效
+		void release(size_t position) {
+			offset = position;
+		}
+		
+		// 回退到起点，所有分配全部失效
+		void reset() {
+			offset = 0;
+		}
+		
+		size_t getCapacity() const {
+			return capacity;
+		}
+		
+		size_t getUsed() const {
+			return offset;
+		}
+		
+		size_t getPeak() const {
+			return peak;
+		}
+};
+
+using ActivationArena = BasicActivationArena<double>;
@@ -0,0 +1,243 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "./Public.h"
+
+// 按相同长度补齐的一批序列：第 b 个序列占第 b * length 行起的 length 行，其中前 lengths[b] 行有效，其余为填充
+// lengths 为空表示没有填充；单个序列即 batch 为 1 的特例
+struct SequenceBatch {
+	int batch;
+	int length;
+	const int* lengths;
+	
+	int rows() const {
+		return batch * length;
+	}
+	
+	int valid(int b) const {
+		return lengths == nullptr ? length : lengths[b];
+	}
+};
+
+inline SequenceBatch singleSequence(int seq) {
+	return SequenceBatch{1, seq, nullptr};
+}
+
+// 两个批描述的是否为同一组序列
+inline bool sameBatch(const SequenceBatch& a, const SequenceBatch& b) {
+	return a.batch == b.batch && a.length == b.length && a.lengths == b.lengths;
+}
+
+// 一个训练样本：编码器输入、解码器输入与目标，行数为序列长度，列数为模型维度
+struct SequenceExample {
+	MatrixXd encoder_input;
+	MatrixXd decoder_input;
+	MatrixXd target;
+};
+
+// 补齐后的 mini-batch，填充行全部为 0
+struct SequenceMiniBatch {
+	int size;
+	int encoderLength; // 本批编码器输入补齐后的长度
+	int decoderLength;
+	MatrixXd encoder_input; // size * encoderLength 行
+	MatrixXd decoder_input; // size * decoderLength 行
+	MatrixXd target;
+	std::vector<int> encoderLengths;
+	std::vector<int> decoderLengths;
+	std::vector<int> indices; // 各序列在数据集中的下标
+	
+	SequenceBatch encoderBatch() const {
+		return SequenceBatch{size, encoderLength, encoderLengths.data()};
+	}
+	
+	SequenceBatch decoderBatch() const {
+		return SequenceBatch{size, decoderLength, decoderLengths.data()};
+	}
+};
+
+// 变长序列数据集
+class SequenceDataset {
+		std::vector<SequenceExample> examples;
+		int dim;
+		
+	public:
+		SequenceDataset(int dim) : dim(dim) {}
+		
+		~SequenceDataset() {}
+		
+		void add(const MatrixXd& encoder_input, const MatrixXd& decoder_input, const MatrixXd& target) {
+			if (encoder_input.getCols() != dim || decoder_input.getCols() != dim || target.getCols() != dim) {
+				throw std::invalid_argument("Sequence width must equal the model dimension.");
+			}
+			
+			if (encoder_input.getRows() <= 0 || decoder_input.getRows() <= 0 || decoder_input.getRows() != target.getRows()) {
+				throw std::invalid_argument("Decoder input and target must be non-empty and of equal length.");
+			}
+			
+			examples.push_back(SequenceExample{encoder_input, decoder_input, target});
+		}
+		
+		const SequenceExample& get(int index) const {
+			return examples[index];
+		}
+		
+		int size() const {
+			return static_cast<int>(examples.size());
+		}
+		
+		int getDim() const {
+			return dim;
+		}
+};
+
+// 按长度分桶的 mini-batch 迭代器
+// 每轮先随机打乱，再按（解码器长度，编码器长度）稳定排序后切成不超过 batchSize 的批，
+// 使同一批中的序列长度接近、填充最少；最后打乱批的顺序，避免每轮都从短序列开始
+class MiniBatchIterator {
+		const SequenceDataset& dataset;
+		int batchSize;
+		bool shuffle;
+		std::mt19937 gen;
+		std::vector<std::vector<int>> batches;
+		size_t cursor;
+		
+	public:
+		MiniBatchIterator(const SequenceDataset& dataset, int batchSize, bool shuffle = true)
+			: dataset(dataset), batchSize(batchSize), shuffle(shuffle), gen(std::random_device{}()), cursor(0) {
+			if (batchSize <= 0) {
+				throw std::invalid_argument("Batch size must be positive.");
+			}
+			
+			reset();
+		}
+		
+		~MiniBatchIterator() {}
+		
+		// 开始新的一轮：重新分桶并打乱批的顺序
+		void reset() {
+			std::vector<int> order(dataset.size());
+			std::iota(order.begin(), order.end(), 0);
+			
+			if (shuffle) {
+				std::shuffle(order.begin(), order.end(), gen);
+			}
+			
+			std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+				const SequenceExample& x = dataset.get(a);
+				const SequenceExample& y = dataset.get(b);
+				
+				if (x.decoder_input.getRows() != y.decoder_input.getRows()) {
+					return x.decoder_input.getRows() < y.decoder_input.getRows();
+				}
+				
+				return x.encoder_input.getRows() < y.encoder_input.getRows();
+			});
+			batches.clear();
+			
+			for (size_t i = 0; i < order.size(); i += batchSize) {
+				batches.push_back(std::vector<int>(order.begin() + i, order.begin() + std::min(order.size(), i + batchSize)));
+			}
+			
+			if (shuffle) {
+				std::shuffle(batches.begin(), batches.end(), gen);
+			}
+			
+			cursor = 0;
+		}
+		
+		// 取出下一批并补齐到批内最大长度；本轮结束时返回 false
+		bool next(SequenceMiniBatch& batch) {
+			if (cursor >= batches.size()) {
+				return false;
+			}
+			
+			const std::vector<int>& members = batches[cursor++];
+			int dim = dataset.getDim();
+			batch.size = static_cast<int>(members.size());
+			batch.indices = members;
+			batch.encoderLengths.resize(batch.size);
+			batch.decoderLengths.resize(batch.size);
+			batch.encoderLength = 0;
+			batch.decoderLength = 0;
+			
+			for (int b = 0; b < batch.size; ++b) {
+				const SequenceExample& example = dataset.get(members[b]);
+				batch.encoderLengths[b] = example.encoder_input.getRows();
+				batch.decoderLengths[b] = example.decoder_input.getRows();
+				batch.encoderLength = std::max(batch.encoderLength, batch.encoderLengths[b]);
+				batch.decoderLength = std::max(batch.decoderLength, batch.decoderLengths[b]);
+			}
+			
+			batch.encoder_input = MatrixXd(batch.size * batch.encoderLength, dim);
+			batch.decoder_input = MatrixXd(batch.size * batch.decoderLength, dim);
+			batch.target = MatrixXd(batch.size * batch.decoderLength, dim);
+			
+			for (int b = 0; b < batch.size; ++b) {
+				const SequenceExample& example = dataset.get(members[b]);
+				std::copy(example.encoder_input.data(), example.encoder_input.data() + static_cast<size_t>(batch.encoderLengths[b]) * dim,
+				          batch.encoder_input.data() + static_cast<size_t>(b) * batch.encoderLength * dim);
+				std::copy(example.decoder_input.data(), example.decoder_input.data() + static_cast<size_t>(batch.decoderLengths[b]) * dim,
+				          batch.decoder_input.data() + static_cast<size_t>(b) * batch.decoderLength * dim);
+				std::copy(example.target.data(), example.target.data() + static_cast<size_t>(batch.decoderLengths[b]) * dim,
+				          batch.target.data() + static_cast<size_t>(b) * batch.decoderLength * dim);
+			}
+			
+			return true;
+		}
+		
+		int getBatchCount() const {
+			return static_cast<int>(batches.size());
+		}
+		
+		// 当前分桶方式下填充位置占全部位置的比例
+		double getPaddingRatio() const {
+			double padded = 0.0;
+			double total = 0.0;
+			
+			for (const std::vector<int>& members : batches) {
+				int encoderLength = 0;
+				int decoderLength = 0;
+				double valid = 0.0;
+				
+				for (int index : members) {
+					encoderLength = std::max(encoderLength, dataset.get(index).encoder_input.getRows());
+					decoderLength = std::max(decoderLength, dataset.get(index).decoder_input.getRows());
+					valid += dataset.get(index).encoder_input.getRows() + dataset.get(index).decoder_input.getRows();
+				}
+				
+				double all = static_cast<double>(members.size()) * (encoderLength + decoderLength);
+				padded += all - valid;
+				total += all;
+			}
+			
+			return total == 0.0 ? 0.0 : padded / total;
+		}
+};
@@ -24,92 +24,320 @@
 
 #include "./Public.h"
 #include "./FullyConnectedNeuralNetwork.h"
+#include "./Kernels.h"
+#include <limits>
 
-// 定义卷积层
+// 卷积 + 池化部分权重的只读视图；filters 按 [numFilters][inputChannels][filterSize * filterSize] 连续存放，W 为其存储类型
+template<class W>
+struct BasicConvolutionView {
+	int inputChannels;
+	int inputHeight;
+	int inputWidth;
+	int filterSize;
+	int numFilters;
+	int poolSize;
+	const W* filters;
+};
+
+using ConvolutionView = BasicConvolutionView<double>;
+
+// 单个样本的卷积前向：input 为 [channels][height][width]，output 为 [numFilters][outputHeight][outputWidth]
+template<class T, class W>
+inline void convolutionForward(const BasicConvolutionView<W>& w, const T* input, T* output) {
+	int outputHeight = w.inputHeight - w.filterSize + 1;
+	int outputWidth = w.inputWidth - w.filterSize + 1;
+	PROFILE_SCOPE("Convolution", ProfilePhase::Forward, convolutionFlops(w.inputChannels, w.filterSize, w.numFilters, outputHeight, outputWidth));
+	size_t outputPlane = static_cast<size_t>(outputHeight) * outputWidth;
+	size_t inputPlane = static_cast<size_t>(w.inputHeight) * w.inputWidth;
+	
+	for (size_t i = 0; i < outputPlane * w.numFilters; ++i) {
+		output[i] = T(0);
+	}
+	
+	for (int f = 0; f < w.numFilters; ++f) {
+		for (int c = 0; c < w.inputChannels; ++c) {
+			const W* filter = w.filters + (static_cast<size_t>(f) * w.inputChannels + c) * w.filterSize * w.filterSize;
+			
+			for (int i = 0; i < w.filterSize; ++i) {
+				for (int j = 0; j < w.filterSize; ++j) {
+					for (int h = 0; h < outputHeight; ++h) {
+						axpy(output + f * outputPlane + static_cast<size_t>(h) * outputWidth,
+						     input + c * inputPlane + static_cast<size_t>(h + i) * w.inputWidth + j,
+						     static_cast<T>(filter[i * w.filterSize + j]), outputWidth);
+					}
+				}
+			}
+		}
+	}
+}
+
+// 单个样本的卷积反向：dOutput 与 convolutionForward 的输出布局相同；dFilters 为覆盖写入的滤波器梯度，
+// dInput 非空时覆盖写入输入梯度（使用当前的滤波器）
+template<class T, class W>
+inline void convolutionBackward(const BasicConvolutionView<W>& w, const T* input, const T* dOutput, T* dInput, T* dFilters) {
+	int outputHeight = w.inputHeight - w.filterSize + 1;
+	int outputWidth = w.inputWidth - w.filterSize + 1;
+	PROFILE_SCOPE("Convolution", ProfilePhase::Backward,
+	              (dInput != nullptr ? 2 : 1) * convolutionFlops(w.inputChannels, w.filterSize, w.numFilters, outputHeight, outputWidth));
+	size_t outputPlane = static_cast<size_t>(outputHeight) * outputWidth;
+	size_t inputPlane = static_cast<size_t>(w.inputHeight) * w.inputWidth;
+	
+	if (dInput != nullptr) {
+		std::fill(dInput, dInput + inputPlane * w.inputChannels, T(0));
+	}
+	
+	for (int f = 0; f < w.numFilters; ++f) {
+		for (int c = 0; c < w.inputChannels; ++c) {
+			size_t filterOffset = (static_cast<size_t>(f) * w.inputChannels + c) * w.filterSize * w.filterSize;
+			
+			for (int i = 0; i < w.filterSize; ++i) {
+				for (int j = 0; j < w.filterSize; ++j) {
+					T gradient = T(0);
+					
+					for (int h = 0; h < outputHeight; ++h) {
+						const T* gradRow = dOutput + f * outputPlane + static_cast<size_t>(h) * outputWidth;
+						size_t window = c * inputPlane + static_cast<size_t>(h + i) * w.inputWidth + j;
+						gradient += dot(gradRow, input + window, outputWidth);
+						
+						if (dInput != nullptr) {
+							axpy(dInput + window, gradRow, static_cast<T>(w.filters[filterOffset + i * w.filterSize + j]), outputWidth);
+						}
+					}
+					
+					dFilters[filterOffset + i * w.filterSize + j] = gradient;
+				}
+			}
+		}
+	}
+}
+
+// 单个样本的最大池化前向：input 为 [channels][height][width]
+// argmax 非空时记录每个输出取最大值的输入下标（通道内），供反向传播使用
+template<class T>
+inline void maxPoolingForward(const T* input, int channels, int height, int width, int poolSize, T* output, int* argmax = nullptr) {
+	PROFILE_SCOPE("MaxPooling", ProfilePhase::Forward, 0.0);
+	int outputHeight = height / poolSize;
+	int outputWidth = width / poolSize;
+	
+	for (int c = 0; c < channels; ++c) {
+		const T* plane = input + static_cast<size_t>(c) * height * width;
+		T* result = output + static_cast<size_t>(c) * outputHeight * outputWidth;
+		
+		for (int h = 0; h < outputHeight; ++h) {
+			for (int w = 0; w < outputWidth; ++w) {
+				T maxVal = -std::numeric_limits<T>::max();
+				int maxIndex = 0;
+				
+				for (int i = 0; i < poolSize; ++i) {
+					for (int j = 0; j < poolSize; ++j) {
+						int index = (h * poolSize + i) * width + (w * poolSize + j);
+						
+						if (plane[index] > maxVal) {
+							maxVal = plane[index];
+							maxIndex = index;
+						}
+					}
+				}
+				
+				result[h * outputWidth + w] = maxVal;
+				
+				if (argmax != nullptr) {
+					argmax[static_cast<size_t>(c) * outputHeight * outputWidth + h * outputWidth + w] = maxIndex;
+				}
+			}
+		}
+	}
+}
+
+// 定义卷积层：滤波器按 [numFilters][inputChannels][filterSize * filterSize] 连续存放，
+// 前向与反向直接调用 convolutionForward / convolutionBackward，与混合精度路径共用同一份实现
 class ConvolutionalLayer {
-		std::vector<std::vector<std::vector<double >>> filters;
+		std::vector<double> filters;
+		int inputChannels;
 		int filterSize;
 		int numFilters;
+		int lastHeight = 0;
+		int lastWidth = 0;
+		std::vector<double> lastInput; // 最近一次前向传播的输入，按 [channels][height][width] 连续存放，反向传播时使用
+		std::vector<double> outputBuffer; // 连续存放的卷积输出，反向时复用为输出梯度
+		std::vector<double> filterGradient;
+		std::vector<double> inputGradient;
+		
+		ConvolutionView view() const {
+			return ConvolutionView{inputChannels, lastHeight, lastWidth, filterSize, numFilters, 0, filters.data()};
+		}
 		
 	public:
 		ConvolutionalLayer(int inputChannels, int filterSize, int numFilters)
-			: filterSize(filterSize), numFilters(numFilters) {
+			: inputChannels(inputChannels), filterSize(filterSize), numFilters(numFilters) {
 			std::random_device rd;
 			std::mt19937 gen(rd());
 			std::uniform_real_distribution<> dis(-0.5, 0.5);
-			filters.resize(numFilters);
-			for (int i = 0; i < numFilters; ++i) {
-				filters[i].resize(inputChannels);
-				for (int j = 0; j < inputChannels; ++j) {
-					filters[i][j].resize(filterSize * filterSize);
-					for (int k = 0; k < filterSize * filterSize; ++k) {
-						filters[i][j][k] = dis(gen);
-					}
-				}
+			filters.resize(static_cast<size_t>(numFilters) * inputChannels * filterSize * filterSize);
+			
+			for (double& weight : filters) {
+				weight = dis(gen);
 			}
 		}
 		
 		std::vector<std::vector<double >> forward(const std::vector<std::vector<std::vector<double >>> & input) {
-			int inputHeight = input[0].size();
-			int inputWidth = input[0][0].size();
-			int outputHeight = inputHeight - filterSize + 1;
-			int outputWidth = inputWidth - filterSize + 1;
-			std::vector<std::vector<double >> output(numFilters, std::vector<double>(outputHeight * outputWidth, 0.0));
+			lastHeight = input[0].size();
+			lastWidth = input[0][0].size();
+			int outputPlane = (lastHeight - filterSize + 1) * (lastWidth - filterSize + 1);
+			lastInput.resize(static_cast<size_t>(inputChannels) * lastHeight * lastWidth);
+			outputBuffer.resize(static_cast<size_t>(numFilters) * outputPlane);
+			
+			for (int c = 0; c < inputChannels; ++c) {
+				for (int h = 0; h < lastHeight; ++h) {
+					std::copy(input[c][h].begin(), input[c][h].end(), lastInput.begin() + (static_cast<size_t>(c) * lastHeight + h) * lastWidth);
+				}
+			}
+			
+			convolutionForward(view(), lastInput.data(), outputBuffer.data());
+			std::vector<std::vector<double >> output(numFilters);
 			
 			for (int f = 0; f < numFilters; ++f) {
-				for (size_t c = 0; c < input.size(); ++c) {
-					for (int h = 0; h < outputHeight; ++h) {
-						for (int w = 0; w < outputWidth; ++w) {
-							for (int i = 0; i < filterSize; ++i) {
-								for (int j = 0; j < filterSize; ++j) {
-									output[f][h * outputWidth + w] += input[c][h + i][w + j] * filters[f][c][i * filterSize + j];
-								}
-							}
-						}
+				output[f].assign(outputBuffer.begin() + static_cast<size_t>(f) * outputPlane, outputBuffer.begin() + static_cast<size_t>(f + 1) * outputPlane);
+			}
+			
+			return output;
+		}
+		
+		// 反向传播：gradOutput 为损失对卷积输出的梯度，更新滤波器；needInputGradient 为真时返回损失对输入的梯度（按更新前的滤波器计算），
+		// 否则返回空，作为网络第一层时不必计算
+		std::vector<std::vector<std::vector<double >>> backward(const std::vector<std::vector<double >>& gradOutput, double learning_rate,
+		                                               bool needInputGradient = true) {
+			int outputPlane = (lastHeight - filterSize + 1) * (lastWidth - filterSize + 1);
+			filterGradient.resize(filters.size());
+			
+			for (int f = 0; f < numFilters; ++f) {
+				std::copy(gradOutput[f].begin(), gradOutput[f].end(), outputBuffer.begin() + static_cast<size_t>(f) * outputPlane);
+			}
+			
+			if (needInputGradient) {
+				inputGradient.resize(lastInput.size());
+			}
+			
+			convolutionBackward(view(), lastInput.data(), outputBuffer.data(), needInputGradient ? inputGradient.data() : nullptr, filterGradient.data());
+			
+			for (size_t i = 0; i < filters.size(); ++i) {
+				filters[i] -= learning_rate * filterGradient[i];
+			}
+			
+			std::vector<std::vector<std::vector<double >>> gradInput;
+			
+			if (needInputGradient) {
+				gradInput.assign(inputChannels, std::vector<std::vector<double >>(lastHeight));
+				
+				for (int c = 0; c < inputChannels; ++c) {
+					for (int h = 0; h < lastHeight; ++h) {
+						auto row = inputGradient.begin() + (static_cast<size_t>(c) * lastHeight + h) * lastWidth;
+						gradInput[c][h].assign(row, row + lastWidth);
 					}
 				}
 			}
-			return output;
+			
+			return gradInput;
 		}
 		
 		// 添加公共访问器方法
 		int getNumFilters() const {
 			return numFilters;
 		}
+		
+		int getFilterSize() const {
+			return filterSize;
+		}
+		
+		int getInputChannels() const {
+			return inputChannels;
+		}
+		
+		// 按 [numFilters][inputChannels][filterSize * filterSize] 连续存放的滤波器
+		const std::vector<double>& getFilters() const {
+			return filters;
+		}
+		
+		// 把滤波器登记到混合精度参数中，工作副本中的布局与 filters 相同，返回起始偏移
+		size_t bindParameters(MixedPrecisionParameters& registry) {
+			size_t first = registry.size();
+			registry.beginGroup(0.0);
+			registry.add(filters.data(), filters.size());
+			return first;
+		}
+		
+		// 从 [numFilters][inputChannels][filterSize * filterSize] 连续存放的权重拷贝滤波器
+		void loadFilters(const double* source) {
+			std::copy(source, source + filters.size(), filters.begin());
+		}
 };
 
 // 定义池化层
 class PoolingLayer {
 		int poolSize;
+		int lastInputSize; // 最近一次前向传播时每个通道的输入大小
+		std::vector<std::vector<int >> argmax; // 最近一次前向传播时每个输出取最大值的输入下标
 		
 	public:
-		PoolingLayer(int poolSize) : poolSize(poolSize) {}
+		PoolingLayer(int poolSize) : poolSize(poolSize), lastInputSize(0) {}
 		
 		std::vector<std::vector<double >> forward(const std::vector<std::vector<double >>& input) {
 			int inputHeight = static_cast<int>(std::sqrt(input[0].size()));
 			int inputWidth = inputHeight;
 			int outputHeight = inputHeight / poolSize;
 			int outputWidth = inputWidth / poolSize;
+			PROFILE_SCOPE("MaxPooling", ProfilePhase::Forward, 0.0);
 			std::vector<std::vector<double >> output(input.size(), std::vector<double>(outputHeight * outputWidth, 0.0));
+			lastInputSize = input[0].size();
+			argmax.assign(input.size(), std::vector<int>(outputHeight * outputWidth, 0));
 			
 			for (size_t c = 0; c < input.size(); ++c) {
 				for (int h = 0; h < outputHeight; ++h) {
 					for (int w = 0; w < outputWidth; ++w) {
 						double maxVal = -std::numeric_limits<double>::max();
+						int maxIndex = 0;
 						
 						for (int i = 0; i < poolSize; ++i) {
 							for (int j = 0; j < poolSize; ++j) {
 								int inputIndex = (h * poolSize + i) * inputWidth + (w * poolSize + j);
-								maxVal = std::max(maxVal, input[c][inputIndex]);
+								
+								if (input[c][inputIndex] > maxVal) {
+									maxVal = input[c][inputIndex];
+									maxIndex = inputIndex;
+								}
 							}
 						}
 						
 						output[c][h * outputWidth + w] = maxVal;
+						argmax[c][h * outputWidth + w] = maxIndex;
 					}
 				}
 			}
 			return output;
 		}
+		
+		// 反向传播：梯度只流向前向传播时取到最大值的位置
+		std::vector<std::vector<double >> backward(const std::vector<std::vector<double >>& gradOutput) const {
+			PROFILE_SCOPE("MaxPooling", ProfilePhase::Backward, 0.0);
+			std::vector<std::vector<double >> gradInput(argmax.size(), std::vector<double>(lastInputSize, 0.0));
+			
+			for (size_t c = 0; c < argmax.size(); ++c) {
+				for (size_t o = 0; o < argmax[c].size(); ++o) {
+					gradInput[c][argmax[c][o]] += gradOutput[c][o];
+				}
+			}
+			
+			return gradInput;
+		}
+		
+		int getPoolSize() const {
+			return poolSize;
+		}
+		
+		// 最近一次前向传播时每个通道的输出大小
+		int getOutputSize() const {
+			return argmax.empty() ? 0 : static_cast<int>(argmax[0].size());
+		}
 };
 
 // 定义CNN
@@ -117,6 +345,77 @@ class ConvolutionalNeuralNetwork {
 		ConvolutionalLayer CL;
 		PoolingLayer PL;
 		FullyConnectedNeuralNetwork FCL;
+		int inputHeight;
+		int inputWidth;
+		PrecisionPolicy policy = doublePrecision(); // 训练精度
+		LossScaler scaler;
+		MixedPrecisionParameters parameters; // 卷积滤波器与全连接部分的混合精度参数
+		size_t filterOffset = 0;
+		std::vector<double> sampleInput; // 逐样本训练时按 [channels][height][width] 连续存放的输入
+		std::vector<std::vector<std::vector<double >>> sampleImage;
+		std::vector<double> sampleTarget;
+		std::vector<float> mixedInput; // 混合精度训练的各级缓冲
+		std::vector<float> mixedConvOutput;
+		std::vector<float> mixedConvGradient;
+		std::vector<float> mixedPoolOutput;
+		std::vector<int> mixedArgmax;
+		
+		// 混合精度的一步：卷积、池化与全连接部分都在 float 上计算，整个样本的梯度无溢出时才更新 double 主权重
+		template<class W>
+		double trainSampleMixed(double learning_rate) {
+			if (parameters.empty()) {
+				filterOffset = CL.bindParameters(parameters);
+				FCL.bindParameters(parameters);
+				parameters.allocate(policy.precision);
+			}
+			
+			int channels = CL.getInputChannels();
+			int filterSize = CL.getFilterSize();
+			int numFilters = CL.getNumFilters();
+			int poolSize = PL.getPoolSize();
+			int convHeight = inputHeight - filterSize + 1;
+			int convWidth = inputWidth - filterSize + 1;
+			size_t convSize = static_cast<size_t>(numFilters) * convHeight * convWidth;
+			size_t poolPlane = static_cast<size_t>(convHeight / poolSize) * (convWidth / poolSize);
+			mixedInput.resize(sampleInput.size());
+			mixedConvOutput.resize(convSize);
+			mixedConvGradient.resize(convSize);
+			mixedPoolOutput.resize(numFilters * poolPlane);
+			mixedArgmax.resize(numFilters * poolPlane);
+			narrowCopy(sampleInput.data(), mixedInput.data(), mixedInput.size());
+			BasicConvolutionView<W> view{channels, inputHeight, inputWidth, filterSize, numFilters, poolSize, parameters.template working<W>() + filterOffset};
+			convolutionForward(view, mixedInput.data(), mixedConvOutput.data());
+			maxPoolingForward(mixedConvOutput.data(), numFilters, convHeight, convWidth, poolSize, mixedPoolOutput.data(), mixedArgmax.data());
+			const float* output = FCL.template forwardMixed<W>(parameters, mixedPoolOutput.data());
+			double loss = 0.0;
+			
+			for (size_t k = 0; k < sampleTarget.size(); ++k) {
+				loss += (output[k] - sampleTarget[k]) * (output[k] - sampleTarget[k]);
+			}
+			
+			double scale = scaler.getScale();
+			FCL.template backwardMixed<W>(parameters, sampleTarget, static_cast<float>(scale));
+			// 池化的反向：梯度只流向取到最大值的位置
+			{
+				PROFILE_SCOPE("MaxPooling", ProfilePhase::Backward, 0.0);
+				const std::vector<float>& poolGradient = FCL.getMixedInputGradient();
+				std::fill(mixedConvGradient.begin(), mixedConvGradient.end(), 0.0f);
+				
+				for (int f = 0; f < numFilters; ++f) {
+					for (size_t o = 0; o < poolPlane; ++o) {
+						mixedConvGradient[f * static_cast<size_t>(convHeight) * convWidth + mixedArgmax[f * poolPlane + o]] += poolGradient[f * poolPlane + o];
+					}
+				}
+			}
+			
+			convolutionBackward(view, mixedInput.data(), mixedConvGradient.data(), static_cast<float*>(nullptr), parameters.gradient() + filterOffset);
+			
+			if (scaler.update(parameters.finite())) {
+				parameters.apply(learning_rate, 1.0 / scale);
+			}
+			
+			return loss / sampleTarget.size();
+		}
 		
 	public:
 		ConvolutionalNeuralNetwork(int inputChannels, int filterSize, int numFilters, int poolSize, const std::vector<int>& layerSizes, int OutputHeight = 32, int OutputWidth = 32)
@@ -130,10 +429,52 @@ class ConvolutionalNeuralNetwork {
 			std::vector<int> newLayerSizes = {inputSize};
 			newLayerSizes.insert(newLayerSizes.end(), layerSizes.begin(), layerSizes.end());
 			return FullyConnectedNeuralNetwork(newLayerSizes, sigmoid, sigmoid_derivative);
-		}()) {}
+		}()), inputHeight(OutputHeight), inputWidth(OutputWidth) {}
 		
 		~ConvolutionalNeuralNetwork() {}
 		
+		const ConvolutionalLayer& getConvolutionalLayer() const {
+			return CL;
+		}
+		
+		const PoolingLayer& getPoolingLayer() const {
+			return PL;
+		}
+		
+		const FullyConnectedNeuralNetwork& getFullyConnectedLayer() const {
+			return FCL;
+		}
+		
+		int getInputHeight() const {
+			return inputHeight;
+		}
+		
+		int getInputWidth() const {
+			return inputWidth;
+		}
+		
+		// 从连续权重视图拷贝卷积滤波器与全连接部分的权重
+		void loadWeights(const double* filters, const std::vector<DenseLayerView>& layers) {
+			CL.loadFilters(filters);
+			FCL.loadWeights(layers);
+			parameters.clear();
+		}
+		
+		// 设置训练精度；Float32/BFloat16 时 train 在 float 上计算，主权重仍为 double
+		void setPrecision(const PrecisionPolicy& precision) {
+			policy = precision;
+			scaler = LossScaler(precision);
+			parameters.clear();
+		}
+		
+		const PrecisionPolicy& getPrecision() const {
+			return policy;
+		}
+		
+		const LossScaler& getLossScaler() const {
+			return scaler;
+		}
+		
 		std::vector<double> forward(const std::vector<std::vector<std::vector<double >>> & input) {
 			auto convOutput = CL.forward(input);
 			auto poolOutput = PL.forward(convOutput);
@@ -146,18 +487,103 @@ class ConvolutionalNeuralNetwork {
 		}
 		
 		void train(const std::vector<std::vector<std::vector<std::vector<double >>> > & inputs, const std::vector<std::vector<double >> & targets, int epochs, double learning_rate) {
+			int channels = CL.getInputChannels();
+			size_t planeSize = static_cast<size_t>(inputHeight) * inputWidth;
+			std::vector<double> input(channels * planeSize);
 			int epoch = 0;
 			double totalLoss = 0.0;
+			
 			for (; epoch < epochs; ++epoch) {
 				totalLoss = 0.0;
+				
 				for (size_t i = 0; i < inputs.size(); ++i) {
-					auto output = forward(inputs[i]);
-					double loss = FCL.mse_loss(output, targets[i]);
-					totalLoss += loss;
-					FCL.backpropagate(targets[i], learning_rate);
+					if (static_cast<int>(inputs[i].size()) != channels || targets[i].size() != FCL.getOutputSize()) {
+						throw std::invalid_argument("Sample size does not match the network.");
+					}
+					
+					for (int c = 0; c < channels; ++c) {
+						for (int h = 0; h < inputHeight; ++h) {
+							std::copy(inputs[i][c][h].begin(), inputs[i][c][h].begin() + inputWidth, input.begin() + c * planeSize + static_cast<size_t>(h) * inputWidth);
+						}
+					}
+					
+					totalLoss += trainSample(input.data(), targets[i].data(), learning_rate);
 				}
 			}
 			
 			std::cout << "Epoch " << epoch << ", Loss: " << totalLoss / inputs.size() << std::endl;
 		}
+		
+		// 从数据集流式训练：数据集的输入形状须为 inputChannels x inputHeight x inputWidth
+		void train(DataLoader& loader, int epochs, double learning_rate) {
+			const MappedDataset& dataset = loader.getDataset();
+			
+			if (dataset.getChannels() != CL.getInputChannels() || dataset.getHeight() != inputHeight || dataset.getWidth() != inputWidth
+			        || dataset.getTargetCount() != FCL.getOutputSize()) {
+				throw std::invalid_argument("Dataset shape does not match the network.");
+			}
+			
+			int epoch = 0;
+			size_t sampleCount = 0;
+			double totalLoss = 0.0;
+			
+			for (; epoch < epochs; ++epoch) {
+				totalLoss = 0.0;
+				sampleCount = 0;
+				loader.reset();
+				
+				while (const DatasetBatch* batch = loader.next()) {
+					sampleCount += batch->size;
+					
+					for (int i = 0; i < batch->size; ++i) {
+						totalLoss += trainSample(batch->input(i), batch->target(i), learning_rate);
+					}
+				}
+			}
+			
+			std::cout << "Epoch " << epoch << ", Loss: " << totalLoss / std::max<size_t>(sampleCount, 1) << std::endl;
+		}
+		
+		// 以一个样本（按 [channels][height][width] 连续存放）做一步随机梯度下降，返回该样本的损失
+		double trainSample(const double* input, const double* target, double learning_rate) {
+			PROFILE_STEP("ConvolutionalNeuralNetwork::trainSample");
+			int channels = CL.getInputChannels();
+			sampleInput.assign(input, input + static_cast<size_t>(channels) * inputHeight * inputWidth);
+			sampleTarget.assign(target, target + FCL.getOutputSize());
+			
+			if (policy.precision == Precision::Float32) {
+				return trainSampleMixed<float>(learning_rate);
+			}
+			
+			if (policy.precision == Precision::BFloat16) {
+				return trainSampleMixed<bfloat16>(learning_rate);
+			}
+			
+			sampleImage.resize(channels);
+			
+			for (int c = 0; c < channels; ++c) {
+				sampleImage[c].resize(inputHeight);
+				
+				for (int h = 0; h < inputHeight; ++h) {
+					const double* row = input + (static_cast<size_t>(c) * inputHeight + h) * inputWidth;
+					sampleImage[c][h].assign(row, row + inputWidth);
+				}
+			}
+			
+			auto output = forward(sampleImage);
+			double loss = FCL.mse_loss(output, sampleTarget);
+			FCL.backpropagate(sampleTarget, learning_rate);
+			// 将全连接层的输入梯度还原成池化输出的形状，继续向卷积层反向传播
+			const std::vector<double>& flattenedGrad = FCL.getInputGradient();
+			int poolOutputSize = PL.getOutputSize();
+			std::vector<std::vector<double >> poolGrad(CL.getNumFilters());
+			
+			for (int f = 0; f < CL.getNumFilters(); ++f) {
+				poolGrad[f].assign(flattenedGrad.begin() + f * poolOutputSize, flattenedGrad.begin() + (f + 1) * poolOutputSize);
+			}
+			
+			// 卷积层是第一层，不需要输入梯度
+			CL.backward(PL.backward(poolGrad), learning_rate, false);
+			return loss;
+		}
 };
@@ -0,0 +1,480 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "./MappedFile.h"
+
+// 数据集文件格式（本机字节序）：
+//   DatasetFileHeader
+//   样本记录                每条记录依次为输入与目标，记录之间紧密排列，第一条记录按 64 字节对齐
+// 元素以 float 或 double 存放；float 存放的文件只有同样数据以 vector<vector<double>> 驻留内存时的几分之一大小
+// 文件通过内存映射按需读入，样本数不受内存大小限制
+
+#define DATASET_FILE_MAGIC "CCLDATA"
+#define DATASET_FILE_VERSION 1
+#define DATASET_DATA_ALIGNMENT 64
+
+// 样本元素的存储类型
+enum class DatasetElement : uint32_t {
+	Float64 = 0,
+	Float32 = 1
+};
+
+struct DatasetFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t element; // DatasetElement
+	uint32_t channels; // 输入形状：channels x height x width（全连接网络的输入为 n x 1 x 1）
+	uint32_t height;
+	uint32_t width;
+	uint32_t targetCount;
+	uint64_t sampleCount;
+	uint64_t dataOffset; // 第一条记录相对文件开头的字节偏移
+};
+
+inline size_t datasetElementSize(DatasetElement element) {
+	return element == DatasetElement::Float32 ? sizeof(float) : sizeof(double);
+}
+
+// 数据集文件写入器：逐个追加样本，任何时候内存中都只有一条记录，可以把超出内存的数据流式转换成数据集文件
+// close（或析构）时回填样本数
+class DatasetWriter {
+		std::ofstream file;
+		std::string path;
+		DatasetFileHeader header;
+		size_t inputCount;
+		std::vector<char> record;
+		
+		template<class T>
+		void pack(const double* values, size_t count, char* destination) {
+			for (size_t i = 0; i < count; ++i) {
+				T value = static_cast<T>(values[i]);
+				std::memcpy(destination + i * sizeof(T), &value, sizeof(T));
+			}
+		}
+		
+	public:
+		DatasetWriter(const std::string& path, int channels, int height, int width, int targetCount, DatasetElement element = DatasetElement::Float32)
+			: file(path, std::ios::binary | std::ios::trunc), path(path), header{}, inputCount(static_cast<size_t>(channels) * height * width) {
+			if (channels <= 0 || height <= 0 || width <= 0 || targetCount < 0) {
+				throw std::invalid_argument("Invalid dataset sample shape.");
+			}
+			
+			if (!file.is_open()) {
+				throw std::runtime_error("Failed to open dataset file: " + path);
+			}
+			
+			std::memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+			header.version = DATASET_FILE_VERSION;
+			header.element = static_cast<uint32_t>(element);
+			header.channels = channels;
+			header.height = height;
+			header.width = width;
+			header.targetCount = targetCount;
+			header.dataOffset = (sizeof(DatasetFileHeader) + DATASET_DATA_ALIGNMENT - 1) / DATASET_DATA_ALIGNMENT * DATASET_DATA_ALIGNMENT;
+			record.resize((inputCount + targetCount) * datasetElementSize(element));
+			// 先写出样本数为 0 的文件头并补齐到数据区，close 时再回填
+			std::vector<char> padding(header.dataOffset, 0);
+			std::memcpy(padding.data(), &header, sizeof(header));
+			file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+		}
+		
+		// 全连接网络的样本：inputCount 个输入与 targetCount 个目标
+		DatasetWriter(const std::string& path, int inputCount, int targetCount, DatasetElement element = DatasetElement::Float32)
+			: DatasetWriter(path, inputCount, 1, 1, targetCount, element) {}
+			
+		DatasetWriter(const DatasetWriter&) = delete;
+		DatasetWriter& operator=(const DatasetWriter&) = delete;
+		
+		~DatasetWriter() {
+			try {
+				close();
+			}
+			catch (...) {
+			}
+		}
+		
+		// 追加一个样本：input 有 channels * height * width 个元素，target 有 targetCount 个元素
+		void append(const double* input, const double* target) {
+			if (!file.is_open()) {
+				throw std::logic_error("Dataset writer is already closed.");
+			}
+			
+			size_t elementSize = datasetElementSize(static_cast<DatasetElement>(header.element));
+			
+			if (header.element == static_cast<uint32_t>(DatasetElement::Float32)) {
+				pack<float>(input, inputCount, record.data());
+				pack<float>(target, header.targetCount, record.data() + inputCount * elementSize);
+			}
+			else {
+				pack<double>(input, inputCount, record.data());
+				pack<double>(target, header.targetCount, record.data() + inputCount * elementSize);
+			}
+			
+			file.write(record.data(), static_cast<std::streamsize>(record.size()));
+			++header.sampleCount;
+		}
+		
+		void append(const std::vector<double>& input, const std::vector<double>& target) {
+			if (input.size() != inputCount || target.size() != header.targetCount) {
+				throw std::invalid_argument("Sample does not match the dataset shape.");
+			}
+			
+			append(input.data(), target.data());
+		}
+		
+		uint64_t getSampleCount() const {
+			return header.sampleCount;
+		}
+		
+		// 回填文件头并关闭文件
+		void close() {
+			if (!file.is_open()) {
+				return;
+			}
+			
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.close();
+			
+			if (!file) {
+				throw std::runtime_error("Failed to write dataset file: " + path);
+			}
+		}
+};
+
+// 把已经在内存中的全连接样本写成数据集文件
+inline void writeDataset(const std::string& path, const std::vector<std::vector<double >>& inputs, const std::vector<std::vector<double >>& targets,
+                         DatasetElement element = DatasetElement::Float32) {
+	if (inputs.empty() || inputs.size() != targets.size()) {
+		throw std::invalid_argument("Inputs and targets must be non-empty and of the same size.");
+	}
+	
+	DatasetWriter writer(path, static_cast<int>(inputs[0].size()), static_cast<int>(targets[0].size()), element);
+	
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		writer.append(inputs[i], targets[i]);
+	}
+	
+	writer.close();
+}
+
+// 只读映射的数据集文件，支持按下标随机读取样本
+class MappedDataset {
+		MappedFile mapped;
+		const DatasetFileHeader* header;
+		size_t inputCount;
+		size_t recordSize;
+		
+		template<class T>
+		static void unpack(const char* source, size_t count, double* destination) {
+			for (size_t i = 0; i < count; ++i) {
+				T value;
+				std::memcpy(&value, source + i * sizeof(T), sizeof(T));
+				destination[i] = value;
+			}
+		}
+		
+	public:
+		MappedDataset(const std::string& path) : mapped(path), header(nullptr), inputCount(0), recordSize(0) {
+			if (mapped.getSize() < sizeof(DatasetFileHeader)) {
+				throw std::runtime_error("Dataset file is too small.");
+			}
+			
+			header = reinterpret_cast<const DatasetFileHeader*>(mapped.data());
+			
+			if (std::memcmp(header->magic, DATASET_FILE_MAGIC, sizeof(header->magic)) != 0) {
+				throw std::runtime_error("Not a dataset file.");
+			}
+			
+			if (header->version == 0 || header->version > DATASET_FILE_VERSION) {
+				throw std::runtime_error("Unsupported dataset file version.");
+			}
+			
+			if (header->element > static_cast<uint32_t>(DatasetElement::Float32)) {
+				throw std::runtime_error("Unknown dataset element type.");
+			}
+			
+			inputCount = static_cast<size_t>(header->channels) * header->height * header->width;
+			recordSize = (inputCount + header->targetCount) * datasetElementSize(getElement());
+			
+			if (header->dataOffset < sizeof(DatasetFileHeader) || header->dataOffset + header->sampleCount * recordSize > mapped.getSize()) {
+				throw std::runtime_error("Dataset file is truncated.");
+			}
+		}
+		
+		MappedDataset(const MappedDataset&) = delete;
+		MappedDataset& operator=(const MappedDataset&) = delete;
+		
+		~MappedDataset() {}
+		
+		size_t size() const {
+			return header->sampleCount;
+		}
+		
+		DatasetElement getElement() const {
+			return static_cast<DatasetElement>(header->element);
+		}
+		
+		int getChannels() const {
+			return header->channels;
+		}
+		
+		int getHeight() const {
+			return header->height;
+		}
+		
+		int getWidth() const {
+			return header->width;
+		}
+		
+		size_t getInputCount() const {
+			return inputCount;
+		}
+		
+		size_t getTargetCount() const {
+			return header->targetCount;
+		}
+		
+		// 第 index 个样本的原始记录
+		const char* record(size_t index) const {
+			if (index >= size()) {
+				throw std::out_of_range("Dataset sample index out of range.");
+			}
+			
+			return mapped.data() + header->dataOffset + index * recordSize;
+		}
+		
+		// 把第 index 个样本转换为 double 写入 input 与 target（target 可以为空）
+		void read(size_t index, double* input, double* target) const {
+			const char* source = record(index);
+			size_t elementSize = datasetElementSize(getElement());
+			
+			if (getElement() == DatasetElement::Float32) {
+				unpack<float>(source, inputCount, input);
+				
+				if (target != nullptr) {
+					unpack<float>(source + inputCount * elementSize, header->targetCount, target);
+				}
+			}
+			else {
+				unpack<double>(source, inputCount, input);
+				
+				if (target != nullptr) {
+					unpack<double>(source + inputCount * elementSize, header->targetCount, target);
+				}
+			}
+		}
+		
+		void advise(FileAccess access) const {
+			mapped.advise(access);
+		}
+};
+
+// 一批样本：第 i 个样本的输入位于 inputs[i * inputCount]，目标位于 targets[i * targetCount]
+struct DatasetBatch {
+	int size;
+	size_t inputCount;
+	size_t targetCount;
+	std::vector<double> inputs;
+	std::vector<double> targets;
+	std::vector<size_t> indices; // 各样本在数据集中的下标
+	
+	const double* input(int i) const {
+		return inputs.data() + static_cast<size_t>(i) * inputCount;
+	}
+	
+	const double* target(int i) const {
+		return targets.data() + static_cast<size_t>(i) * targetCount;
+	}
+};
+
+// 数据集的 mini-batch 加载器
+// 每轮按下标排列的一个随机置换（或原顺序）分批；后台线程把样本从映射中读出并转换到两个批缓冲中交替填充，
+// 训练线程处理当前批时下一批已经在准备，磁盘读取与缺页处理与计算重叠
+// next 返回的批在下一次调用 next 或 reset 之前有效
+class DataLoader {
+		const MappedDataset& dataset;
+		int batchSize;
+		bool shuffle;
+		bool dropLast;
+		std::mt19937_64 generator;
+		std::vector<size_t> order; // 本轮的样本顺序
+		DatasetBatch buffers[2];
+		bool filled[2]; // 缓冲是否已由后台线程填好且尚未被训练线程归还
+		int batchCount; // 本轮的批数
+		int consumed; // 训练线程已取走的批数
+		bool holding; // 训练线程是否持有一个缓冲（上一次 next 的结果）
+		bool stopping;
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable changed;
+		
+		void fill(DatasetBatch& batch, int index) {
+			size_t first = static_cast<size_t>(index) * batchSize;
+			int size = static_cast<int>(std::min(order.size() - first, static_cast<size_t>(batchSize)));
+			batch.size = size;
+			batch.indices.assign(order.begin() + first, order.begin() + first + size);
+			
+			for (int i = 0; i < size; ++i) {
+				dataset.read(batch.indices[i], batch.inputs.data() + i * batch.inputCount, batch.targets.data() + i * batch.targetCount);
+			}
+		}
+		
+		// 后台线程：依次填充各批，两个缓冲都在使用中时等待训练线程归还
+		void produce() {
+			for (int index = 0; index < batchCount; ++index) {
+				int slot = index % 2;
+				
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&]() {
+						return stopping || !filled[slot];
+					});
+					
+					if (stopping) {
+						return;
+					}
+				}
+				
+				fill(buffers[slot], index);
+				
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					filled[slot] = true;
+				}
+				
+				changed.notify_all();
+			}
+		}
+		
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			
+			changed.notify_all();
+			
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		
+	public:
+		DataLoader(const MappedDataset& dataset, int batchSize, bool shuffle = true, unsigned long long seed = 0, bool dropLast = false)
+			: dataset(dataset), batchSize(batchSize), shuffle(shuffle), dropLast(dropLast), generator(seed), filled{false, false}, batchCount(0), consumed(0),
+			  holding(false), stopping(false) {
+			if (batchSize <= 0) {
+				throw std::invalid_argument("Batch size must be positive.");
+			}
+			
+			for (DatasetBatch& buffer : buffers) {
+				buffer.size = 0;
+				buffer.inputCount = dataset.getInputCount();
+				buffer.targetCount = dataset.getTargetCount();
+				buffer.inputs.resize(batchSize * buffer.inputCount);
+				buffer.targets.resize(batchSize * buffer.targetCount);
+			}
+			
+			order.resize(dataset.size());
+			std::iota(order.begin(), order.end(), 0);
+			dataset.advise(shuffle ? FileAccess::Random : FileAccess::Sequential);
+		}
+		
+		DataLoader(const DataLoader&) = delete;
+		DataLoader& operator=(const DataLoader&) = delete;
+		
+		~DataLoader() {
+			stop();
+		}
+		
+		// 开始新的一轮：停止上一轮的预取，重新打乱顺序并启动后台线程
+		void reset() {
+			stop();
+			std::iota(order.begin(), order.end(), 0);
+			
+			if (shuffle) {
+				std::shuffle(order.begin(), order.end(), generator);
+			}
+			
+			batchCount = getBatchCount();
+			consumed = 0;
+			holding = false;
+			stopping = false;
+			filled[0] = false;
+			filled[1] = false;
+			worker = std::thread(&DataLoader::produce, this);
+		}
+		
+		// 取下一批；本轮结束时返回 nullptr。第一次调用前必须先 reset
+		const DatasetBatch* next() {
+			std::unique_lock<std::mutex> lock(mutex);
+			
+			// 归还上一次取走的缓冲
+			if (holding) {
+				filled[(consumed - 1) % 2] = false;
+				holding = false;
+				changed.notify_all();
+			}
+			
+			if (consumed >= batchCount) {
+				return nullptr;
+			}
+			
+			int slot = consumed % 2;
+			changed.wait(lock, [&]() {
+				return filled[slot];
+			});
+			++consumed;
+			holding = true;
+			return &buffers[slot];
+		}
+		
+		// 每轮的批数（dropLast 时不含末尾不满的一批）
+		int getBatchCount() const {
+			size_t count = dataset.size();
+			return static_cast<int>(dropLast ? count / batchSize : (count + batchSize - 1) / batchSize);
+		}
+		
+		int getBatchSize() const {
+			return batchSize;
+		}
+		
+		const MappedDataset& getDataset() const {
+			return dataset;
+		}
+};
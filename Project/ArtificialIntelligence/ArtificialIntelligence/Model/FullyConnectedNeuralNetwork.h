@@ -28,6 +28,7 @@
 #include <iostream>
 #include <functional>
 #include "./Public.h"
+#include "./Dataset.h"
 
 // 定义神经网络节点结构体
 struct NeuralNetworkNode {
@@ -55,24 +56,125 @@ struct NeuralNetworkNode {
 	}
 };
 
+// 全连接层权重的只读视图
+// weights 为 inputSize x outputSize 行主序矩阵，thresholds 为下一层各节点的阈值；W 为权重的存储类型
+template<class W>
+struct BasicDenseLayerView {
+	int inputSize;
+	int outputSize;
+	const W* weights;
+	const W* thresholds;
+};
+
+using DenseLayerView = BasicDenseLayerView<double>;
+
+// 批量全连接层前向（编译期激活）：output = Activation(input * weights - thresholds)
+// input 为 batch x inputSize，output 为 batch x outputSize；每算完一行立即在缓存中应用激活（epilogue 融合）
+template<class Activation, class T, class W>
+inline void denseForward(const BasicDenseLayerView<W>& layer, const T* input, int batch, T* output) {
+	for (int b = 0; b < batch; ++b) {
+		T* row = output + static_cast<size_t>(b) * layer.outputSize;
+		
+		for (int k = 0; k < layer.outputSize; ++k) {
+			row[k] = -static_cast<T>(layer.thresholds[k]);
+		}
+		
+		gemm(input + static_cast<size_t>(b) * layer.inputSize, layer.weights, row, 1, layer.outputSize, layer.inputSize);
+		applyElementwise<Activation>(row, layer.outputSize);
+	}
+}
+
+// 批量全连接层前向：按激活种类分派一次，自定义激活退回到逐元素调用
+template<class T, class W>
+inline void denseForward(const BasicDenseLayerView<W>& layer, const T* input, int batch, T* output, ActivationKind kind, const ActivationFunction& activation) {
+	switch (kind) {
+		case ActivationKind::Identity:
+			denseForward<IdentityActivation>(layer, input, batch, output);
+			break;
+			
+		case ActivationKind::Sigmoid:
+			denseForward<SigmoidActivation>(layer, input, batch, output);
+			break;
+			
+		case ActivationKind::ReLU:
+			denseForward<ReLUActivation>(layer, input, batch, output);
+			break;
+			
+		case ActivationKind::Tanh:
+			denseForward<TanhActivation>(layer, input, batch, output);
+			break;
+			
+		case ActivationKind::GELU:
+			denseForward<GELUActivation>(layer, input, batch, output);
+			break;
+			
+		default:
+			denseForward<IdentityActivation>(layer, input, batch, output);
+			applyActivation(kind, output, static_cast<size_t>(batch) * layer.outputSize, activation);
+	}
+}
+
 // 定义全连接神经网络类
 class FullyConnectedNeuralNetwork {
 
 		std::vector<std::vector<NeuralNetworkNode >> nodes; // 存储神经网络的所有节点
-		std::random_device rd; // 随机数设备
 		std::mt19937 gen; // Mersenne Twister随机数生成器
 		std::uniform_real_distribution<> dis; // 均匀分布
 		ActivationFunction activation; // 激活函数
 		ActivationFunction activation_derivative; // 激活函数的导数
+		ActivationKind activationKind; // 内置激活函数的种类，用于整层向量化计算
+		ActivationKind derivativeKind;
+		std::vector<double> layerBuffer; // 整层计算的临时缓冲区
+		std::vector<double> derivativeBuffer;
+		std::vector<double> inputGradient; // 最近一次反向传播得到的损失对输入的梯度
+		PrecisionPolicy policy = doublePrecision(); // 训练精度
+		LossScaler scaler;
+		MixedPrecisionParameters parameters; // 单独训练时的混合精度参数（作为 CNN 的一部分时登记在 CNN 中）
+		std::vector<size_t> weightOffsets; // 第 i 层到第 i + 1 层的边权在混合精度参数中的偏移
+		std::vector<size_t> thresholdOffsets; // 第 i 层各节点的阈值在混合精度参数中的偏移
+		std::vector<size_t> layerOffsets; // 第 i 层在混合精度缓冲区中的起始位置
+		std::vector<float> mixedResults; // 混合精度前向时各层的输出
+		std::vector<float> mixedDeltas; // 混合精度反向时各层的误差项
+		std::vector<float> mixedDerivatives;
+		std::vector<float> mixedInputGradient; // 混合精度反向得到的（已乘以损失缩放系数的）输入梯度
+		std::vector<double> sampleInput; // 逐样本训练时的输入与目标缓冲
+		std::vector<double> sampleTarget;
+		std::vector<float> mixedInput;
+		
+		// 对第 layer 层所有节点的输出整体计算激活函数导数，结果存入 derivativeBuffer
+		void computeDerivatives(int layer) {
+			int width = nodes[layer].size();
+			layerBuffer.resize(width);
+			derivativeBuffer.resize(width);
+			
+			for (int j = 0; j < width; ++j) {
+				layerBuffer[j] = nodes[layer][j].result;
+			}
+			
+			applyActivationDerivative(derivativeKind, layerBuffer.data(), derivativeBuffer.data(), width, activation_derivative);
+		}
+		
+		// 一次前向的浮点运算量估计（剖析用）
+		double flopCount() const {
+			double flops = 0.0;
+			
+			for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+				flops += denseFlops(1, nodes[i].size(), nodes[i + 1].size());
+			}
+			
+			return flops;
+		}
 		
 	public:
 		// 默认构造函数
 		FullyConnectedNeuralNetwork(ActivationFunction func = relu, ActivationFunction func_derivative = relu_derivative)
-			: gen(rd()), dis(-0.5, 0.5), activation(func), activation_derivative(func_derivative) {}
+			: gen(std::random_device{}()), dis(-0.5, 0.5), activation(func), activation_derivative(func_derivative),
+			  activationKind(activationKindOf(func)), derivativeKind(derivativeKindOf(func_derivative)) {}
 			
 		// 构造函数，根据每层的节点数量初始化神经网络
 		FullyConnectedNeuralNetwork(const std::vector<int>& layerSizes, ActivationFunction func = sigmoid, ActivationFunction func_derivative = sigmoid_derivative)
-			: gen(rd()), dis(-0.5, 0.5), activation(func), activation_derivative(func_derivative) {
+			: gen(std::random_device{}()), dis(-0.5, 0.5), activation(func), activation_derivative(func_derivative),
+			  activationKind(activationKindOf(func)), derivativeKind(derivativeKindOf(func_derivative)) {
 			int deep = layerSizes.size();
 			nodes.resize(deep);
 			
@@ -105,6 +207,7 @@ class FullyConnectedNeuralNetwork {
 				throw std::invalid_argument("Input size does not match the number of input nodes.");
 			}
 			
+			PROFILE_SCOPE("FullyConnected", ProfilePhase::Forward, flopCount());
 			int deep = nodes.size();
 			
 			// 初始化输入层节点的输出值
@@ -112,10 +215,23 @@ class FullyConnectedNeuralNetwork {
 				nodes[0][i].result = input[i];
 			}
 			
-			// 逐层计算每个节点的输出值
+			// 逐层计算每个节点的输出值：先把整层的加权和累加到缓冲区，再一次性应用激活函数
 			for (int i = 1; i < deep; ++i) {
-				for (size_t j = 0; j < nodes[i].size(); ++j) {
-					nodes[i][j].calculate(nodes[i - 1], j);
+				int width = nodes[i].size();
+				layerBuffer.resize(width);
+				
+				for (int j = 0; j < width; ++j) {
+					layerBuffer[j] = -nodes[i][j].threshold;
+				}
+				
+				for (const auto& node : nodes[i - 1]) {
+					axpy(layerBuffer.data(), node.edge.data(), node.result, width);
+				}
+				
+				applyActivation(activationKind, layerBuffer.data(), width, activation);
+				
+				for (int j = 0; j < width; ++j) {
+					nodes[i][j].result = layerBuffer[j];
 				}
 			}
 			
@@ -142,16 +258,21 @@ class FullyConnectedNeuralNetwork {
 		
 		// 反向传播算法
 		void backpropagate(const std::vector<double>& target, double learning_rate) {
+			PROFILE_SCOPE("FullyConnected", ProfilePhase::Backward, 2 * flopCount());
 			int deep = nodes.size();
 			
 			// 计算输出层的误差项
+			computeDerivatives(deep - 1);
+			
 			for (size_t i = 0; i < nodes.back().size(); ++i) {
 				double error = nodes.back()[i].result - target[i];
-				nodes.back()[i].delta = error * nodes.back()[i].activation_derivative(nodes.back()[i].result);
+				nodes.back()[i].delta = error * derivativeBuffer[i];
 			}
 			
 			// 反向传播计算隐藏层的误差项
 			for (int i = deep - 2; i > 0; --i) {
+				computeDerivatives(i);
+				
 				for (size_t j = 0; j < nodes[i].size(); ++j) {
 					double sum = 0.0;
 					
@@ -159,7 +280,22 @@ class FullyConnectedNeuralNetwork {
 						sum += nodes[i + 1][k].delta * nodes[i][j].edge[k];
 					}
 					
-					nodes[i][j].delta = sum * nodes[i][j].activation_derivative(nodes[i][j].result);
+					nodes[i][j].delta = sum * derivativeBuffer[j];
+				}
+			}
+			
+			// 计算损失对输入层的梯度（必须在更新权重之前），供前置的卷积/池化层继续反向传播
+			inputGradient.assign(nodes[0].size(), 0.0);
+			
+			if (deep > 1) {
+				for (size_t j = 0; j < nodes[0].size(); ++j) {
+					double sum = 0.0;
+					
+					for (size_t k = 0; k < nodes[1].size(); ++k) {
+						sum += nodes[1][k].delta * nodes[0][j].edge[k];
+					}
+					
+					inputGradient[j] = sum;
 				}
 			}
 			
@@ -175,6 +311,206 @@ class FullyConnectedNeuralNetwork {
 			}
 		}
 		
+		// 获取全部节点（按层组织）
+		const std::vector<std::vector<NeuralNetworkNode >>& getNodes() const {
+			return nodes;
+		}
+		
+		// 获取激活函数
+		const ActivationFunction& getActivation() const {
+			return activation;
+		}
+		
+		ActivationKind getActivationKind() const {
+			return activationKind;
+		}
+		
+		// 获取激活函数的导数
+		const ActivationFunction& getActivationDerivative() const {
+			return activation_derivative;
+		}
+		
+		// 获取每层的节点数量
+		std::vector<int> getLayerSizes() const {
+			std::vector<int> sizes;
+			
+			for (const auto& layer : nodes) {
+				sizes.push_back(static_cast<int>(layer.size()));
+			}
+			
+			return sizes;
+		}
+		
+		// 从连续权重视图拷贝边权与阈值（层结构需与当前网络一致）
+		void loadWeights(const std::vector<DenseLayerView>& layers) {
+			if (layers.size() + 1 != nodes.size()) {
+				throw std::invalid_argument("Layer count does not match.");
+			}
+			
+			for (size_t i = 0; i < layers.size(); ++i) {
+				if (layers[i].inputSize != static_cast<int>(nodes[i].size()) || layers[i].outputSize != static_cast<int>(nodes[i + 1].size())) {
+					throw std::invalid_argument("Layer size does not match.");
+				}
+				
+				for (int j = 0; j < layers[i].inputSize; ++j) {
+					const double* row = layers[i].weights + static_cast<size_t>(j) * layers[i].outputSize;
+					nodes[i][j].edge.assign(row, row + layers[i].outputSize);
+				}
+				
+				for (int k = 0; k < layers[i].outputSize; ++k) {
+					nodes[i + 1][k].threshold = layers[i].thresholds[k];
+				}
+			}
+			
+			// 混合精度的工作副本已经过期，下次训练时重新生成
+			parameters.clear();
+		}
+		
+		// 获取最近一次反向传播得到的损失对输入的梯度
+		const std::vector<double>& getInputGradient() const {
+			return inputGradient;
+		}
+		
+		// 输出层的节点数
+		size_t getOutputSize() const {
+			return nodes.back().size();
+		}
+		
+		// 设置训练精度；Float32/BFloat16 时 train 在 float 上计算，主权重仍为 double
+		void setPrecision(const PrecisionPolicy& precision) {
+			policy = precision;
+			scaler = LossScaler(precision);
+			parameters.clear();
+		}
+		
+		const PrecisionPolicy& getPrecision() const {
+			return policy;
+		}
+		
+		const LossScaler& getLossScaler() const {
+			return scaler;
+		}
+		
+		// 把全部边权与阈值登记到混合精度参数中：每层的边权按节点顺序登记，在工作副本中拼成 inputSize x outputSize 的矩阵
+		void bindParameters(MixedPrecisionParameters& registry) {
+			int deep = nodes.size();
+			weightOffsets.assign(deep, 0);
+			thresholdOffsets.assign(deep, 0);
+			layerOffsets.assign(deep + 1, 0);
+			
+			for (int i = 0; i < deep; ++i) {
+				layerOffsets[i + 1] = layerOffsets[i] + nodes[i].size();
+				registry.beginGroup(0.0);
+				
+				for (size_t j = 0; j < nodes[i].size(); ++j) {
+					size_t offset = registry.add(&nodes[i][j].threshold, 1);
+					
+					if (j == 0) {
+						thresholdOffsets[i] = offset;
+					}
+				}
+				
+				if (i + 1 < deep) {
+					for (size_t j = 0; j < nodes[i].size(); ++j) {
+						size_t offset = registry.add(nodes[i][j].edge.data(), nodes[i][j].edge.size());
+						
+						if (j == 0) {
+							weightOffsets[i] = offset;
+						}
+					}
+				}
+			}
+			
+			mixedResults.assign(layerOffsets[deep], 0.0f);
+			mixedDeltas.assign(layerOffsets[deep], 0.0f);
+			mixedDerivatives.assign(layerOffsets[deep], 0.0f);
+			mixedInputGradient.assign(nodes[0].size(), 0.0f);
+		}
+		
+		// 混合精度前向：与 calculate 相同的计算，权重取自工作副本（W 为 float 或 bfloat16），返回输出层的结果
+		template<class W>
+		const float* forwardMixed(const MixedPrecisionParameters& registry, const float* input) {
+			PROFILE_SCOPE("FullyConnected", ProfilePhase::Forward, flopCount());
+			int deep = nodes.size();
+			std::copy(input, input + nodes[0].size(), mixedResults.data());
+			
+			for (int i = 1; i < deep; ++i) {
+				BasicDenseLayerView<W> layer{static_cast<int>(nodes[i - 1].size()), static_cast<int>(nodes[i].size()),
+				                             registry.template working<W>() + weightOffsets[i - 1], registry.template working<W>() + thresholdOffsets[i]};
+				denseForward(layer, mixedResults.data() + layerOffsets[i - 1], 1, mixedResults.data() + layerOffsets[i], activationKind, activation);
+			}
+			
+			return mixedResults.data() + layerOffsets[deep - 1];
+		}
+		
+		// 混合精度反向：与 backpropagate 相同的更新规则，误差项乘以 scale（损失缩放系数），
+		// 梯度覆盖写入 registry 中本网络的部分，不更新权重；输入梯度见 getMixedInputGradient
+		template<class W>
+		void backwardMixed(MixedPrecisionParameters& registry, const std::vector<double>& target, float scale) {
+			PROFILE_SCOPE("FullyConnected", ProfilePhase::Backward, 2 * flopCount());
+			int deep = nodes.size();
+			const W* working = registry.template working<W>();
+			float* gradient = registry.gradient();
+			
+			for (int i = 1; i < deep; ++i) {
+				applyActivationDerivative(derivativeKind, mixedResults.data() + layerOffsets[i], mixedDerivatives.data() + layerOffsets[i],
+				                          nodes[i].size(), activation_derivative);
+			}
+			
+			// 输出层的误差项
+			float* output = mixedResults.data() + layerOffsets[deep - 1];
+			float* delta = mixedDeltas.data() + layerOffsets[deep - 1];
+			
+			for (size_t k = 0; k < nodes.back().size(); ++k) {
+				delta[k] = scale * (output[k] - static_cast<float>(target[k])) * mixedDerivatives[layerOffsets[deep - 1] + k];
+			}
+			
+			// 隐藏层的误差项：delta_i = (delta_{i+1} * W_i^T) ⊙ f'(result_i)
+			for (int i = deep - 2; i > 0; --i) {
+				int width = nodes[i].size();
+				float* current = mixedDeltas.data() + layerOffsets[i];
+				std::fill(current, current + width, 0.0f);
+				gemmTransB(mixedDeltas.data() + layerOffsets[i + 1], working + weightOffsets[i], current, 1, width, nodes[i + 1].size());
+				
+				for (int j = 0; j < width; ++j) {
+					current[j] *= mixedDerivatives[layerOffsets[i] + j];
+				}
+			}
+			
+			if (deep > 1) {
+				std::fill(mixedInputGradient.begin(), mixedInputGradient.end(), 0.0f);
+				gemmTransB(mixedDeltas.data() + layerOffsets[1], working + weightOffsets[0], mixedInputGradient.data(), 1, nodes[0].size(), nodes[1].size());
+			}
+			
+			// 边权梯度为 result_i ⊗ delta_{i+1}；与 backpropagate 一致，只有隐藏层的阈值参与更新
+			for (int i = 0; i < deep; ++i) {
+				float* thresholds = gradient + thresholdOffsets[i];
+				
+				for (size_t j = 0; j < nodes[i].size(); ++j) {
+					thresholds[j] = i > 0 && i < deep - 1 ? mixedDeltas[layerOffsets[i] + j] : 0.0f;
+				}
+				
+				if (i + 1 < deep) {
+					const float* result = mixedResults.data() + layerOffsets[i];
+					const float* next = mixedDeltas.data() + layerOffsets[i + 1];
+					size_t width = nodes[i + 1].size();
+					
+					for (size_t j = 0; j < nodes[i].size(); ++j) {
+						float* row = gradient + weightOffsets[i] + j * width;
+						
+						for (size_t k = 0; k < width; ++k) {
+							row[k] = result[j] * next[k];
+						}
+					}
+				}
+			}
+		}
+		
+		// 最近一次 backwardMixed 得到的输入梯度（已乘以损失缩放系数）
+		const std::vector<float>& getMixedInputGradient() const {
+			return mixedInputGradient;
+		}
+		
 		// 训练神经网络
 		void train(const std::vector<std::vector<double >> & inputs, const std::vector<std::vector<double >>& targets, int epochs, double learning_rate) {
 			int epoch = 0;
@@ -184,13 +520,91 @@ class FullyConnectedNeuralNetwork {
 				total_loss = 0;
 				
 				for (size_t i = 0; i < inputs.size(); ++i) {
-					std::vector<double> output = calculate(inputs[i]);
-					double loss = mse_loss(output, targets[i]);
-					total_loss += loss;
-					backpropagate(targets[i], learning_rate);
+					if (inputs[i].size() != nodes[0].size() || targets[i].size() != nodes.back().size()) {
+						throw std::invalid_argument("Sample size does not match the network.");
+					}
+					
+					total_loss += trainSample(inputs[i].data(), targets[i].data(), learning_rate);
 				}
 			}
 			
 			std::cout << "Epoch " << epoch << ", Loss: " << total_loss / inputs.size() << std::endl;
 		}
+		
+		// 从数据集流式训练：每轮由 loader 重新打乱并在后台预取，样本不需要全部驻留内存
+		void train(DataLoader& loader, int epochs, double learning_rate) {
+			const MappedDataset& dataset = loader.getDataset();
+			
+			if (dataset.getInputCount() != nodes[0].size() || dataset.getTargetCount() != nodes.back().size()) {
+				throw std::invalid_argument("Dataset shape does not match the network.");
+			}
+			
+			int epoch = 0;
+			size_t sampleCount = 0;
+			double total_loss = 0.0;
+			
+			for (; epoch < epochs; ++epoch) {
+				total_loss = 0;
+				sampleCount = 0;
+				loader.reset();
+				
+				while (const DatasetBatch* batch = loader.next()) {
+					sampleCount += batch->size;
+					
+					for (int i = 0; i < batch->size; ++i) {
+						total_loss += trainSample(batch->input(i), batch->target(i), learning_rate);
+					}
+				}
+			}
+			
+			std::cout << "Epoch " << epoch << ", Loss: " << total_loss / std::max<size_t>(sampleCount, 1) << std::endl;
+		}
+		
+		// 以一个样本做一步随机梯度下降（按当前训练精度），返回该样本的损失
+		double trainSample(const double* input, const double* target, double learning_rate) {
+			PROFILE_STEP("FullyConnectedNeuralNetwork::trainSample");
+			sampleInput.assign(input, input + nodes[0].size());
+			sampleTarget.assign(target, target + nodes.back().size());
+			
+			if (policy.precision == Precision::Float32) {
+				return trainSampleMixed<float>(learning_rate);
+			}
+			
+			if (policy.precision == Precision::BFloat16) {
+				return trainSampleMixed<bfloat16>(learning_rate);
+			}
+			
+			std::vector<double> output = calculate(sampleInput);
+			double loss = mse_loss(output, sampleTarget);
+			backpropagate(sampleTarget, learning_rate);
+			return loss;
+		}
+		
+	private:
+		// 混合精度的一步：样本在 float 上前向与反向，梯度无溢出时更新 double 主权重
+		template<class W>
+		double trainSampleMixed(double learning_rate) {
+			if (parameters.empty()) {
+				bindParameters(parameters);
+				parameters.allocate(policy.precision);
+			}
+			
+			mixedInput.resize(sampleInput.size());
+			narrowCopy(sampleInput.data(), mixedInput.data(), mixedInput.size());
+			const float* output = forwardMixed<W>(parameters, mixedInput.data());
+			double loss = 0.0;
+			
+			for (size_t k = 0; k < sampleTarget.size(); ++k) {
+				loss += (output[k] - sampleTarget[k]) * (output[k] - sampleTarget[k]);
+			}
+			
+			double scale = scaler.getScale();
+			backwardMixed<W>(parameters, sampleTarget, static_cast<float>(scale));
+			
+			if (scaler.update(parameters.finite())) {
+				parameters.apply(learning_rate, 1.0 / scale);
+			}
+			
+			return loss / sampleTarget.size();
+		}
 };
@@ -0,0 +1,341 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "./Public.h"
+#include "./Arena.h"
+#include "./FullyConnectedNeuralNetwork.h"
+#include "./ConvolutionalNeuralNetwork.h"
+#include "./Transformer.h"
+
+// 推理会话：在构造时一次性规划并预留全部激活缓冲区，之后每次推理只在竞技场中移动偏移量，
+// 稳态下不产生堆分配。会话不是线程安全的，服务端应为每个工作线程创建独立的会话。
+// 会话只读取权重，模型继续训练后需要调用 refresh 重新同步。
+
+// 全连接网络推理会话
+class FullyConnectedInferenceSession {
+		std::vector<DenseLayerView> layers;
+		std::vector<double> packedWeights; // 从模型打包得到的连续权重；使用外部权重视图时为空
+		ActivationFunction activation;
+		ActivationKind activationKind;
+		int maxBatch;
+		size_t bufferSize; // 每块激活缓冲区的大小
+		ActivationArena arena;
+		
+		// 规划缓冲区：两块交替使用的激活缓冲区，大小由最宽的一层决定
+		void plan() {
+			if (layers.empty()) {
+				throw std::invalid_argument("Inference session requires at least one layer.");
+			}
+			
+			int maxWidth = layers[0].inputSize;
+			
+			for (const auto& layer : layers) {
+				maxWidth = std::max(maxWidth, layer.outputSize);
+			}
+			
+			bufferSize = static_cast<size_t>(maxBatch) * maxWidth;
+			arena.reserve(2 * ActivationArena::footprint(bufferSize));
+		}
+		
+	public:
+		// 从模型构造：把逐节点存放的边权打包成每层一块连续矩阵
+		FullyConnectedInferenceSession(const FullyConnectedNeuralNetwork& network, int maxBatch = 1)
+			: activation(network.getActivation()), activationKind(network.getActivationKind()), maxBatch(maxBatch), bufferSize(0) {
+			refresh(network);
+		}
+		
+		// 从外部权重视图构造（例如映射到内存中的模型文件），权重不做拷贝
+		FullyConnectedInferenceSession(const std::vector<DenseLayerView>& layers, ActivationFunction activation, int maxBatch = 1)
+			: layers(layers), activation(activation), activationKind(activationKindOf(activation)), maxBatch(maxBatch), bufferSize(0) {
+			plan();
+		}
+		
+		~FullyConnectedInferenceSession() {}
+		
+		// 重新打包模型的权重（模型训练后调用）
+		void refresh(const FullyConnectedNeuralNetwork& network) {
+			const auto& nodes = network.getNodes();
+			size_t total = 0;
+			
+			for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+				total += nodes[i].size() * nodes[i + 1].size() + nodes[i + 1].size();
+			}
+			
+			packedWeights.assign(total, 0.0);
+			layers.clear();
+			double* cursor = packedWeights.data();
+			
+			for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+				DenseLayerView layer{static_cast<int>(nodes[i].size()), static_cast<int>(nodes[i + 1].size()), cursor, nullptr};
+				
+				for (const auto& node : nodes[i]) {
+					std::copy(node.edge.begin(), node.edge.end(), cursor);
+					cursor += layer.outputSize;
+				}
+				
+				layer.thresholds = cursor;
+				
+				for (const auto& node : nodes[i + 1]) {
+					*cursor++ = node.threshold;
+				}
+				
+				layers.push_back(layer);
+			}
+			
+			plan();
+		}
+		
+		// 批量推理：input 为 batch x 输入大小，返回 batch x 输出大小的结果，指针在下一次 run 之前有效
+		const double* run(const double* input, int batch) {
+			if (batch > maxBatch) {
+				throw std::invalid_argument("Batch size exceeds the planned maximum.");
+			}
+			
+			arena.reset();
+			double* buffers[2] = {arena.allocate(bufferSize), arena.allocate(bufferSize)};
+			const double* current = input;
+			
+			for (size_t i = 0; i < layers.size(); ++i) {
+				double* next = buffers[i % 2];
+				denseForward(layers[i], current, batch, next, activationKind, activation);
+				current = next;
+			}
+			
+			return current;
+		}
+		
+		// 单个样本推理，接口与 FullyConnectedNeuralNetwork::calculate 一致
+		std::vector<double> calculate(const std::vector<double>& input) {
+			if (static_cast<int>(input.size()) != getInputSize()) {
+				throw std::invalid_argument("Input size does not match the number of input nodes.");
+			}
+			
+			const double* output = run(input.data(), 1);
+			return std::vector<double>(output, output + getOutputSize());
+		}
+		
+		int getInputSize() const {
+			return layers.front().inputSize;
+		}
+		
+		int getOutputSize() const {
+			return layers.back().outputSize;
+		}
+		
+		ActivationKind getActivationKind() const {
+			return activationKind;
+		}
+		
+		const ActivationFunction& getActivation() const {
+			return activation;
+		}
+		
+		int getMaxBatch() const {
+			return maxBatch;
+		}
+		
+		const std::vector<DenseLayerView>& getLayers() const {
+			return layers;
+		}
+};
+
+// 卷积神经网络推理会话
+class ConvolutionalInferenceSession {
+		ConvolutionView convolution;
+		std::vector<double> packedFilters; // 从模型打包得到的连续滤波器；使用外部权重视图时为空
+		FullyConnectedInferenceSession fullyConnected;
+		int maxBatch;
+		ActivationArena arena;
+		
+		size_t convolutionSize() const {
+			return static_cast<size_t>(convolution.numFilters) * (convolution.inputHeight - convolution.filterSize + 1) * (convolution.inputWidth - convolution.filterSize + 1);
+		}
+		
+		size_t poolingSize() const {
+			int height = (convolution.inputHeight - convolution.filterSize + 1) / convolution.poolSize;
+			int width = (convolution.inputWidth - convolution.filterSize + 1) / convolution.poolSize;
+			return static_cast<size_t>(convolution.numFilters) * height * width;
+		}
+		
+		// 拷贝模型的连续滤波器，使会话不依赖模型对象的生命周期
+		void packFilters(const ConvolutionalNeuralNetwork& network) {
+			const ConvolutionalLayer& layer = network.getConvolutionalLayer();
+			packedFilters = layer.getFilters();
+			
+			convolution = ConvolutionView{layer.getInputChannels(), network.getInputHeight(), network.getInputWidth(),
+			                              layer.getFilterSize(), layer.getNumFilters(), network.getPoolingLayer().getPoolSize(), packedFilters.data()};
+		}
+		
+		void plan() {
+			if (static_cast<int>(poolingSize()) != fullyConnected.getInputSize()) {
+				throw std::invalid_argument("Pooling output size does not match the fully connected input size.");
+			}
+			
+			arena.reserve(ActivationArena::footprint(convolutionSize()) + ActivationArena::footprint(static_cast<size_t>(maxBatch) * poolingSize()));
+		}
+		
+	public:
+		ConvolutionalInferenceSession(const ConvolutionalNeuralNetwork& network, int maxBatch = 1)
+			: fullyConnected(network.getFullyConnectedLayer(), maxBatch), maxBatch(maxBatch) {
+			packFilters(network);
+			plan();
+		}
+		
+		// 从外部权重视图构造，权重不做拷贝
+		ConvolutionalInferenceSession(const ConvolutionView& convolution, const std::vector<DenseLayerView>& layers, ActivationFunction activation, int maxBatch = 1)
+			: convolution(convolution), fullyConnected(layers, activation, maxBatch), maxBatch(maxBatch) {
+			plan();
+		}
+		
+		~ConvolutionalInferenceSession() {}
+		
+		// 重新打包模型的权重（模型训练后调用）
+		void refresh(const ConvolutionalNeuralNetwork& network) {
+			packFilters(network);
+			fullyConnected.refresh(network.getFullyConnectedLayer());
+			plan();
+		}
+		
+		// 批量推理：input 为 batch 个连续存放的 [channels][height][width] 样本
+		const double* run(const double* input, int batch) {
+			if (batch > maxBatch) {
+				throw std::invalid_argument("Batch size exceeds the planned maximum.");
+			}
+			
+			arena.reset();
+			double* convOutput = arena.allocate(convolutionSize());
+			double* poolOutput = arena.allocate(static_cast<size_t>(batch) * poolingSize());
+			size_t inputSize = static_cast<size_t>(convolution.inputChannels) * convolution.inputHeight * convolution.inputWidth;
+			
+			// 卷积缓冲区逐样本复用，池化结果按批连续存放后一次性交给全连接部分
+			for (int b = 0; b < batch; ++b) {
+				convolutionForward(convolution, input + b * inputSize, convOutput);
+				maxPoolingForward(convOutput, convolution.numFilters, convolution.inputHeight - convolution.filterSize + 1,
+				                  convolution.inputWidth - convolution.filterSize + 1, convolution.poolSize, poolOutput + b * poolingSize());
+			}
+			
+			return fullyConnected.run(poolOutput, batch);
+		}
+		
+		// 单个样本推理，接口与 ConvolutionalNeuralNetwork::forward 一致
+		std::vector<double> forward(const std::vector<std::vector<std::vector<double >>> & input) {
+			std::vector<double> flattened;
+			
+			for (const auto& channel : input) {
+				for (const auto& row : channel) {
+					flattened.insert(flattened.end(), row.begin(), row.end());
+				}
+			}
+			
+			const double* output = run(flattened.data(), 1);
+			return std::vector<double>(output, output + fullyConnected.getOutputSize());
+		}
+		
+		int getOutputSize() const {
+			return fullyConnected.getOutputSize();
+		}
+};
+
+// Transformer 推理会话
+class TransformerInferenceSession {
+		EncoderView encoder;
+		DecoderView decoder;
+		PositionalView positional;
+		int dim;
+		int maxSequenceLength;
+		ActivationArena arena;
+		
+		void plan() {
+			size_t matrix = ActivationArena::footprint(static_cast<size_t>(maxSequenceLength) * dim);
+			size_t workspace = std::max(encoderWorkspace(maxSequenceLength, dim, encoder.attention.heads), decoderWorkspace(maxSequenceLength, maxSequenceLength, dim, decoder.selfAttention.heads));
+			// 两个叠加位置编码后的输入与两个输出
+			arena.reserve(4 * matrix + workspace);
+		}
+		
+	public:
+		// maxSequenceLength 为编码器与解码器输入允许的最大序列长度
+		TransformerInferenceSession(const Transformer& model, int maxSequenceLength)
+			: dim(model.getInputDim()), maxSequenceLength(maxSequenceLength) {
+			refresh(model);
+		}
+		
+		// 从外部权重视图构造，权重不做拷贝
+		TransformerInferenceSession(const EncoderView& encoder, const DecoderView& decoder, const PositionalView& positional, int maxSequenceLength)
+			: encoder(encoder), decoder(decoder), positional(positional), dim(encoder.attention.dim), maxSequenceLength(maxSequenceLength) {
+			plan();
+		}
+		
+		~TransformerInferenceSession() {}
+		
+		// Transformer 的权重本身就是连续存储，这里只需刷新视图
+		void refresh(const Transformer& model) {
+			encoder = model.getEncoder().getView();
+			decoder = model.getDecoder().getView();
+			positional = model.getPositional();
+			plan();
+		}
+		
+		// 单个序列推理，返回 decoderLength x dim 的结果，指针在下一次 run 之前有效
+		const double* run(const double* encoderInput, int encoderLength, const double* decoderInput, int decoderLength) {
+			if (encoderLength > maxSequenceLength || decoderLength > maxSequenceLength) {
+				throw std::invalid_argument("Sequence length exceeds the planned maximum.");
+			}
+			
+			arena.reset();
+			size_t encoderSize = static_cast<size_t>(encoderLength) * dim;
+			size_t decoderSize = static_cast<size_t>(decoderLength) * dim;
+			double* encoderEmbedded = arena.allocate(encoderSize);
+			double* decoderEmbedded = arena.allocate(decoderSize);
+			double* encoderOutput = arena.allocate(encoderSize);
+			double* decoderOutput = arena.allocate(decoderSize);
+			std::copy(encoderInput, encoderInput + encoderSize, encoderEmbedded);
+			std::copy(decoderInput, decoderInput + decoderSize, decoderEmbedded);
+			addPositionalEncoding(positional, encoderEmbedded, singleSequence(encoderLength), dim);
+			addPositionalEncoding(positional, decoderEmbedded, singleSequence(decoderLength), dim);
+			encoderLayerForward(encoder, encoderEmbedded, encoderLength, encoderOutput, arena);
+			decoderLayerForward(decoder, decoderEmbedded, decoderLength, encoderOutput, encoderLength, decoderOutput, arena);
+			return decoderOutput;
+		}
+		
+		// 批量推理：各序列依次复用同一块竞技场，结果写入调用方提供的 outputs[b]（decoderLengths[b] x dim）
+		void runBatch(int batch, const double* const* encoderInputs, const int* encoderLengths,
+		              const double* const* decoderInputs, const int* decoderLengths, double* const* outputs) {
+			for (int b = 0; b < batch; ++b) {
+				const double* result = run(encoderInputs[b], encoderLengths[b], decoderInputs[b], decoderLengths[b]);
+				std::copy(result, result + static_cast<size_t>(decoderLengths[b]) * dim, outputs[b]);
+			}
+		}
+		
+		// 接口与 Transformer::inference 一致
+		MatrixXd inference(const MatrixXd& encoder_input, const MatrixXd& decoder_input) {
+			MatrixXd output(decoder_input.getRows(), dim);
+			const double* result = run(encoder_input.data(), encoder_input.getRows(), decoder_input.data(), decoder_input.getRows());
+			std::copy(result, result + static_cast<size_t>(decoder_input.getRows()) * dim, output.data());
+			return output;
+		}
+};
@@ -0,0 +1,441 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "./Arena.h"
+#include "./Transformer.h"
+
+#define KV_CACHE_PAGE_ROWS 16 // 每页缓存的位置数
+
+// 分页键值缓存：所有序列共享一个预先分配的页池，序列按需领取页、结束后归还，
+// 长短不一的序列不必各自按最大长度预留空间；解码过程中不会产生堆分配
+// 序列的第 t 个位置位于其页表第 t / pageRows 项所指页的第 t % pageRows 行，每行保存 dim 个 K 与 dim 个 V
+class PagedKVCache {
+		int dim;
+		int pageRows;
+		int pageCount;
+		std::vector<double> keys; // pageCount * pageRows * dim
+		std::vector<double> values;
+		std::vector<int> freePages;
+		std::vector<std::vector<int>> pageTables; // 每个序列的页表
+		std::vector<int> lengths;
+		std::vector<bool> active;
+		
+		size_t rowOffset(int id, int position) const {
+			int page = pageTables[id][position / pageRows];
+			return (static_cast<size_t>(page) * pageRows + position % pageRows) * dim;
+		}
+		
+		void check(int id) const {
+			if (id < 0 || id >= static_cast<int>(active.size()) || !active[id]) {
+				throw std::invalid_argument("Unknown KV cache sequence.");
+			}
+		}
+		
+	public:
+		PagedKVCache(int dim, int pageCount, int pageRows = KV_CACHE_PAGE_ROWS)
+			: dim(dim), pageRows(pageRows), pageCount(pageCount) {
+			if (dim <= 0 || pageCount <= 0 || pageRows <= 0) {
+				throw std::invalid_argument("Invalid KV cache configuration.");
+			}
+			
+			keys.assign(static_cast<size_t>(pageCount) * pageRows * dim, 0.0);
+			values.assign(static_cast<size_t>(pageCount) * pageRows * dim, 0.0);
+			freePages.reserve(pageCount);
+			
+			// 倒序入栈，使页按编号从小到大分配
+			for (int page = pageCount - 1; page >= 0; --page) {
+				freePages.push_back(page);
+			}
+		}
+		
+		~PagedKVCache() {}
+		
+		// 登记一个新序列并返回其编号，优先复用已结束序列的编号
+		int addSequence() {
+			for (size_t id = 0; id < active.size(); ++id) {
+				if (!active[id]) {
+					active[id] = true;
+					lengths[id] = 0;
+					return static_cast<int>(id);
+				}
+			}
+			
+			pageTables.push_back(std::vector<int>());
+			lengths.push_back(0);
+			active.push_back(true);
+			return static_cast<int>(active.size()) - 1;
+		}
+		
+		// 结束序列并把它占用的页归还页池
+		void removeSequence(int id) {
+			check(id);
+			
+			for (int page : pageTables[id]) {
+				freePages.push_back(page);
+			}
+			
+			pageTables[id].clear();
+			lengths[id] = 0;
+			active[id] = false;
+		}
+		
+		// 为序列追加一个位置并返回该位置的下标；当前页写满时从页池领取新页
+		int extend(int id) {
+			check(id);
+			int position = lengths[id];
+			
+			if (position % pageRows == 0) {
+				if (freePages.empty()) {
+					throw std::runtime_error("KV cache exhausted: no free pages left.");
+				}
+				
+				pageTables[id].push_back(freePages.back());
+				freePages.pop_back();
+			}
+			
+			++lengths[id];
+			return position;
+		}
+		
+		double* key(int id, int position) {
+			return keys.data() + rowOffset(id, position);
+		}
+		
+		double* value(int id, int position) {
+			return values.data() + rowOffset(id, position);
+		}
+		
+		// 序列第 page 页的起始地址，页内各行连续存放（行间距为 dim）
+		const double* keyPage(int id, int page) const {
+			return keys.data() + static_cast<size_t>(pageTables[id][page]) * pageRows * dim;
+		}
+		
+		const double* valuePage(int id, int page) const {
+			return values.data() + static_cast<size_t>(pageTables[id][page]) * pageRows * dim;
+		}
+		
+		int getLength(int id) const {
+			return lengths[id];
+		}
+		
+		// 序列再追加一个位置需要从页池领取的页数（0 或 1）
+		int pagesToExtend(int id) const {
+			check(id);
+			return lengths[id] % pageRows == 0 ? 1 : 0;
+		}
+		
+		// 当前登记中的序列数
+		int getSequenceCount() const {
+			return static_cast<int>(std::count(active.begin(), active.end(), true));
+		}
+		
+		int getPageRows() const {
+			return pageRows;
+		}
+		
+		int getDim() const {
+			return dim;
+		}
+		
+		int getFreePages() const {
+			return static_cast<int>(freePages.size());
+		}
+		
+		int getPageCount() const {
+			return pageCount;
+		}
+};
+
+// 单个查询行对某个序列全部缓存位置的注意力（全部头），结果写入 out（dim 个 double）
+// 逐页计算分数并用在线 softmax 合并，work 至少需要 pageRows 个 double
+inline void pagedAttentionRow(const AttentionView& w, const PagedKVCache& cache, int id, const double* q, double* out, double* work) {
+	int headDim = w.dim / w.heads;
+	double scale = 1.0 / std::sqrt(headDim);
+	int length = cache.getLength(id);
+	int pageRows = cache.getPageRows();
+	std::fill(out, out + w.dim, 0.0);
+	
+	for (int h = 0; h < w.heads; ++h) {
+		const double* qh = q + h * headDim;
+		double* oh = out + h * headDim;
+		double rowMax = -std::numeric_limits<double>::infinity();
+		double rowSum = 0.0;
+		
+		for (int page = 0; page * pageRows < length; ++page) {
+			int rows = std::min(pageRows, length - page * pageRows);
+			const double* K = cache.keyPage(id, page) + h * headDim;
+			const double* V = cache.valuePage(id, page) + h * headDim;
+			double blockMax = -std::numeric_limits<double>::infinity();
+			
+			for (int r = 0; r < rows; ++r) {
+				work[r] = dot(qh, K + static_cast<size_t>(r) * w.dim, headDim) * scale;
+				blockMax = std::max(blockMax, work[r]);
+			}
+			
+			double newMax = std::max(rowMax, blockMax);
+			double correction = fastExp(rowMax - newMax);
+			rowSum *= correction;
+			
+			for (int d = 0; d < headDim; ++d) {
+				oh[d] *= correction;
+			}
+			
+			for (int r = 0; r < rows; ++r) {
+				work[r] -= newMax;
+			}
+			
+			applyElementwise<ExpActivation>(work, rows);
+			
+			for (int r = 0; r < rows; ++r) {
+				rowSum += work[r];
+				axpy(oh, V + static_cast<size_t>(r) * w.dim, work[r], headDim);
+			}
+			
+			rowMax = newMax;
+		}
+		
+		double inverse = 1.0 / rowSum;
+		
+		for (int d = 0; d < headDim; ++d) {
+			oh[d] *= inverse;
+		}
+	}
+}
+
+// Transformer 的增量解码会话：每个序列先用 begin 运行一次编码器并缓存交叉注意力的 K/V，
+// 之后每次 step 只输入一个新位置，自注意力的 K/V 追加到分页缓存中，因此每个新位置只需计算一行注意力
+// step 可以一次推进多个序列（批量解码），结果与对完整前缀调用 Transformer::inference 的最后一行一致
+class TransformerDecodingSession {
+		EncoderView encoder;
+		DecoderView decoder;
+		PositionalView positional;
+		int dim;
+		int maxSequences;
+		int maxEncoderLength;
+		PagedKVCache selfCache; // 解码器自注意力的 K/V
+		PagedKVCache crossCache; // 交叉注意力的 K/V（由编码器输出计算，整个序列期间不变）
+		ActivationArena arena;
+		
+		static int pagesFor(int length, int pageRows) {
+			return (length + pageRows - 1) / pageRows;
+		}
+		
+		void plan() {
+			size_t encoder = 2 * ActivationArena::footprint(static_cast<size_t>(maxEncoderLength) * dim)
+			                 + encoderWorkspace(maxEncoderLength, dim, this->encoder.attention.heads);
+			size_t matrix = ActivationArena::footprint(static_cast<size_t>(maxSequences) * dim);
+			size_t decoder = 7 * matrix + static_cast<size_t>(maxSequences) * ActivationArena::footprint(selfCache.getPageRows()) + feedForwardWorkspace(dim);
+			arena.reserve(std::max(encoder, decoder));
+		}
+		
+		// 对 batch 个查询行分别计算注意力，计算量足够大时按行并行
+		void attendRows(const AttentionView& w, PagedKVCache& cache, const int* ids, int batch, const double* Q, double* heads, double* work) {
+			int pageRows = cache.getPageRows();
+			auto row = [&](int b) {
+				pagedAttentionRow(w, cache, ids[b], Q + static_cast<size_t>(b) * dim, heads + static_cast<size_t>(b) * dim,
+				                  work + b * ActivationArena::footprint(pageRows));
+			};
+			double total = 0.0;
+			
+			for (int b = 0; b < batch; ++b) {
+				total += static_cast<double>(cache.getLength(ids[b])) * dim;
+			}
+			
+			if (batch > 1 && total >= ATTENTION_PARALLEL_THRESHOLD) {
+				parallelFor(batch, row);
+			}
+			else {
+				for (int b = 0; b < batch; ++b) {
+					row(b);
+				}
+			}
+		}
+		
+	public:
+		// maxSequences 为同时解码的序列数上限，maxEncoderLength 与 maxDecodeLength 为每个序列的长度上限
+		// 页池按上限一次性分配；pageRows 为每页的位置数
+		TransformerDecodingSession(const Transformer& model, int maxSequences, int maxEncoderLength, int maxDecodeLength, int pageRows = KV_CACHE_PAGE_ROWS)
+			: encoder(model.getEncoder().getView()), decoder(model.getDecoder().getView()), positional(model.getPositional()), dim(model.getInputDim()),
+			  maxSequences(maxSequences), maxEncoderLength(maxEncoderLength),
+			  selfCache(dim, maxSequences * pagesFor(maxDecodeLength, pageRows), pageRows),
+			  crossCache(dim, maxSequences * pagesFor(maxEncoderLength, pageRows), pageRows) {
+			plan();
+		}
+		
+		// 从外部权重视图构造，权重不做拷贝
+		TransformerDecodingSession(const EncoderView& encoder, const DecoderView& decoder, const PositionalView& positional, int maxSequences,
+		                           int maxEncoderLength, int maxDecodeLength, int pageRows = KV_CACHE_PAGE_ROWS)
+			: encoder(encoder), decoder(decoder), positional(positional), dim(encoder.attention.dim), maxSequences(maxSequences), maxEncoderLength(maxEncoderLength),
+			  selfCache(dim, maxSequences * pagesFor(maxDecodeLength, pageRows), pageRows),
+			  crossCache(dim, maxSequences * pagesFor(maxEncoderLength, pageRows), pageRows) {
+			plan();
+		}
+		
+		~TransformerDecodingSession() {}
+		
+		// 开始一个序列：运行编码器并缓存交叉注意力的 K/V，返回序列编号
+		// 先检查序列数与页池容量再登记；编码过程中抛出异常时撤销登记，不会留下无法 end 的序列
+		int begin(const double* encoderInput, int encoderLength) {
+			if (encoderLength <= 0 || encoderLength > maxEncoderLength) {
+				throw std::invalid_argument("Encoder length exceeds the planned maximum.");
+			}
+			
+			if (selfCache.getSequenceCount() >= maxSequences) {
+				throw std::runtime_error("Decoding session already holds the planned maximum number of sequences.");
+			}
+			
+			if (crossCache.getFreePages() < pagesFor(encoderLength, crossCache.getPageRows())) {
+				throw std::runtime_error("KV cache exhausted: no free pages left.");
+			}
+			
+			int id = selfCache.addSequence();
+			
+			if (crossCache.addSequence() != id) {
+				throw std::logic_error("KV cache sequence tables are out of sync.");
+			}
+			
+			try {
+				arena.reset();
+				size_t size = static_cast<size_t>(encoderLength) * dim;
+				double* encoderEmbedded = arena.allocate(size);
+				double* encoderOutput = arena.allocate(size);
+				std::copy(encoderInput, encoderInput + size, encoderEmbedded);
+				addPositionalEncoding(positional, encoderEmbedded, singleSequence(encoderLength), dim);
+				encoderLayerForward(encoder, encoderEmbedded, encoderLength, encoderOutput, arena);
+				const AttentionView& w = decoder.crossAttention;
+				
+				for (int t = 0; t < encoderLength; ++t) {
+					int position = crossCache.extend(id);
+					double* k = crossCache.key(id, position);
+					double* v = crossCache.value(id, position);
+					std::fill(k, k + dim, 0.0);
+					std::fill(v, v + dim, 0.0);
+					gemm(encoderOutput + static_cast<size_t>(t) * dim, w.Wk, k, 1, dim, dim);
+					gemm(encoderOutput + static_cast<size_t>(t) * dim, w.Wv, v, 1, dim, dim);
+				}
+			}
+			catch (...) {
+				end(id);
+				throw;
+			}
+			
+			return id;
+		}
+		
+		// 结束序列并归还它占用的缓存页
+		void end(int id) {
+			selfCache.removeSequence(id);
+			crossCache.removeSequence(id);
+		}
+		
+		// 批量解码一步：第 b 个序列 ids[b] 输入 tokens 的第 b 行（batch x dim），对应的输出写入 outputs 的第 b 行
+		// 同一批中的序列编号不能重复；追加任何位置之前先确认页池能容纳整批，失败时各序列的缓存保持不变
+		void step(const int* ids, int batch, const double* tokens, double* outputs) {
+			if (batch <= 0 || batch > maxSequences) {
+				throw std::invalid_argument("Batch size exceeds the planned maximum.");
+			}
+			
+			int pages = 0;
+			
+			for (int b = 0; b < batch; ++b) {
+				pages += selfCache.pagesToExtend(ids[b]);
+			}
+			
+			if (pages > selfCache.getFreePages()) {
+				throw std::runtime_error("KV cache exhausted: no free pages left.");
+			}
+			
+			arena.reset();
+			size_t n = static_cast<size_t>(batch) * dim;
+			double* embedded = arena.allocate(n);
+			double* normalized = arena.allocate(n);
+			double* Q = arena.allocate(n);
+			double* heads = arena.allocate(n);
+			double* attention = arena.allocate(n);
+			double* residual1 = arena.allocate(n);
+			double* residual2 = arena.allocate(n);
+			double* work = arena.allocate(static_cast<size_t>(batch) * ActivationArena::footprint(selfCache.getPageRows()));
+			std::copy(tokens, tokens + n, embedded);
+			
+			// 新位置的编号就是序列已解码的位置数
+			for (int b = 0; b < batch; ++b) {
+				addPositionalEncoding(positional, embedded + static_cast<size_t>(b) * dim, singleSequence(1), dim, selfCache.getLength(ids[b]));
+			}
+			
+			// 因果自注意力：先把新位置的 K/V 追加到缓存，再对缓存中的全部位置做一行注意力
+			const AttentionView& self = decoder.selfAttention;
+			layerNorm(decoder.norm1, embedded, batch, dim, normalized, nullptr);
+			
+			for (int b = 0; b < batch; ++b) {
+				const double* x = normalized + static_cast<size_t>(b) * dim;
+				int position = selfCache.extend(ids[b]);
+				double* k = selfCache.key(ids[b], position);
+				double* v = selfCache.value(ids[b], position);
+				std::fill(k, k + dim, 0.0);
+				std::fill(v, v + dim, 0.0);
+				gemm(x, self.Wk, k, 1, dim, dim);
+				gemm(x, self.Wv, v, 1, dim, dim);
+			}
+			
+			std::fill(Q, Q + n, 0.0);
+			gemm(normalized, self.Wq, Q, batch, dim, dim);
+			attendRows(self, selfCache, ids, batch, Q, heads, work);
+			std::fill(attention, attention + n, 0.0);
+			gemm(heads, self.Wo, attention, batch, dim, dim);
+			residualLayerNorm(decoder.norm2, embedded, attention, batch, dim, residual1, normalized, nullptr);
+			// 交叉注意力：键/值来自 begin 时缓存的编码器输出
+			const AttentionView& cross = decoder.crossAttention;
+			std::fill(Q, Q + n, 0.0);
+			gemm(normalized, cross.Wq, Q, batch, dim, dim);
+			attendRows(cross, crossCache, ids, batch, Q, heads, work);
+			std::fill(attention, attention + n, 0.0);
+			gemm(heads, cross.Wo, attention, batch, dim, dim);
+			residualLayerNorm(decoder.norm3, residual1, attention, batch, dim, residual2, normalized, nullptr);
+			feedForwardResidual(decoder.Wff1, decoder.Wff2, dim, normalized, residual2, batch, outputs, nullptr, arena);
+		}
+		
+		// 单个序列解码一步，token 与返回值均为 1 x dim
+		MatrixXd step(int id, const MatrixXd& token) {
+			MatrixXd output(1, dim);
+			step(&id, 1, token.data(), output.data());
+			return output;
+		}
+		
+		// 序列已解码的位置数
+		int getLength(int id) const {
+			return selfCache.getLength(id);
+		}
+		
+		const PagedKVCache& getSelfCache() const {
+			return selfCache;
+		}
+		
+		const PagedKVCache& getCrossCache() const {
+			return crossCache;
+		}
+};
@@ -0,0 +1,166 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include "./Precision.h"
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+// 基础计算核：只处理连续内存，内层循环无分支，便于编译器自动向量化
+// 前向与反向传播共用这些计算核，保证训练开销与推理开销成比例
+// T 为计算类型（double 或 float）；W 为只读操作数（通常是权重）的存储类型，可以与 T 相同，
+// 也可以是 bfloat16 等更窄的格式，读入时再转换为 T，从而减少内存带宽
+
+// 使标量参数不参与模板推导，double 字面量可以直接传给 float 计算核
+template<class T>
+struct KernelScalar {
+	using type = T;
+};
+
+// float 计算核可以直接读取的存储格式
+template<class T, class W>
+struct PackedOperand {
+	static constexpr bool value = std::is_same<T, float>::value && (std::is_same<W, float>::value || std::is_same<W, bfloat16>::value);
+};
+
+#ifdef __AVX2__
+// 读入 8 个元素并转换为 float；bfloat16 零扩展后左移 16 位即为对应的 float
+inline __m256 loadPacked(const float* x) {
+	return _mm256_loadu_ps(x);
+}
+
+inline __m256 loadPacked(const bfloat16* x) {
+	__m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+	return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(half), 16));
+}
+
+inline double horizontalSum(__m256d x) {
+	__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+inline float horizontalSum(__m256 x) {
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	return _mm_cvtss_f32(_mm_add_ss(sum, _mm_movehdup_ps(sum)));
+}
+#endif
+
+// y[i] += a * x[i]
+// AVX2 可用时 double 每次处理 4 个元素，float 每次处理 8 个元素（同样的指令数完成两倍的运算）
+template<class T, class W>
+inline void axpy(T* y, const W* x, typename KernelScalar<T>::type a, int n) {
+	int i = 0;
+	#ifdef __AVX2__
+	
+	if constexpr (std::is_same<T, double>::value && std::is_same<W, double>::value) {
+		__m256d va = _mm256_set1_pd(a);
+		
+		for (; i + 4 <= n; i += 4) {
+			_mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(va, _mm256_loadu_pd(x + i))));
+		}
+	}
+	else if constexpr (PackedOperand<T, W>::value) {
+		__m256 va = _mm256_set1_ps(a);
+		
+		for (; i + 8 <= n; i += 8) {
+			_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(va, loadPacked(x + i))));
+		}
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		y[i] += a * static_cast<T>(x[i]);
+	}
+}
+
+// 返回 sum(x[i] * y[i])
+template<class T, class W>
+inline T dot(const T* x, const W* y, int n) {
+	T sum = T(0);
+	int i = 0;
+	#ifdef __AVX2__
+	
+	if constexpr (std::is_same<T, double>::value && std::is_same<W, double>::value) {
+		__m256d acc = _mm256_setzero_pd();
+		
+		for (; i + 4 <= n; i += 4) {
+			acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		}
+		
+		sum = horizontalSum(acc);
+	}
+	else if constexpr (PackedOperand<T, W>::value) {
+		__m256 acc = _mm256_setzero_ps();
+		
+		for (; i + 8 <= n; i += 8) {
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + i), loadPacked(y + i)));
+		}
+		
+		sum = horizontalSum(acc);
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		sum += x[i] * static_cast<T>(y[i]);
+	}
+	
+	return sum;
+}
+
+// C(M x N) += A(M x K) * B(K x N)，行主序；按 i-k-j 顺序遍历，内层为连续的 axpy
+template<class T, class W>
+inline void gemm(const T* A, const W* B, T* C, int M, int N, int K) {
+	for (int i = 0; i < M; ++i) {
+		for (int k = 0; k < K; ++k) {
+			axpy(C + static_cast<size_t>(i) * N, B + static_cast<size_t>(k) * N, A[static_cast<size_t>(i) * K + k], N);
+		}
+	}
+}
+
+// C(M x N) += A(K x M)^T * B(K x N)，行主序；用于 X^T * dY 形式的权重梯度
+template<class T>
+inline void gemmTransA(const T* A, const T* B, T* C, int M, int N, int K) {
+	for (int k = 0; k < K; ++k) {
+		for (int i = 0; i < M; ++i) {
+			axpy(C + static_cast<size_t>(i) * N, B + static_cast<size_t>(k) * N, A[static_cast<size_t>(k) * M + i], N);
+		}
+	}
+}
+
+// C(M x N) += A(M x K) * B(N x K)^T，行主序；用于 Q * K^T 之类无需显式转置的乘法
+template<class T, class W>
+inline void gemmTransB(const T* A, const W* B, T* C, int M, int N, int K) {
+	for (int i = 0; i < M; ++i) {
+		for (int j = 0; j < N; ++j) {
+			C[static_cast<size_t>(i) * N + j] += dot(A + static_cast<size_t>(i) * K, B + static_cast<size_t>(j) * K, K);
+		}
+	}
+}
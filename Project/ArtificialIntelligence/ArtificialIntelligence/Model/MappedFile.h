@@ -0,0 +1,164 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// 文件访问模式提示，供操作系统调整预读策略
+enum class FileAccess {
+	Normal = 0,
+	Sequential = 1, // 顺序读取，加大预读
+	Random = 2 // 随机读取（如打乱顺序的数据集），关闭预读
+};
+
+// 只读映射的文件；多个进程映射同一文件时共享页缓存
+// 映射中的地址在对象销毁前一直有效，数据按需从磁盘调入，不占用进程的堆内存
+class MappedFile {
+		const char* base;
+		size_t size;
+		#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+		#else
+		int fd;
+		#endif
+		
+		void unmap() {
+			#ifdef _WIN32
+			
+			if (base != nullptr) {
+				UnmapViewOfFile(base);
+			}
+			
+			if (mapping != nullptr) {
+				CloseHandle(mapping);
+			}
+			
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+			}
+			
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+			#else
+			
+			if (base != nullptr) {
+				munmap(const_cast<char*>(base), size);
+			}
+			
+			if (fd != -1) {
+				close(fd);
+			}
+			
+			fd = -1;
+			#endif
+			base = nullptr;
+			size = 0;
+		}
+		
+	public:
+		MappedFile(const std::string& path) : base(nullptr), size(0),
+			#ifdef _WIN32
+			file(INVALID_HANDLE_VALUE), mapping(nullptr)
+			#else
+			fd(-1)
+			#endif
+		{
+			#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			
+			if (file == INVALID_HANDLE_VALUE) {
+				throw std::runtime_error("Failed to open file: " + path);
+			}
+			
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+			size = static_cast<size_t>(fileSize.QuadPart);
+			mapping = size == 0 ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			
+			if (mapping == nullptr) {
+				unmap();
+				throw std::runtime_error("Failed to map file: " + path);
+			}
+			
+			base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			#else
+			fd = open(path.c_str(), O_RDONLY);
+			
+			if (fd == -1) {
+				throw std::runtime_error("Failed to open file: " + path);
+			}
+			
+			struct stat info;
+			fstat(fd, &info);
+			size = static_cast<size_t>(info.st_size);
+			void* address = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			base = address == MAP_FAILED ? nullptr : static_cast<const char*>(address);
+			#endif
+			
+			if (base == nullptr) {
+				unmap();
+				throw std::runtime_error("Failed to map file: " + path);
+			}
+		}
+		
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		
+		~MappedFile() {
+			unmap();
+		}
+		
+		const char* data() const {
+			return base;
+		}
+		
+		size_t getSize() const {
+			return size;
+		}
+		
+		// 提示接下来的访问模式；只是建议，不支持的平台上忽略
+		void advise(FileAccess access) const {
+			#ifndef _WIN32
+			int advice = access == FileAccess::Sequential ? MADV_SEQUENTIAL : access == FileAccess::Random ? MADV_RANDOM : MADV_NORMAL;
+			madvise(const_cast<char*>(base), size, advice);
+			#else
+			(void)access;
+			#endif
+		}
+};
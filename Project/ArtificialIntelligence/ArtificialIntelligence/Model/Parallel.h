@@ -0,0 +1,182 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+inline int computeThreadCount() {
+	return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// 当前线程是否在执行 parallelFor 的某一项；此时嵌套的 parallelFor 直接串行执行，避免互相等待造成死锁
+inline bool& insideComputeWorker() {
+	thread_local bool inside = false;
+	return inside;
+}
+
+// 人工智能模块共享的计算线程组（与 Server 的连接处理线程池相互独立）：工作线程常驻，
+// 任务槽只有一个且预先存在，发布任务只写入函数指针、上下文指针与项数，各线程用原子计数领取下标，
+// 因此每次 parallelFor 都不产生堆分配。同一时刻只执行一个任务，其他线程发起的任务由发起者串行执行
+class ComputeTeam {
+	private:
+		std::vector<std::thread> workers;
+		std::mutex dispatch; // 持有者为当前任务的发起者
+		std::mutex mutex; // 保护以下任务槽
+		std::condition_variable wake;
+		std::condition_variable finished;
+		void (*invoke)(void*, int) = nullptr;
+		void* context = nullptr;
+		int count = 0;
+		std::atomic<int> next{0};
+		size_t active = 0; // 尚未完成当前任务的工作线程数
+		unsigned long long generation = 0;
+		std::exception_ptr error;
+		bool stopping = false;
+		
+		// 领取并执行剩余的项，记录第一个异常
+		void drain() {
+			for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+				try {
+					invoke(context, i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+			}
+		}
+		
+		void loop() {
+			insideComputeWorker() = true;
+			unsigned long long seen = 0;
+			std::unique_lock<std::mutex> lock(mutex);
+			
+			while (true) {
+				wake.wait(lock, [this, &seen] { return stopping || generation != seen; });
+				
+				if (stopping) {
+					return;
+				}
+				
+				seen = generation;
+				lock.unlock();
+				drain();
+				lock.lock();
+				
+				if (--active == 0) {
+					finished.notify_one();
+				}
+			}
+		}
+		
+	public:
+		explicit ComputeTeam(int threads) {
+			for (int i = 1; i < threads; ++i) {
+				workers.emplace_back([this] {
+					loop();
+				});
+			}
+		}
+		
+		ComputeTeam(const ComputeTeam&) = delete;
+		ComputeTeam& operator=(const ComputeTeam&) = delete;
+		
+		~ComputeTeam() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			
+			wake.notify_all();
+			
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+		}
+		
+		// 发起者与全部工作线程一起执行 function(0) ... function(count - 1)；线程组正被占用时返回 false，不执行任何一项
+		template<class Function>
+		bool run(int count, Function& function) {
+			std::unique_lock<std::mutex> owner(dispatch, std::try_to_lock);
+			
+			if (!owner.owns_lock()) {
+				return false;
+			}
+			
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				invoke = [](void* target, int i) {
+					(*static_cast<Function*>(target))(i);
+				};
+				context = &function;
+				this->count = count;
+				next.store(0);
+				active = workers.size();
+				++generation;
+			}
+			
+			wake.notify_all();
+			insideComputeWorker() = true;
+			drain();
+			insideComputeWorker() = false;
+			
+			std::exception_ptr failure;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				finished.wait(lock, [this] { return active == 0; });
+				std::swap(failure, error);
+			}
+			
+			if (failure) {
+				std::rethrow_exception(failure);
+			}
+			
+			return true;
+		}
+};
+
+inline ComputeTeam& computeTeam() {
+	static ComputeTeam team(computeThreadCount());
+	return team;
+}
+
+// 并行执行 function(0) ... function(count - 1)，各项按原子计数动态分配给发起线程与计算线程组
+// 各项之间不能有数据竞争；任何一项抛出的异常会在全部完成后重新抛出；调用本身不产生堆分配
+template<class Function>
+inline void parallelFor(int count, Function function) {
+	if (count <= 1 || computeThreadCount() <= 1 || insideComputeWorker() || !computeTeam().run(count, function)) {
+		for (int i = 0; i < count; ++i) {
+			function(i);
+		}
+	}
+}
@@ -0,0 +1,391 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include "./Profiler.h"
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+// 混合精度训练：double 主权重 + 低精度工作副本 + 损失缩放
+// 前向与反向在 float 上计算（SIMD 宽度是 double 的两倍、内存流量减半），权重工作副本可以进一步以 bfloat16 存储；
+// 梯度以 float 累积，乘以损失缩放系数的倒数后更新 double 主权重，再刷新工作副本，避免小的更新量在低精度中被舍入掉
+// 激活与激活带始终为 float：bfloat16 只是存储格式，没有算术，核函数按 T 读写保存的中间结果，因此只有权重副本提供 bfloat16 存储
+
+// 训练精度
+enum class Precision {
+	Float64 = 0, // 全部使用 double（默认）
+	Float32 = 1, // float 计算，float 工作副本
+	BFloat16 = 2 // float 计算，bfloat16 权重工作副本（激活仍为 float）
+};
+
+// bfloat16：float 的高 16 位（8 位指数、7 位尾数），数值范围与 float 相同，只降低尾数精度
+struct bfloat16 {
+	uint16_t bits;
+	
+	bfloat16() : bits(0) {}
+	
+	// 从 float 就近舍入（偶数优先）；NaN 保持为 NaN
+	explicit bfloat16(float value) {
+		uint32_t word;
+		std::memcpy(&word, &value, sizeof(word));
+		
+		if ((word & 0x7fffffffu) > 0x7f800000u) {
+			bits = static_cast<uint16_t>((word >> 16) | 0x40u);
+			return;
+		}
+		
+		word += 0x7fffu + ((word >> 16) & 1u);
+		bits = static_cast<uint16_t>(word >> 16);
+	}
+	
+	operator float() const {
+		uint32_t word = static_cast<uint32_t>(bits) << 16;
+		float value;
+		std::memcpy(&value, &word, sizeof(value));
+		return value;
+	}
+};
+
+// 把 double 数据收窄为工作精度（float 或 bfloat16）
+inline void narrowCopy(const double* source, float* destination, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		destination[i] = static_cast<float>(source[i]);
+	}
+}
+
+// AVX2 可用时每次转换 8 个元素，舍入规则与 bfloat16(float) 相同
+inline void narrowCopy(const double* source, bfloat16* destination, size_t n) {
+	size_t i = 0;
+	#ifdef __AVX2__
+	const __m256i roundingBias = _mm256_set1_epi32(0x7fff);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+	const __m256i infinity = _mm256_set1_epi32(0x7f800000);
+	const __m256i quietBit = _mm256_set1_epi32(0x40);
+	
+	for (; i + 8 <= n; i += 8) {
+		__m128 low = _mm256_cvtpd_ps(_mm256_loadu_pd(source + i));
+		__m128 high = _mm256_cvtpd_ps(_mm256_loadu_pd(source + i + 4));
+		__m256i word = _mm256_castps_si256(_mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1));
+		__m256i upper = _mm256_srli_epi32(word, 16);
+		__m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(word, _mm256_add_epi32(roundingBias, _mm256_and_si256(upper, one))), 16);
+		__m256i isNaN = _mm256_cmpgt_epi32(_mm256_and_si256(word, magnitude), infinity);
+		rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(upper, quietBit), isNaN);
+		// 两个 128 位半区各自打包，再把两半的低 64 位拼到一起
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rounded, rounded), 0xd8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm256_castsi256_si128(packed));
+	}
+	
+	#endif
+	
+	for (; i < n; ++i) {
+		destination[i] = bfloat16(static_cast<float>(source[i]));
+	}
+}
+
+// 缓冲区中的值是否全部有限（损失缩放据此判断本步是否溢出）
+// 指数位全为 1 的是 inf 或 NaN；按位判断，循环中没有浮点加法的依赖链，可以向量化
+template<class T>
+inline bool allFinite(const T* x, size_t n) {
+	using Bits = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+	const Bits exponent = sizeof(T) == 4 ? Bits(0x7f800000u) : Bits(0x7ff0000000000000ull);
+	Bits found = 0;
+	
+	for (size_t i = 0; i < n; ++i) {
+		Bits bits;
+		std::memcpy(&bits, x + i, sizeof(bits));
+		found |= (bits & exponent) == exponent;
+	}
+	
+	return found == 0;
+}
+
+// 带裁剪的梯度下降：gradient 先乘以 scale，整体范数超过 maxNorm（maxNorm > 0 时）时按比例缩小，再更新 weights
+template<class T>
+inline void applyClippedGradient(double* weights, const T* gradient, size_t n, double scale, double learningRate, double maxNorm) {
+	double norm = 0.0;
+	
+	if (maxNorm > 0.0) {
+		for (size_t i = 0; i < n; ++i) {
+			double g = gradient[i] * scale;
+			norm += g * g;
+		}
+		
+		norm = std::sqrt(norm);
+		
+		if (norm > maxNorm) {
+			scale *= maxNorm / norm;
+		}
+	}
+	
+	double step = learningRate * scale;
+	
+	for (size_t i = 0; i < n; ++i) {
+		weights[i] -= step * gradient[i];
+	}
+}
+
+#define LOSS_SCALE_MAX 16777216.0 // 2^24，再大时 float 梯度的有效位开始被浪费
+
+// 混合精度的训练设置
+struct PrecisionPolicy {
+	Precision precision;
+	bool lossScaling; // 是否启用动态损失缩放
+	double initialLossScale;
+	int growthInterval; // 连续多少步没有溢出后把缩放系数加倍
+};
+
+// 默认的 double 训练
+inline PrecisionPolicy doublePrecision() {
+	return PrecisionPolicy{Precision::Float64, false, 1.0, 0};
+}
+
+// float 计算的混合精度训练，storage 为 Float32 或 BFloat16
+inline PrecisionPolicy mixedPrecision(Precision storage = Precision::BFloat16, bool lossScaling = true) {
+	return PrecisionPolicy{storage, lossScaling, 65536.0, 1000};
+}
+
+// 动态损失缩放：损失（即输出梯度）乘以 scale 后反向传播，防止小梯度在低精度中下溢
+// 出现 inf/NaN 时跳过本步更新并把 scale 减半；连续 growthInterval 步正常后把 scale 加倍
+class LossScaler {
+		bool enabled;
+		double scale;
+		int growthInterval;
+		int goodSteps;
+		size_t skippedSteps;
+		
+	public:
+		LossScaler(const PrecisionPolicy& policy = doublePrecision())
+			: enabled(policy.lossScaling), scale(policy.lossScaling ? policy.initialLossScale : 1.0), growthInterval(policy.growthInterval),
+			  goodSteps(0), skippedSteps(0) {}
+			  
+		double getScale() const {
+			return scale;
+		}
+		
+		size_t getSkippedSteps() const {
+			return skippedSteps;
+		}
+		
+		// 根据本步梯度是否全部有限调整缩放系数，返回本步的更新是否应当应用
+		bool update(bool finite) {
+			if (!finite) {
+				++skippedSteps;
+				goodSteps = 0;
+				
+				if (enabled) {
+					scale = std::max(scale * 0.5, 1.0);
+				}
+				
+				return false;
+			}
+			
+			if (enabled && growthInterval > 0 && ++goodSteps >= growthInterval) {
+				scale = std::min(scale * 2.0, LOSS_SCALE_MAX);
+				goodSteps = 0;
+			}
+			
+			return true;
+		}
+};
+
+// 模型的全部可训练参数在混合精度下的状态：登记 double 主权重的位置，维护低精度工作副本与 float 梯度
+// 连续登记的张量在工作副本与梯度中首尾相接，因此可以把逐节点存放的权重拼成一整块矩阵供计算核使用
+// 主权重只以指针登记，拷贝时不复制登记信息（副本需要重新登记自己的权重）
+class MixedPrecisionParameters {
+		struct Tensor {
+			double* master;
+			size_t offset;
+			size_t count;
+		};
+		
+		struct Group {
+			size_t first; // 第一个张量的下标
+			size_t last; // 最后一个张量之后的下标
+			double maxNorm;
+		};
+		
+		std::vector<Tensor> tensors;
+		std::vector<Group> groups;
+		size_t total;
+		Precision precision;
+		std::vector<float> floatWorking;
+		std::vector<bfloat16> bfloatWorking;
+		std::vector<float> gradients;
+		
+	public:
+		MixedPrecisionParameters() : total(0), precision(Precision::Float32) {}
+		
+		MixedPrecisionParameters(const MixedPrecisionParameters&) : total(0), precision(Precision::Float32) {}
+		
+		MixedPrecisionParameters& operator=(const MixedPrecisionParameters& other) {
+			if (this != &other) {
+				clear();
+			}
+			
+			return *this;
+		}
+		
+		~MixedPrecisionParameters() {}
+		
+		void clear() {
+			tensors.clear();
+			groups.clear();
+			total = 0;
+			std::vector<float>().swap(floatWorking);
+			std::vector<bfloat16>().swap(bfloatWorking);
+			std::vector<float>().swap(gradients);
+		}
+		
+		bool empty() const {
+			return tensors.empty();
+		}
+		
+		// 开始一个新的梯度裁剪组（maxNorm <= 0 表示不裁剪），之后登记的张量都属于该组
+		void beginGroup(double maxNorm) {
+			groups.push_back(Group{tensors.size(), tensors.size(), maxNorm});
+		}
+		
+		// 登记一块主权重，返回它在工作副本与梯度中的偏移
+		size_t add(double* master, size_t count) {
+			if (groups.empty()) {
+				beginGroup(0.0);
+			}
+			
+			tensors.push_back(Tensor{master, total, count});
+			groups.back().last = tensors.size();
+			total += count;
+			return total - count;
+		}
+		
+		// 登记完成后按工作精度分配工作副本与梯度，并从主权重刷新
+		void allocate(Precision workingPrecision) {
+			if (workingPrecision == Precision::Float64) {
+				throw std::invalid_argument("Mixed precision parameters need a low-precision working format.");
+			}
+			
+			precision = workingPrecision;
+			floatWorking.assign(precision == Precision::Float32 ? total : 0, 0.0f);
+			bfloatWorking.assign(precision == Precision::BFloat16 ? total : 0, bfloat16());
+			gradients.assign(total, 0.0f);
+			PROFILE_ALLOCATION(total * (sizeof(float) + (precision == Precision::Float32 ? sizeof(float) : sizeof(bfloat16))));
+			refresh();
+		}
+		
+		// 主权重被外部修改后重新生成工作副本
+		void refresh() {
+			for (const Tensor& tensor : tensors) {
+				refresh(tensor);
+			}
+		}
+		
+		Precision getPrecision() const {
+			return precision;
+		}
+		
+		size_t size() const {
+			return total;
+		}
+		
+		// 工作副本，W 须与 allocate 时的精度一致（float 或 bfloat16）
+		template<class W>
+		const W* working() const {
+			if constexpr (std::is_same<W, float>::value) {
+				return floatWorking.data();
+			}
+			else {
+				static_assert(std::is_same<W, bfloat16>::value, "Working weights are float or bfloat16.");
+				return bfloatWorking.data();
+			}
+		}
+		
+		float* gradient() {
+			return gradients.data();
+		}
+		
+		void zeroGradient() {
+			std::fill(gradients.begin(), gradients.end(), 0.0f);
+		}
+		
+		bool finite() const {
+			return allFinite(gradients.data(), gradients.size());
+		}
+		
+		// 梯度乘以 inverseScale（损失缩放系数的倒数）后逐组裁剪、更新主权重，再刷新工作副本
+		void apply(double learningRate, double inverseScale) {
+			PROFILE_SCOPE("MixedPrecisionParameters::apply", ProfilePhase::Update, 0.0);
+			
+			for (const Group& group : groups) {
+				if (group.first == group.last) {
+					continue;
+				}
+				
+				size_t begin = tensors[group.first].offset;
+				size_t end = tensors[group.last - 1].offset + tensors[group.last - 1].count;
+				double scale = inverseScale;
+				
+				// 组内的张量可能分散在多块主权重中，但梯度是连续的，先求整组梯度的范数
+				if (group.maxNorm > 0.0) {
+					double norm = 0.0;
+					
+					for (size_t i = begin; i < end; ++i) {
+						double g = gradients[i] * inverseScale;
+						norm += g * g;
+					}
+					
+					norm = std::sqrt(norm);
+					
+					if (norm > group.maxNorm) {
+						scale *= group.maxNorm / norm;
+					}
+				}
+				
+				// 更新主权重后立即刷新对应的工作副本，趁主权重还在缓存中
+				for (size_t t = group.first; t < group.last; ++t) {
+					applyClippedGradient(tensors[t].master, gradients.data() + tensors[t].offset, tensors[t].count, scale, learningRate, 0.0);
+					refresh(tensors[t]);
+				}
+			}
+		}
+		
+	private:
+		void refresh(const Tensor& tensor) {
+			if (precision == Precision::Float32) {
+				narrowCopy(tensor.master, floatWorking.data() + tensor.offset, tensor.count);
+			}
+			else {
+				narrowCopy(tensor.master, bfloatWorking.data() + tensor.offset, tensor.count);
+			}
+		}
+};
@@ -0,0 +1,396 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 训练性能剖析器
+// 以 MODEL_PROFILING 编译时，各层的前向/反向、参数更新与训练步会记录墙钟时间、浮点运算量与期间分配的字节数，
+// 可导出 Chrome trace（chrome://tracing 或 Perfetto 打开）并打印汇总表
+// 未定义 MODEL_PROFILING 时下面的宏展开为空语句，浮点运算量等参数表达式也不会求值
+// 时间、运算量与字节数都是包含式的：外层作用域（如编码器层）包含其中嵌套的作用域（如注意力）
+
+#define PROFILER_MAX_EVENTS 1048576 // trace 中最多保留的事件数，超出后只计入汇总
+
+enum class ProfilePhase {
+	Forward,
+	Backward,
+	Update, // 参数更新（优化器）
+	Step // 一个完整的训练步
+};
+
+inline const char* profilePhaseName(ProfilePhase phase) {
+	switch (phase) {
+		case ProfilePhase::Forward:
+			return "forward";
+			
+		case ProfilePhase::Backward:
+			return "backward";
+			
+		case ProfilePhase::Update:
+			return "update";
+			
+		default:
+			return "step";
+	}
+}
+
+// 一次作用域的记录，时间以相对剖析器起点的纳秒计
+struct ProfileEvent {
+	const char* name;
+	ProfilePhase phase;
+	int64_t start;
+	int64_t duration;
+	double flops;
+	size_t bytes;
+	size_t step;
+	int thread;
+};
+
+// 按名称与阶段汇总的统计
+struct ProfileSummary {
+	std::string name;
+	ProfilePhase phase;
+	size_t calls;
+	double seconds;
+	double flops;
+	size_t bytes;
+	
+	// 达到的 GFLOP/s，没有运算量估计时为 0
+	double gflops() const {
+		return seconds > 0.0 ? flops / seconds * 1e-9 : 0.0;
+	}
+};
+
+class Profiler {
+		using Clock = std::chrono::steady_clock;
+		
+		struct Total {
+			size_t calls;
+			int64_t duration;
+			double flops;
+			size_t bytes;
+		};
+		
+		Clock::time_point origin;
+		bool enabled;
+		size_t step;
+		size_t dropped; // 因超过 PROFILER_MAX_EVENTS 没有进入 trace 的事件数
+		std::vector<ProfileEvent> events;
+		std::map<std::pair<std::string, ProfilePhase>, Total> totals;
+		mutable std::mutex mutex;
+		
+		Profiler() : origin(Clock::now()), enabled(true), step(0), dropped(0) {}
+		
+		static void writeEscaped(std::ostream& out, const char* text) {
+			for (; *text != '\0'; ++text) {
+				if (*text == '"' || *text == '\\') {
+					out << '\\';
+				}
+				
+				out << *text;
+			}
+		}
+		
+	public:
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+		
+		// 进程内唯一的剖析器
+		static Profiler& instance() {
+			static Profiler profiler;
+			return profiler;
+		}
+		
+		// 当前线程累计分配的字节数，作用域以前后之差作为期间分配的字节数
+		static size_t& allocatedBytes() {
+			thread_local size_t bytes = 0;
+			return bytes;
+		}
+		
+		static void countAllocation(size_t bytes) {
+			allocatedBytes() += bytes;
+		}
+		
+		// 当前线程最外层带运算量作用域累计的浮点运算数，用于得到整个训练步的运算量
+		static double& countedFlops() {
+			thread_local double flops = 0.0;
+			return flops;
+		}
+		
+		// 当前线程正在进行的带运算量作用域的层数，嵌套的作用域不重复计入 countedFlops
+		static int& flopDepth() {
+			thread_local int depth = 0;
+			return depth;
+		}
+		
+		// 当前线程在 trace 中的编号
+		static int threadIndex() {
+			static std::atomic<int> next(0);
+			thread_local int index = next++;
+			return index;
+		}
+		
+		int64_t now() const {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+		}
+		
+		// 运行时开关：关闭后作用域不再记录（编译期关闭见 MODEL_PROFILING）
+		void setEnabled(bool value) {
+			enabled = value;
+		}
+		
+		bool isEnabled() const {
+			return enabled;
+		}
+		
+		// 开始新的训练步，返回其编号（从 1 开始）
+		size_t beginStep() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return ++step;
+		}
+		
+		size_t getStep() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return step;
+		}
+		
+		void record(const ProfileEvent& event) {
+			std::lock_guard<std::mutex> lock(mutex);
+			ProfileEvent stamped = event;
+			stamped.step = step;
+			Total& total = totals[ {event.name, event.phase}];
+			++total.calls;
+			total.duration += event.duration;
+			total.flops += event.flops;
+			total.bytes += event.bytes;
+			
+			if (events.size() < PROFILER_MAX_EVENTS) {
+				events.push_back(stamped);
+			}
+			else {
+				++dropped;
+			}
+		}
+		
+		// 清空全部记录与步编号
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex);
+			events.clear();
+			totals.clear();
+			step = 0;
+			dropped = 0;
+		}
+		
+		std::vector<ProfileEvent> getEvents() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return events;
+		}
+		
+		size_t getDroppedEvents() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return dropped;
+		}
+		
+		// 按名称与阶段汇总，按总耗时从大到小排列
+		std::vector<ProfileSummary> summarize() const {
+			std::vector<ProfileSummary> result;
+			
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				
+				for (const auto& entry : totals) {
+					const Total& total = entry.second;
+					result.push_back(ProfileSummary{entry.first.first, entry.first.second, total.calls, total.duration * 1e-9, total.flops, total.bytes});
+				}
+			}
+			
+			std::sort(result.begin(), result.end(), [](const ProfileSummary & a, const ProfileSummary & b) {
+				return a.seconds > b.seconds;
+			});
+			return result;
+		}
+		
+		// 打印汇总表：调用次数、总耗时、平均耗时、占训练步总时间的比例、GFLOP、GFLOP/s 与分配的字节数
+		void printSummary(std::ostream& out = std::cout) const {
+			std::vector<ProfileSummary> rows = summarize();
+			double stepSeconds = 0.0;
+			
+			for (const ProfileSummary& row : rows) {
+				if (row.phase == ProfilePhase::Step) {
+					stepSeconds += row.seconds;
+				}
+			}
+			
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-40s %-9s %8s %11s %11s %7s %10s %9s %12s\n", "name", "phase", "calls", "total(ms)", "mean(us)", "step%",
+			              "GFLOP", "GFLOP/s", "bytes");
+			out << line;
+			
+			for (const ProfileSummary& row : rows) {
+				double share = stepSeconds > 0.0 ? row.seconds / stepSeconds * 100.0 : 0.0;
+				std::snprintf(line, sizeof(line), "%-40s %-9s %8zu %11.3f %11.3f %7.1f %10.4f %9.3f %12zu\n", row.name.c_str(), profilePhaseName(row.phase),
+				              row.calls, row.seconds * 1e3, row.seconds / row.calls * 1e6, share, row.flops * 1e-9, row.gflops(), row.bytes);
+				out << line;
+			}
+			
+			size_t lost = getDroppedEvents();
+			
+			if (lost > 0) {
+				out << lost << " events were not kept in the trace (limit " << PROFILER_MAX_EVENTS << ")." << std::endl;
+			}
+		}
+		
+		// 以 Chrome trace 事件格式（完整事件 "X"，时间单位微秒）输出全部事件
+		void writeChromeTrace(std::ostream& out) const {
+			std::vector<ProfileEvent> snapshot = getEvents();
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			char number[64];
+			
+			for (size_t i = 0; i < snapshot.size(); ++i) {
+				const ProfileEvent& event = snapshot[i];
+				out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"";
+				writeEscaped(out, event.name);
+				out << "\",\"cat\":\"" << profilePhaseName(event.phase) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread;
+				std::snprintf(number, sizeof(number), "%.3f", event.start * 1e-3);
+				out << ",\"ts\":" << number;
+				std::snprintf(number, sizeof(number), "%.3f", event.duration * 1e-3);
+				out << ",\"dur\":" << number << ",\"args\":{\"step\":" << event.step;
+				std::snprintf(number, sizeof(number), "%.0f", event.flops);
+				out << ",\"flops\":" << number << ",\"bytes\":" << event.bytes;
+				std::snprintf(number, sizeof(number), "%.3f", event.duration > 0 ? event.flops / event.duration : 0.0);
+				out << ",\"gflops\":" << number << "}}";
+			}
+			
+			out << "\n]}\n";
+		}
+		
+		void saveChromeTrace(const std::string& path) const {
+			std::ofstream file(path);
+			
+			if (!file) {
+				throw std::runtime_error("Failed to open file: " + path);
+			}
+			
+			writeChromeTrace(file);
+		}
+};
+
+// 剖析作用域：构造时记下时间、分配计数与运算量计数，析构时记录一个事件
+// flops 为作用域内的浮点运算量估计；Step 阶段的作用域开始一个新训练步，其运算量取其中最外层作用域之和
+class ProfileScope {
+		const char* name;
+		ProfilePhase phase;
+		double flops;
+		int64_t start;
+		size_t bytes;
+		double counted;
+		bool active;
+		
+	public:
+		ProfileScope(const char* name, ProfilePhase phase, double flops = 0.0)
+			: name(name), phase(phase), flops(flops), start(0), bytes(0), counted(0.0), active(Profiler::instance().isEnabled()) {
+			if (!active) {
+				return;
+			}
+			
+			Profiler& profiler = Profiler::instance();
+			
+			if (phase == ProfilePhase::Step) {
+				profiler.beginStep();
+			}
+			else if (flops > 0.0 && Profiler::flopDepth()++ == 0) {
+				Profiler::countedFlops() += flops;
+			}
+			
+			bytes = Profiler::allocatedBytes();
+			counted = Profiler::countedFlops();
+			start = profiler.now();
+		}
+		
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+		
+		~ProfileScope() {
+			if (!active) {
+				return;
+			}
+			
+			Profiler& profiler = Profiler::instance();
+			int64_t end = profiler.now();
+			
+			if (phase == ProfilePhase::Step) {
+				flops = Profiler::countedFlops() - counted;
+			}
+			else if (flops > 0.0) {
+				--Profiler::flopDepth();
+			}
+			
+			profiler.record(ProfileEvent{name, phase, start, end - start, flops, Profiler::allocatedBytes() - bytes, 0, Profiler::threadIndex()});
+		}
+};
+
+#ifdef MODEL_PROFILING
+	#define PROFILE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+	// 剖析当前作用域：PROFILE_SCOPE("Attention", ProfilePhase::Forward, flops)
+	#define PROFILE_SCOPE(name, phase, flops) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, phase, flops)
+	// 把当前作用域作为一个训练步
+	#define PROFILE_STEP(name) ProfileScope PROFILE_CONCAT(profileStep, __LINE__)(name, ProfilePhase::Step)
+	// 登记一次堆分配
+	#define PROFILE_ALLOCATION(bytes) Profiler::countAllocation(bytes)
+#else
+	#define PROFILE_SCOPE(name, phase, flops) ((void)0)
+	#define PROFILE_STEP(name) ((void)0)
+	#define PROFILE_ALLOCATION(bytes) ((void)0)
+#endif
+
+// 各层的浮点运算量估计（乘加计为 2 次），反向传播约为前向的 2 倍
+// 全连接：in x out 的矩阵乘 rows 次
+inline double denseFlops(size_t rows, size_t in, size_t out) {
+	return 2.0 * rows * in * out;
+}
+
+// 多头注意力：Q/输出投影按查询行、K/V 投影按键行，加上得分与加权求和
+inline double attentionFlops(size_t queryRows, size_t keyRows, size_t keysPerQuery, size_t dim) {
+	return denseFlops(queryRows, dim, 2 * dim) + denseFlops(keyRows, dim, 2 * dim) + 4.0 * queryRows * keysPerQuery * dim;
+}
+
+// 卷积：每个输出元素做 channels x filterSize x filterSize 次乘加
+inline double convolutionFlops(size_t channels, size_t filterSize, size_t numFilters, size_t outputHeight, size_t outputWidth) {
+	return 2.0 * numFilters * outputHeight * outputWidth * channels * filterSize * filterSize;
+}
@@ -27,6 +27,11 @@
 #include <vector>
 #include <iostream>
 #include <random>
+#include <stdexcept>
+#include "./Kernels.h"
+#include "./Activation.h"
+#include "./Precision.h"
+#include "./Profiler.h"
 
 // 定义激活函数类型
 using ActivationFunction = std::function<double(double)>;
@@ -52,11 +57,158 @@ double relu_derivative(double x) {
 	return x > 0 ? 1.0 : 0.0;
 }
 
+// Tanh激活函数
+inline double tanh_activation(double x) {
+	return std::tanh(x);
+}
+
+// Tanh激活函数的导数
+inline double tanh_derivative(double x) {
+	double t = std::tanh(x);
+	return 1 - t * t;
+}
+
+// GELU激活函数（tanh 近似）
+inline double gelu(double x) {
+	return GELUActivation::value(x);
+}
+
+// GELU激活函数的导数
+inline double gelu_derivative(double x) {
+	return GELUActivation::derivative(x);
+}
+
+// 内置激活函数的种类；Custom 表示只能通过 std::function 逐元素调用
+enum class ActivationKind {
+	Custom,
+	Identity,
+	Sigmoid,
+	ReLU,
+	Tanh,
+	GELU
+};
+
+// 识别 std::function 中包装的内置激活函数，识别成功后即可改用向量化的缓冲区计算核
+inline ActivationKind activationKindOf(const ActivationFunction& func) {
+	auto target = func.target<double(*)(double)>();
+	
+	if (target == nullptr) {
+		return ActivationKind::Custom;
+	}
+	
+	if (*target == sigmoid) {
+		return ActivationKind::Sigmoid;
+	}
+	
+	if (*target == relu) {
+		return ActivationKind::ReLU;
+	}
+	
+	if (*target == tanh_activation) {
+		return ActivationKind::Tanh;
+	}
+	
+	if (*target == gelu) {
+		return ActivationKind::GELU;
+	}
+	
+	return ActivationKind::Custom;
+}
+
+// 识别 std::function 中包装的内置激活函数导数
+inline ActivationKind derivativeKindOf(const ActivationFunction& func) {
+	auto target = func.target<double(*)(double)>();
+	
+	if (target == nullptr) {
+		return ActivationKind::Custom;
+	}
+	
+	if (*target == sigmoid_derivative) {
+		return ActivationKind::Sigmoid;
+	}
+	
+	if (*target == relu_derivative) {
+		return ActivationKind::ReLU;
+	}
+	
+	if (*target == tanh_derivative) {
+		return ActivationKind::Tanh;
+	}
+	
+	if (*target == gelu_derivative) {
+		return ActivationKind::GELU;
+	}
+	
+	return ActivationKind::Custom;
+}
+
+// 对整块缓冲区应用激活函数：每个缓冲区只分派一次，内置激活走编译期展开的 SIMD 计算核
+// T 为 double 或 float（混合精度训练）
+template<class T>
+inline void applyActivation(ActivationKind kind, T* x, size_t n, const ActivationFunction& fallback) {
+	switch (kind) {
+		case ActivationKind::Identity:
+			break;
+			
+		case ActivationKind::Sigmoid:
+			applyElementwise<SigmoidActivation>(x, n);
+			break;
+			
+		case ActivationKind::ReLU:
+			applyElementwise<ReLUActivation>(x, n);
+			break;
+			
+		case ActivationKind::Tanh:
+			applyElementwise<TanhActivation>(x, n);
+			break;
+			
+		case ActivationKind::GELU:
+			applyElementwise<GELUActivation>(x, n);
+			break;
+			
+		default:
+			for (size_t i = 0; i < n; ++i) {
+				x[i] = static_cast<T>(fallback(x[i]));
+			}
+	}
+}
+
+// 对整块缓冲区计算激活函数的导数，结果写入 out
+template<class T>
+inline void applyActivationDerivative(ActivationKind kind, const T* x, T* out, size_t n, const ActivationFunction& fallback) {
+	switch (kind) {
+		case ActivationKind::Identity:
+			applyElementwiseDerivative<IdentityActivation>(x, out, n);
+			break;
+			
+		case ActivationKind::Sigmoid:
+			applyElementwiseDerivative<SigmoidActivation>(x, out, n);
+			break;
+			
+		case ActivationKind::ReLU:
+			applyElementwiseDerivative<ReLUActivation>(x, out, n);
+			break;
+			
+		case ActivationKind::Tanh:
+			applyElementwiseDerivative<TanhActivation>(x, out, n);
+			break;
+			
+		case ActivationKind::GELU:
+			applyElementwiseDerivative<GELUActivation>(x, out, n);
+			break;
+			
+		default:
+			for (size_t i = 0; i < n; ++i) {
+				out[i] = static_cast<T>(fallback(x[i]));
+			}
+	}
+}
+
 class MatrixXd {
 	private:
 		int rows;
 		int cols;
-		std::vector<std::vector<double >> data;
+		std::vector<double> values; // 行主序连续存储，便于直接交给计算核
 		
 	public:
 		// 默认构造函数
@@ -64,7 +216,8 @@ class MatrixXd {
 		
 		// 构造函数，初始化矩阵的行数和列数
 		MatrixXd(int r, int c) : rows(r), cols(c) {
-			data.resize(rows, std::vector<double>(cols, 0.0));
+			values.assign(static_cast<size_t>(rows) * cols, 0.0);
+			PROFILE_ALLOCATION(values.size() * sizeof(double));
 		}
 		
 		// 析构函数
@@ -82,12 +235,22 @@ class MatrixXd {
 		
 		// 访问矩阵元素
 		double& operator()(int i, int j) {
-			return data[i][j];
+			return values[static_cast<size_t>(i) * cols + j];
 		}
 		
 		// 访问矩阵元素（常量版本）
 		const double& operator()(int i, int j) const {
-			return data[i][j];
+			return values[static_cast<size_t>(i) * cols + j];
+		}
+		
+		// 获取底层连续存储的指针（行主序）
+		double* data() {
+			return values.data();
+		}
+		
+		// 获取底层连续存储的指针（常量版本）
+		const double* data() const {
+			return values.data();
 		}
 		
 		// 矩阵加法
@@ -100,7 +263,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(i, j) = data[i][j] + other(i, j);
+					result(i, j) = (*this)(i, j) + other(i, j);
 				}
 			}
 			
@@ -114,15 +277,7 @@ class MatrixXd {
 			}
 			
 			MatrixXd result(rows, other.cols);
-			
-			for (int i = 0; i < rows; ++i) {
-				for (int j = 0; j < other.cols; ++j) {
-					for (int k = 0; k < cols; ++k) {
-						result(i, j) += data[i][k] * other(k, j);
-					}
-				}
-			}
-			
+			gemm(data(), other.data(), result.data(), rows, other.cols, cols);
 			return result;
 		}
 		
@@ -132,7 +287,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(i, j) = data[i][j] * scalar;
+					result(i, j) = (*this)(i, j) * scalar;
 				}
 			}
 			
@@ -145,7 +300,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(i, j) = data[i][j] / scalar;
+					result(i, j) = (*this)(i, j) / scalar;
 				}
 			}
 			
@@ -158,20 +313,28 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(i, j) = func(data[i][j]);
+					result(i, j) = func((*this)(i, j));
 				}
 			}
 			
 			return result;
 		}
 		
+		// 矩阵元素应用编译期激活函数（向量化，无类型擦除）
+		template<class Activation>
+		MatrixXd apply() const {
+			MatrixXd result = *this;
+			applyElementwise<Activation>(result.data(), result.values.size());
+			return result;
+		}
+		
 		// 矩阵转置
 		MatrixXd transpose() const {
 			MatrixXd result(cols, rows);
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(j, i) = data[i][j];
+					result(j, i) = (*this)(i, j);
 				}
 			}
 			
@@ -182,7 +345,7 @@ class MatrixXd {
 		void print() const {
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					std::cout << data[i][j] << " ";
+					std::cout << (*this)(i, j) << " ";
 				}
 				
 				std::cout << std::endl;
@@ -215,7 +378,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					result(i, j) = data[i][j] - other(i, j);
+					result(i, j) = (*this)(i, j) - other(i, j);
 				}
 			}
 			
@@ -229,7 +392,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					data[i][j] -= other(i, j);
+					(*this)(i, j) -= other(i, j);
 				}
 			}
 			
@@ -242,7 +405,7 @@ class MatrixXd {
 			
 			for (int i = 0; i < rows; ++i) {
 				for (int j = 0; j < cols; ++j) {
-					norm += data[i][j] * data[i][j];
+					norm += (*this)(i, j) * (*this)(i, j);
 				}
 			}
 			
@@ -254,7 +417,7 @@ class MatrixXd {
 				
 				for (int i = 0; i < rows; ++i) {
 					for (int j = 0; j < cols; ++j) {
-						result(i, j) = data[i][j] * scale;
+						result(i, j) = (*this)(i, j) * scale;
 					}
 				}
 				
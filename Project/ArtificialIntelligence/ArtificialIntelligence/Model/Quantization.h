@@ -0,0 +1,312 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "./InferenceSession.h"
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+// 全连接网络的训练后 int8 量化推理
+// 权重：按输出通道对称量化为 int8，每个输出节点一个缩放系数
+// 激活：按层非对称量化为 0~127 的 uint8（只用 7 位，保证 vpmaddubsw 的 16 位中间和不会饱和）
+// 量化参数由一组样本输入校准得到
+
+#define QUANTIZED_BLOCK 32 // 输入维度按 32 字节对齐填充，便于 AVX2 一次处理 32 个元素
+#define QUANTIZED_ACTIVATION_MAX 127
+
+// 整数点积 sum(a[i] * w[i])，n 必须是 QUANTIZED_BLOCK 的倍数
+inline int32_t dotU8S8(const uint8_t* a, const int8_t* w, int n) {
+	#ifdef __AVX2__
+	__m256i acc = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	
+	for (int i = 0; i < n; i += QUANTIZED_BLOCK) {
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+		// u8 x s8 相邻两项相加得到 16 位，再与 1 做 madd 扩展成 32 位累加
+		__m256i pairs = _mm256_maddubs_epi16(va, vw);
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+	}
+	
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+	#else
+	int32_t sum = 0;
+	
+	for (int i = 0; i < n; ++i) {
+		sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(w[i]);
+	}
+	
+	return sum;
+	#endif
+}
+
+// 单层量化参数与权重
+struct QuantizedDenseLayer {
+	int inputSize;
+	int outputSize;
+	int paddedInputSize; // inputSize 向上取整到 QUANTIZED_BLOCK 的倍数
+	std::vector<int8_t> weights; // outputSize x paddedInputSize，按输出节点转置存放，填充部分为 0
+	std::vector<double> weightScales; // 每个输出节点的权重缩放系数
+	std::vector<int32_t> weightSums; // 每个输出节点的权重之和，用于扣除输入零点
+	std::vector<double> thresholds;
+	double inputScale; // 输入激活的缩放系数
+	int inputZeroPoint; // 输入激活的零点
+};
+
+// 量化精度对比报告
+struct QuantizationReport {
+	size_t samples;
+	double maxAbsoluteError;
+	double meanAbsoluteError;
+	double argmaxAgreement; // 最大输出下标一致的样本比例
+	size_t floatWeightBytes;
+	size_t quantizedWeightBytes;
+	
+	void print() const {
+		std::cout << "Samples: " << samples << std::endl;
+		std::cout << "Max absolute error: " << maxAbsoluteError << std::endl;
+		std::cout << "Mean absolute error: " << meanAbsoluteError << std::endl;
+		std::cout << "Argmax agreement: " << argmaxAgreement * 100 << "%" << std::endl;
+		std::cout << "Weight memory: " << floatWeightBytes << " -> " << quantizedWeightBytes << " bytes" << std::endl;
+	}
+};
+
+// 量化后的全连接网络（只用于推理）
+class QuantizedFullyConnectedNetwork {
+		std::vector<QuantizedDenseLayer> layers;
+		ActivationFunction activation;
+		ActivationKind activationKind;
+		int maxBatch;
+		size_t maxWidth;
+		ActivationArena arena; // 浮点激活缓冲区
+		std::vector<uint8_t> quantizedInput; // 量化后的当前层输入
+		
+		static int paddedSize(int size) {
+			return (size + QUANTIZED_BLOCK - 1) / QUANTIZED_BLOCK * QUANTIZED_BLOCK;
+		}
+		
+		// 由校准得到的取值范围计算缩放系数与零点；范围总是包含 0，保证 0 能被精确表示
+		static void chooseActivationRange(double low, double high, double& scale, int& zeroPoint) {
+			low = std::min(low, 0.0);
+			high = std::max(high, 0.0);
+			scale = (high - low) / QUANTIZED_ACTIVATION_MAX;
+			
+			if (scale <= 0) {
+				scale = 1.0;
+			}
+			
+			zeroPoint = static_cast<int>(std::lround(-low / scale));
+		}
+		
+		// 量化一个样本的输入，填充部分置为零点（对应的权重为 0，不影响结果）
+		static void quantizeRow(const QuantizedDenseLayer& layer, const double* input, uint8_t* output) {
+			for (int j = 0; j < layer.inputSize; ++j) {
+				long value = std::lround(input[j] / layer.inputScale) + layer.inputZeroPoint;
+				output[j] = static_cast<uint8_t>(std::min<long>(std::max<long>(value, 0), QUANTIZED_ACTIVATION_MAX));
+			}
+			
+			for (int j = layer.inputSize; j < layer.paddedInputSize; ++j) {
+				output[j] = static_cast<uint8_t>(layer.inputZeroPoint);
+			}
+		}
+		
+	public:
+		// network 为已训练的浮点网络，calibrationInputs 为用于统计激活取值范围的样本
+		QuantizedFullyConnectedNetwork(const FullyConnectedNeuralNetwork& network, const std::vector<std::vector<double >>& calibrationInputs, int maxBatch = 1)
+			: activation(network.getActivation()), activationKind(network.getActivationKind()), maxBatch(maxBatch), maxWidth(0) {
+			if (calibrationInputs.empty()) {
+				throw std::invalid_argument("Quantization requires at least one calibration sample.");
+			}
+			
+			FullyConnectedInferenceSession session(network);
+			const std::vector<DenseLayerView>& views = session.getLayers();
+			// 逐层统计输入激活的取值范围
+			std::vector<double> low(views.size(), 0.0), high(views.size(), 0.0);
+			std::vector<double> current, next;
+			
+			for (const auto& sample : calibrationInputs) {
+				current = sample;
+				
+				for (size_t l = 0; l < views.size(); ++l) {
+					for (double value : current) {
+						low[l] = std::min(low[l], value);
+						high[l] = std::max(high[l], value);
+					}
+					
+					next.assign(views[l].outputSize, 0.0);
+					denseForward(views[l], current.data(), 1, next.data(), activationKind, activation);
+					current.swap(next);
+				}
+			}
+			
+			// 按输出通道量化权重
+			for (size_t l = 0; l < views.size(); ++l) {
+				const DenseLayerView& view = views[l];
+				QuantizedDenseLayer layer;
+				layer.inputSize = view.inputSize;
+				layer.outputSize = view.outputSize;
+				layer.paddedInputSize = paddedSize(view.inputSize);
+				layer.weights.assign(static_cast<size_t>(view.outputSize) * layer.paddedInputSize, 0);
+				layer.weightScales.assign(view.outputSize, 1.0);
+				layer.weightSums.assign(view.outputSize, 0);
+				layer.thresholds.assign(view.thresholds, view.thresholds + view.outputSize);
+				chooseActivationRange(low[l], high[l], layer.inputScale, layer.inputZeroPoint);
+				
+				for (int k = 0; k < view.outputSize; ++k) {
+					double maxAbs = 0.0;
+					
+					for (int j = 0; j < view.inputSize; ++j) {
+						maxAbs = std::max(maxAbs, std::abs(view.weights[static_cast<size_t>(j) * view.outputSize + k]));
+					}
+					
+					double scale = maxAbs > 0 ? maxAbs / 127.0 : 1.0;
+					layer.weightScales[k] = scale;
+					
+					for (int j = 0; j < view.inputSize; ++j) {
+						long value = std::lround(view.weights[static_cast<size_t>(j) * view.outputSize + k] / scale);
+						int8_t quantized = static_cast<int8_t>(std::min<long>(std::max<long>(value, -127), 127));
+						layer.weights[static_cast<size_t>(k) * layer.paddedInputSize + j] = quantized;
+						layer.weightSums[k] += quantized;
+					}
+				}
+				
+				maxWidth = std::max(maxWidth, static_cast<size_t>(std::max(layer.paddedInputSize, layer.outputSize)));
+				layers.push_back(std::move(layer));
+			}
+			
+			arena.reserve(2 * ActivationArena::footprint(static_cast<size_t>(maxBatch) * maxWidth));
+			quantizedInput.assign(maxWidth, 0);
+		}
+		
+		~QuantizedFullyConnectedNetwork() {}
+		
+		// 批量推理：input 为 batch x 输入大小，返回的指针在下一次 run 之前有效
+		const double* run(const double* input, int batch) {
+			if (batch > maxBatch) {
+				throw std::invalid_argument("Batch size exceeds the planned maximum.");
+			}
+			
+			arena.reset();
+			double* buffers[2] = {arena.allocate(static_cast<size_t>(maxBatch) * maxWidth), arena.allocate(static_cast<size_t>(maxBatch) * maxWidth)};
+			const double* current = input;
+			
+			for (size_t l = 0; l < layers.size(); ++l) {
+				const QuantizedDenseLayer& layer = layers[l];
+				double* next = buffers[l % 2];
+				
+				for (int b = 0; b < batch; ++b) {
+					quantizeRow(layer, current + static_cast<size_t>(b) * layer.inputSize, quantizedInput.data());
+					double* row = next + static_cast<size_t>(b) * layer.outputSize;
+					
+					for (int k = 0; k < layer.outputSize; ++k) {
+						int32_t acc = dotU8S8(quantizedInput.data(), layer.weights.data() + static_cast<size_t>(k) * layer.paddedInputSize, layer.paddedInputSize);
+						// 扣除零点：sum((a - z) * w) = sum(a * w) - z * sum(w)
+						acc -= layer.inputZeroPoint * layer.weightSums[k];
+						row[k] = acc * layer.inputScale * layer.weightScales[k] - layer.thresholds[k];
+					}
+					
+					applyActivation(activationKind, row, layer.outputSize, activation);
+				}
+				
+				current = next;
+			}
+			
+			return current;
+		}
+		
+		// 单个样本推理，接口与 FullyConnectedNeuralNetwork::calculate 一致
+		std::vector<double> calculate(const std::vector<double>& input) {
+			if (static_cast<int>(input.size()) != layers.front().inputSize) {
+				throw std::invalid_argument("Input size does not match the number of input nodes.");
+			}
+			
+			const double* output = run(input.data(), 1);
+			return std::vector<double>(output, output + layers.back().outputSize);
+		}
+		
+		// 量化权重占用的字节数（不含填充）
+		size_t getWeightBytes() const {
+			size_t bytes = 0;
+			
+			for (const auto& layer : layers) {
+				bytes += static_cast<size_t>(layer.inputSize) * layer.outputSize * sizeof(int8_t);
+			}
+			
+			return bytes;
+		}
+		
+		const std::vector<QuantizedDenseLayer>& getLayers() const {
+			return layers;
+		}
+};
+
+// 在样本集上比较浮点网络与量化网络的输出
+inline QuantizationReport compareQuantization(const FullyConnectedNeuralNetwork& network, QuantizedFullyConnectedNetwork& quantized, const std::vector<std::vector<double >>& inputs) {
+	FullyConnectedInferenceSession session(network);
+	QuantizationReport report{inputs.size(), 0.0, 0.0, 0.0, 0, quantized.getWeightBytes()};
+	size_t outputs = 0;
+	size_t agreements = 0;
+	
+	for (const auto& layer : session.getLayers()) {
+		report.floatWeightBytes += static_cast<size_t>(layer.inputSize) * layer.outputSize * sizeof(double);
+	}
+	
+	for (const auto& input : inputs) {
+		std::vector<double> expected = session.calculate(input);
+		std::vector<double> actual = quantized.calculate(input);
+		
+		for (size_t i = 0; i < expected.size(); ++i) {
+			double error = std::abs(expected[i] - actual[i]);
+			report.maxAbsoluteError = std::max(report.maxAbsoluteError, error);
+			report.meanAbsoluteError += error;
+		}
+		
+		outputs += expected.size();
+		
+		if (std::max_element(expected.begin(), expected.end()) - expected.begin() == std::max_element(actual.begin(), actual.end()) - actual.begin()) {
+			++agreements;
+		}
+	}
+	
+	if (outputs > 0) {
+		report.meanAbsoluteError /= outputs;
+	}
+	
+	if (!inputs.empty()) {
+		report.argmaxAgreement = static_cast<double>(agreements) / inputs.size();
+	}
+	
+	return report;
+}
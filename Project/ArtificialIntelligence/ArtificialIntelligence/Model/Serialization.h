@@ -0,0 +1,517 @@
+/*
+    Copyright (c) June 9, 2025 Gitgary-1024
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "./InferenceSession.h"
+#include "./MappedFile.h"
+
+// 模型文件格式（本机字节序）：
+//   ModelFileHeader
+//   int32_t config[configCount]            模型结构参数
+//   ModelSection sections[sectionCount]    各权重段的位置与长度
+//   权重段                                  每段为连续的 double 数组，起始位置按 64 字节对齐
+// 权重段按对齐方式存放，映射到内存后可以直接作为权重视图使用，无需拷贝
+
+#define MODEL_FILE_MAGIC "CCLMODEL"
+#define MODEL_FILE_VERSION 2 // 版本 2：Transformer 增加层归一化与位置编码
+#define MODEL_SECTION_ALIGNMENT 64
+
+// 模型种类
+enum class ModelType : uint32_t {
+	FullyConnected = 1,
+	Convolutional = 2,
+	Transformer = 3
+};
+
+// 可序列化的激活函数
+enum class ActivationId : uint32_t {
+	None = 0,
+	Sigmoid = 1,
+	ReLU = 2,
+	Tanh = 3,
+	GELU = 4
+};
+
+struct ModelFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t type; // ModelType
+	uint32_t activation; // ActivationId
+	uint32_t configCount;
+	uint32_t sectionCount;
+	uint32_t reserved;
+	uint64_t fileSize;
+};
+
+struct ModelSection {
+	uint64_t offset; // 相对文件开头的字节偏移
+	uint64_t count; // double 的个数
+};
+
+// 识别内置激活函数；自定义的 std::function 无法写入文件
+inline ActivationId activationToId(const ActivationFunction& func) {
+	switch (activationKindOf(func)) {
+		case ActivationKind::Sigmoid:
+			return ActivationId::Sigmoid;
+			
+		case ActivationKind::ReLU:
+			return ActivationId::ReLU;
+			
+		case ActivationKind::Tanh:
+			return ActivationId::Tanh;
+			
+		case ActivationKind::GELU:
+			return ActivationId::GELU;
+			
+		default:
+			throw std::invalid_argument("Only built-in activation functions can be serialized.");
+	}
+}
+
+inline ActivationFunction activationFromId(uint32_t id) {
+	switch (static_cast<ActivationId>(id)) {
+		case ActivationId::Sigmoid:
+			return sigmoid;
+			
+		case ActivationId::ReLU:
+			return relu;
+			
+		case ActivationId::Tanh:
+			return tanh_activation;
+			
+		case ActivationId::GELU:
+			return gelu;
+			
+		default:
+			throw std::runtime_error("Unknown activation function in model file.");
+	}
+}
+
+inline ActivationFunction activationDerivativeFromId(uint32_t id) {
+	switch (static_cast<ActivationId>(id)) {
+		case ActivationId::Sigmoid:
+			return sigmoid_derivative;
+			
+		case ActivationId::ReLU:
+			return relu_derivative;
+			
+		case ActivationId::Tanh:
+			return tanh_derivative;
+			
+		case ActivationId::GELU:
+			return gelu_derivative;
+			
+		default:
+			throw std::runtime_error("Unknown activation function in model file.");
+	}
+}
+
+// 模型文件写入器：先收集结构参数与权重段，再一次性写出
+class ModelWriter {
+		ModelType type;
+		ActivationId activation;
+		std::vector<int32_t> config;
+		std::vector<std::vector<double >> sections;
+		
+		static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+		
+	public:
+		ModelWriter(ModelType type, ActivationId activation = ActivationId::None) : type(type), activation(activation) {}
+		
+		void addConfig(int32_t value) {
+			config.push_back(value);
+		}
+		
+		void addSection(const double* values, size_t count) {
+			sections.emplace_back(values, values + count);
+		}
+		
+		void addSection(std::vector<double> values) {
+			sections.push_back(std::move(values));
+		}
+		
+		void write(const std::string& path) const {
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			
+			if (!file.is_open()) {
+				throw std::runtime_error("Failed to open model file: " + path);
+			}
+			
+			// 计算各段的偏移
+			uint64_t tableOffset = alignUp(sizeof(ModelFileHeader) + config.size() * sizeof(int32_t), alignof(ModelSection));
+			uint64_t offset = alignUp(tableOffset + sections.size() * sizeof(ModelSection), MODEL_SECTION_ALIGNMENT);
+			std::vector<ModelSection> table;
+			
+			for (const auto& section : sections) {
+				table.push_back(ModelSection{offset, section.size()});
+				offset = alignUp(offset + section.size() * sizeof(double), MODEL_SECTION_ALIGNMENT);
+			}
+			
+			ModelFileHeader header{};
+			std::memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+			header.version = MODEL_FILE_VERSION;
+			header.type = static_cast<uint32_t>(type);
+			header.activation = static_cast<uint32_t>(activation);
+			header.configCount = static_cast<uint32_t>(config.size());
+			header.sectionCount = static_cast<uint32_t>(sections.size());
+			header.fileSize = offset;
+			// 写出文件头、结构参数与段表，段与段之间用零填充
+			std::vector<char> padding(MODEL_SECTION_ALIGNMENT, 0);
+			uint64_t written = 0;
+			auto pad = [&](uint64_t target) {
+				file.write(padding.data(), static_cast<std::streamsize>(target - written));
+				written = target;
+			};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(config.data()), static_cast<std::streamsize>(config.size() * sizeof(int32_t)));
+			written = sizeof(header) + config.size() * sizeof(int32_t);
+			pad(tableOffset);
+			file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(ModelSection)));
+			written += table.size() * sizeof(ModelSection);
+			
+			for (size_t i = 0; i < sections.size(); ++i) {
+				pad(table[i].offset);
+				file.write(reinterpret_cast<const char*>(sections[i].data()), static_cast<std::streamsize>(sections[i].size() * sizeof(double)));
+				written += sections[i].size() * sizeof(double);
+			}
+			
+			pad(offset);
+			
+			if (!file) {
+				throw std::runtime_error("Failed to write model file: " + path);
+			}
+		}
+};
+
+// 只读映射的模型文件；多个进程映射同一文件时共享页缓存
+// 由它创建的推理会话直接引用映射中的权重，必须先于本对象销毁
+class MappedModelFile {
+		MappedFile mapped;
+		const char* base;
+		size_t size;
+		const ModelFileHeader* header;
+		const int32_t* config;
+		const ModelSection* sections;
+		
+		// 校验文件头与段表，防止越界访问
+		void validate() {
+			if (size < sizeof(ModelFileHeader)) {
+				throw std::runtime_error("Model file is too small.");
+			}
+			
+			header = reinterpret_cast<const ModelFileHeader*>(base);
+			
+			if (std::memcmp(header->magic, MODEL_FILE_MAGIC, sizeof(header->magic)) != 0) {
+				throw std::runtime_error("Not a model file.");
+			}
+			
+			if (header->version == 0 || header->version > MODEL_FILE_VERSION) {
+				throw std::runtime_error("Unsupported model file version.");
+			}
+			
+			if (header->fileSize != size) {
+				throw std::runtime_error("Model file is truncated.");
+			}
+			
+			size_t configEnd = sizeof(ModelFileHeader) + header->configCount * sizeof(int32_t);
+			size_t tableOffset = (configEnd + alignof(ModelSection) - 1) / alignof(ModelSection) * alignof(ModelSection);
+			
+			if (tableOffset + header->sectionCount * sizeof(ModelSection) > size) {
+				throw std::runtime_error("Model file is truncated.");
+			}
+			
+			config = reinterpret_cast<const int32_t*>(base + sizeof(ModelFileHeader));
+			sections = reinterpret_cast<const ModelSection*>(base + tableOffset);
+			
+			for (uint32_t i = 0; i < header->sectionCount; ++i) {
+				if (sections[i].offset % MODEL_SECTION_ALIGNMENT != 0 || sections[i].offset + sections[i].count * sizeof(double) > size) {
+					throw std::runtime_error("Corrupted model section table.");
+				}
+			}
+		}
+		
+	public:
+		MappedModelFile(const std::string& path)
+			: mapped(path), base(mapped.data()), size(mapped.getSize()), header(nullptr), config(nullptr), sections(nullptr) {
+			validate();
+		}
+		
+		MappedModelFile(const MappedModelFile&) = delete;
+		MappedModelFile& operator=(const MappedModelFile&) = delete;
+		
+		~MappedModelFile() {}
+		
+		ModelType getType() const {
+			return static_cast<ModelType>(header->type);
+		}
+		
+		uint32_t getVersion() const {
+			return header->version;
+		}
+		
+		uint32_t getActivation() const {
+			return header->activation;
+		}
+		
+		std::vector<int> getConfig() const {
+			return std::vector<int>(config, config + header->configCount);
+		}
+		
+		size_t getSectionCount() const {
+			return header->sectionCount;
+		}
+		
+		// 第 index 段权重在映射中的地址；expectedCount 用于校验长度
+		const double* section(size_t index, size_t expectedCount) const {
+			if (index >= header->sectionCount || sections[index].count != expectedCount) {
+				throw std::runtime_error("Model section does not match the model structure.");
+			}
+			
+			return reinterpret_cast<const double*>(base + sections[index].offset);
+		}
+		
+		void requireType(ModelType type) const {
+			if (getType() != type) {
+				throw std::runtime_error("Model file contains a different kind of model.");
+			}
+		}
+};
+
+// 按层结构从第 first 段开始构造全连接层视图
+inline std::vector<DenseLayerView> mappedDenseLayers(const MappedModelFile& file, const std::vector<int>& layerSizes, size_t first) {
+	std::vector<DenseLayerView> layers;
+	
+	for (size_t i = 0; i + 1 < layerSizes.size(); ++i) {
+		size_t in = layerSizes[i];
+		size_t out = layerSizes[i + 1];
+		layers.push_back(DenseLayerView{layerSizes[i], layerSizes[i + 1], file.section(first + 2 * i, in * out), file.section(first + 2 * i + 1, out)});
+	}
+	
+	return layers;
+}
+
+inline void writeDenseLayers(ModelWriter& writer, const FullyConnectedNeuralNetwork& network) {
+	// 推理会话的打包格式与文件格式一致，直接复用
+	FullyConnectedInferenceSession packed(network);
+	
+	for (const auto& layer : packed.getLayers()) {
+		writer.addSection(layer.weights, static_cast<size_t>(layer.inputSize) * layer.outputSize);
+		writer.addSection(layer.thresholds, layer.outputSize);
+	}
+}
+
+inline AttentionView mappedAttention(const MappedModelFile& file, int dim, int heads, size_t first) {
+	size_t n = static_cast<size_t>(dim) * dim;
+	return AttentionView{dim, heads, file.section(first, n), file.section(first + 1, n), file.section(first + 2, n), file.section(first + 3, n)};
+}
+
+inline void writeAttention(ModelWriter& writer, const AttentionView& w) {
+	size_t n = static_cast<size_t>(w.dim) * w.dim;
+	writer.addSection(w.Wq, n);
+	writer.addSection(w.Wk, n);
+	writer.addSection(w.Wv, n);
+	writer.addSection(w.Wo, n);
+}
+
+// ---------------- 全连接网络 ----------------
+// config: 各层节点数；段: 每层 weights、thresholds
+
+inline void saveModel(const FullyConnectedNeuralNetwork& network, const std::string& path) {
+	ModelWriter writer(ModelType::FullyConnected, activationToId(network.getActivation()));
+	
+	for (int size : network.getLayerSizes()) {
+		writer.addConfig(size);
+	}
+	
+	writeDenseLayers(writer, network);
+	writer.write(path);
+}
+
+// 零拷贝：会话直接使用映射中的权重
+inline FullyConnectedInferenceSession openFullyConnectedSession(const MappedModelFile& file, int maxBatch = 1) {
+	file.requireType(ModelType::FullyConnected);
+	return FullyConnectedInferenceSession(mappedDenseLayers(file, file.getConfig(), 0), activationFromId(file.getActivation()), maxBatch);
+}
+
+// 拷贝加载为可继续训练的模型
+inline FullyConnectedNeuralNetwork loadFullyConnected(const MappedModelFile& file) {
+	file.requireType(ModelType::FullyConnected);
+	FullyConnectedNeuralNetwork network(file.getConfig(), activationFromId(file.getActivation()), activationDerivativeFromId(file.getActivation()));
+	network.loadWeights(mappedDenseLayers(file, file.getConfig(), 0));
+	return network;
+}
+
+// ---------------- 卷积神经网络 ----------------
+// config: inputChannels, inputHeight, inputWidth, filterSize, numFilters, poolSize, 全连接部分各层节点数
+// 段: 滤波器，随后为全连接部分
+
+inline void saveModel(const ConvolutionalNeuralNetwork& network, const std::string& path) {
+	const ConvolutionalLayer& layer = network.getConvolutionalLayer();
+	const FullyConnectedNeuralNetwork& tail = network.getFullyConnectedLayer();
+	ModelWriter writer(ModelType::Convolutional, activationToId(tail.getActivation()));
+	writer.addConfig(layer.getInputChannels());
+	writer.addConfig(network.getInputHeight());
+	writer.addConfig(network.getInputWidth());
+	writer.addConfig(layer.getFilterSize());
+	writer.addConfig(layer.getNumFilters());
+	writer.addConfig(network.getPoolingLayer().getPoolSize());
+	
+	for (int size : tail.getLayerSizes()) {
+		writer.addConfig(size);
+	}
+	
+	writer.addSection(layer.getFilters().data(), layer.getFilters().size());
+	writeDenseLayers(writer, tail);
+	writer.write(path);
+}
+
+inline ConvolutionView mappedConvolution(const MappedModelFile& file) {
+	std::vector<int> config = file.getConfig();
+	
+	if (config.size() < 7) {
+		throw std::runtime_error("Model file has an invalid CNN configuration.");
+	}
+	
+	size_t count = static_cast<size_t>(config[4]) * config[0] * config[3] * config[3];
+	return ConvolutionView{config[0], config[1], config[2], config[3], config[4], config[5], file.section(0, count)};
+}
+
+inline ConvolutionalInferenceSession openConvolutionalSession(const MappedModelFile& file, int maxBatch = 1) {
+	file.requireType(ModelType::Convolutional);
+	std::vector<int> config = file.getConfig();
+	std::vector<int> layerSizes(config.begin() + 6, config.end());
+	return ConvolutionalInferenceSession(mappedConvolution(file), mappedDenseLayers(file, layerSizes, 1), activationFromId(file.getActivation()), maxBatch);
+}
+
+inline ConvolutionalNeuralNetwork loadConvolutional(const MappedModelFile& file) {
+	file.requireType(ModelType::Convolutional);
+	std::vector<int> config = file.getConfig();
+	ConvolutionView convolution = mappedConvolution(file);
+	std::vector<int> layerSizes(config.begin() + 6, config.end());
+	// 构造函数的 layerSizes 不含输入层
+	ConvolutionalNeuralNetwork network(config[0], config[3], config[4], config[5], std::vector<int>(layerSizes.begin() + 1, layerSizes.end()), config[1], config[2]);
+	network.loadWeights(convolution.filters, mappedDenseLayers(file, layerSizes, 1));
+	return network;
+}
+
+// ---------------- Transformer ----------------
+// config: input_dim, num_heads, 位置编码方式, 位置向量表长度
+// 段: 编码器 W_q, W_k, W_v, W_o, W_ff1, W_ff2；解码器自注意力 4 段、交叉注意力 4 段、W_ff1, W_ff2；
+//     编码器两个层归一化的 gamma, beta；解码器三个层归一化的 gamma, beta；Learned 时最后是位置向量表
+
+inline void writeLayerNorm(ModelWriter& writer, const LayerNormView& norm, int dim) {
+	writer.addSection(norm.gamma, dim);
+	writer.addSection(norm.beta, dim);
+}
+
+inline LayerNormView mappedLayerNorm(const MappedModelFile& file, int dim, size_t first) {
+	return LayerNormView{file.section(first, dim), file.section(first + 1, dim)};
+}
+
+inline void saveModel(const Transformer& model, const std::string& path) {
+	ModelWriter writer(ModelType::Transformer);
+	EncoderView encoder = model.getEncoder().getView();
+	DecoderView decoder = model.getDecoder().getView();
+	PositionalView positional = model.getPositional();
+	int dim = model.getInputDim();
+	size_t n = static_cast<size_t>(dim) * dim;
+	writer.addConfig(dim);
+	writer.addConfig(model.getNumHeads());
+	writer.addConfig(static_cast<int32_t>(positional.kind));
+	writer.addConfig(positional.maxLength);
+	writeAttention(writer, encoder.attention);
+	writer.addSection(encoder.Wff1, n);
+	writer.addSection(encoder.Wff2, n);
+	writeAttention(writer, decoder.selfAttention);
+	writeAttention(writer, decoder.crossAttention);
+	writer.addSection(decoder.Wff1, n);
+	writer.addSection(decoder.Wff2, n);
+	writeLayerNorm(writer, encoder.norm1, dim);
+	writeLayerNorm(writer, encoder.norm2, dim);
+	writeLayerNorm(writer, decoder.norm1, dim);
+	writeLayerNorm(writer, decoder.norm2, dim);
+	writeLayerNorm(writer, decoder.norm3, dim);
+	
+	if (positional.kind == PositionalEncoding::Learned) {
+		writer.addSection(positional.table, static_cast<size_t>(positional.maxLength) * dim);
+	}
+	
+	writer.write(path);
+}
+
+inline void mappedTransformer(const MappedModelFile& file, EncoderView& encoder, DecoderView& decoder, PositionalView& positional) {
+	file.requireType(ModelType::Transformer);
+	
+	// 版本 1 的 Transformer 没有层归一化，无法按当前结构加载
+	if (file.getVersion() < 2) {
+		throw std::runtime_error("Transformer model file was written by an older version.");
+	}
+	
+	std::vector<int> config = file.getConfig();
+	
+	// dim 必须能被 heads 整除，否则注意力无法按头切分
+	if (config.size() != 4 || config[0] <= 0 || config[1] <= 0 || config[0] % config[1] != 0
+	        || config[2] < 0 || config[2] > static_cast<int>(PositionalEncoding::Learned) || config[3] <= 0) {
+		throw std::runtime_error("Model file has an invalid Transformer configuration.");
+	}
+	
+	int dim = config[0];
+	int heads = config[1];
+	size_t n = static_cast<size_t>(dim) * dim;
+	encoder = EncoderView{mappedAttention(file, dim, heads, 0), file.section(4, n), file.section(5, n),
+	                      mappedLayerNorm(file, dim, 16), mappedLayerNorm(file, dim, 18)};
+	decoder = DecoderView{mappedAttention(file, dim, heads, 6), mappedAttention(file, dim, heads, 10), file.section(14, n), file.section(15, n),
+	                      mappedLayerNorm(file, dim, 20), mappedLayerNorm(file, dim, 22), mappedLayerNorm(file, dim, 24)};
+	positional = PositionalView{static_cast<PositionalEncoding>(config[2]), config[3], nullptr};
+	
+	if (positional.kind == PositionalEncoding::Learned) {
+		positional.table = file.section(26, static_cast<size_t>(config[3]) * dim);
+	}
+}
+
+inline TransformerInferenceSession openTransformerSession(const MappedModelFile& file, int maxSequenceLength) {
+	EncoderView encoder;
+	DecoderView decoder;
+	PositionalView positional;
+	mappedTransformer(file, encoder, decoder, positional);
+	return TransformerInferenceSession(encoder, decoder, positional, maxSequenceLength);
+}
+
+inline Transformer loadTransformer(const MappedModelFile& file) {
+	EncoderView encoder;
+	DecoderView decoder;
+	PositionalView positional;
+	mappedTransformer(file, encoder, decoder, positional);
+	Transformer model(encoder.attention.dim, encoder.attention.heads, positional.kind, positional.maxLength);
+	model.loadWeights(encoder, decoder, positional);
+	return model;
+}
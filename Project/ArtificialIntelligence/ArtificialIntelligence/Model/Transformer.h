@@ -20,114 +20,1088 @@
     SOFTWARE.
 */
 
+#pragma once
+
 #include <iostream>
+#include <algorithm>
 #include "./Public.h"
+#include "./Arena.h"
+#include "./Parallel.h"
+#include "./Batching.h"
+#include <limits>
 
-// 多头注意力机制类
-class MultiHeadAttention {
-	public:
-		MultiHeadAttention(int input_dim, int num_heads) : input_dim(input_dim), num_heads(num_heads) {
-			// 初始化权重
-			W_q = Xavier(input_dim, input_dim); // 使用 Xavier 初始化
-			W_k = Xavier(input_dim, input_dim);
-			W_v = Xavier(input_dim, input_dim);
-			W_o = Xavier(input_dim, input_dim);
+// 多头注意力权重的只读视图（均为 dim x dim 行主序矩阵）
+// 视图既可以指向模型自身的 MatrixXd，也可以指向外部的连续内存；W 为权重的存储类型（double、float 或 bfloat16）
+template<class W>
+struct BasicAttentionView {
+	int dim;
+	int heads;
+	const W* Wq;
+	const W* Wk;
+	const W* Wv;
+	const W* Wo;
+};
+
+// 层归一化参数的只读视图（各 dim 个）
+template<class W>
+struct BasicLayerNormView {
+	const W* gamma;
+	const W* beta;
+};
+
+// 编码器层权重的只读视图（pre-LN：norm1 位于注意力之前，norm2 位于前馈网络之前）
+template<class W>
+struct BasicEncoderView {
+	BasicAttentionView<W> attention;
+	const W* Wff1;
+	const W* Wff2;
+	BasicLayerNormView<W> norm1;
+	BasicLayerNormView<W> norm2;
+};
+
+// 解码器层权重的只读视图（norm1、norm2、norm3 分别位于自注意力、交叉注意力与前馈网络之前）
+template<class W>
+struct BasicDecoderView {
+	BasicAttentionView<W> selfAttention;
+	BasicAttentionView<W> crossAttention;
+	const W* Wff1;
+	const W* Wff2;
+	BasicLayerNormView<W> norm1;
+	BasicLayerNormView<W> norm2;
+	BasicLayerNormView<W> norm3;
+};
+
+// 位置编码方式
+enum class PositionalEncoding {
+	None = 0,
+	Sinusoidal = 1, // 固定的正弦/余弦编码，不限长度
+	Learned = 2 // 可训练的 maxLength x dim 位置向量表
+};
+
+// 位置编码的只读视图，table 只在 Learned 时有效
+template<class W>
+struct BasicPositionalView {
+	PositionalEncoding kind;
+	int maxLength;
+	const W* table;
+};
+
+using AttentionView = BasicAttentionView<double>;
+using LayerNormView = BasicLayerNormView<double>;
+using EncoderView = BasicEncoderView<double>;
+using DecoderView = BasicDecoderView<double>;
+using PositionalView = BasicPositionalView<double>;
+
+// 以下计算函数中 T 为激活值（计算）类型，W 为权重的存储类型：
+// double 训练与推理时两者都是 double；混合精度训练时 T 为 float，W 为 float 或 bfloat16
+
+#define ATTENTION_BLOCK_ROWS 32 // 每次处理的查询行数
+#define ATTENTION_BLOCK_COLS 64 // 每次处理的键/值行数
+#define ATTENTION_PARALLEL_THRESHOLD 65536 // seqQ * seqK * dim 达到该值时各注意力头并行计算
+
+// 单个注意力头分块计算所需的临时空间，与序列长度无关
+inline size_t attentionHeadWorkspace() {
+	return ActivationArena::footprint(ATTENTION_BLOCK_ROWS * ATTENTION_BLOCK_COLS + 2 * ATTENTION_BLOCK_ROWS);
+}
+
+// 注意力前向计算所需的临时空间（以 double 计）：Q、K、V、拼接后的各头输出、每行的 log-sum-exp 以及各头的分块空间
+// 查询有 seqQ 行，键/值有 seqK 行（自注意力时两者相同）
+inline size_t attentionWorkspace(int seqQ, int seqK, int dim, int heads) {
+	size_t query = ActivationArena::footprint(static_cast<size_t>(seqQ) * dim);
+	size_t memory = ActivationArena::footprint(static_cast<size_t>(seqK) * dim);
+	return 2 * query + 2 * memory + ActivationArena::footprint(static_cast<size_t>(heads) * seqQ) + heads * attentionHeadWorkspace();
+}
+
+#define FEED_FORWARD_BLOCK_ROWS 16 // 融合前馈网络每次处理的行数
+
+// 融合前馈网络所需的临时空间：一个行块的隐藏层
+inline size_t feedForwardWorkspace(int dim) {
+	return ActivationArena::footprint(static_cast<size_t>(FEED_FORWARD_BLOCK_ROWS) * dim);
+}
+
+// 编码器层前向计算所需的临时空间：residual1、归一化输出与注意力（或前馈网络）的临时空间
+inline size_t encoderWorkspace(int seq, int dim, int heads) {
+	return 3 * ActivationArena::footprint(static_cast<size_t>(seq) * dim) + std::max(attentionWorkspace(seq, seq, dim, heads), feedForwardWorkspace(dim));
+}
+
+// 解码器层前向计算所需的临时空间，memorySeq 为编码器输出的长度
+inline size_t decoderWorkspace(int seq, int memorySeq, int dim, int heads) {
+	return 4 * ActivationArena::footprint(static_cast<size_t>(seq) * dim)
+	       + std::max(std::max(attentionWorkspace(seq, seq, dim, heads), attentionWorkspace(seq, memorySeq, dim, heads)), feedForwardWorkspace(dim));
+}
+
+// 因果掩码下第 row 个查询在键块 [j0, j0 + cols) 中可见的键数（查询对应最后 seqQ 个位置）
+inline int attentionVisible(bool causal, int row, int j0, int cols, int seqQ, int seqK) {
+	return causal ? std::max(0, std::min(cols, row + seqK - seqQ + 1 - j0)) : cols;
+}
+
+// 编码器层一次前向的浮点运算量估计（剖析用）：rows 为（含填充的）行数，keys 为每个查询参与计算的键数
+inline double encoderLayerFlops(size_t rows, size_t keys, size_t dim) {
+	return attentionFlops(rows, rows, keys, dim) + denseFlops(rows, dim, 2 * dim);
+}
+
+// 解码器层一次前向的浮点运算量估计：自注意力、交叉注意力（memoryRows 行编码器输出，每个查询 memoryKeys 个键）与前馈网络
+inline double decoderLayerFlops(size_t rows, size_t keys, size_t memoryRows, size_t memoryKeys, size_t dim) {
+	return attentionFlops(rows, rows, keys, dim) + attentionFlops(rows, memoryRows, memoryKeys, dim) + denseFlops(rows, dim, 2 * dim);
+}
+
+// 单头缩放点积注意力前向（FlashAttention 风格的分块 + 在线 softmax）
+// Q 有 seqQ 行，K、V 有 seqK 行，行间距均为 stride（多头交错存放时即模型维度）；结果写入 O（行间距 stride）
+// 不物化 seqQ x seqK 的分数矩阵，临时空间只有一个分块；lse 非空时记录每行的 log-sum-exp 供反向传播使用
+// causal 为真时查询视为最后 seqQ 个位置，第 i 行只能看到前 i + seqK - seqQ + 1 个键（增量解码时 seqQ 可以小于 seqK）
+template<class T>
+inline void flashAttentionForward(const T* Q, const T* K, const T* V, int stride, int seqQ, int seqK, int headDim,
+                                  typename KernelScalar<T>::type scale, bool causal, T* O, typename KernelScalar<T>::type* lse, T* work) {
+	T* S = work;
+	T* rowMax = S + ATTENTION_BLOCK_ROWS * ATTENTION_BLOCK_COLS;
+	T* rowSum = rowMax + ATTENTION_BLOCK_ROWS;
+	
+	for (int i0 = 0; i0 < seqQ; i0 += ATTENTION_BLOCK_ROWS) {
+		int rows = std::min(ATTENTION_BLOCK_ROWS, seqQ - i0);
+		
+		for (int r = 0; r < rows; ++r) {
+			rowMax[r] = -std::numeric_limits<T>::infinity();
+			rowSum[r] = 0.0;
+			std::fill(O + static_cast<size_t>(i0 + r) * stride, O + static_cast<size_t>(i0 + r) * stride + headDim, 0.0);
 		}
 		
-		~MultiHeadAttention() {}
+		// 因果掩码下整块都不可见的键块直接跳过
+		int keyEnd = causal ? std::min(seqK, i0 + rows + seqK - seqQ) : seqK;
 		
-		MatrixXd forward(const MatrixXd& input) {
-			// 计算查询、键和值
-			MatrixXd Q = input * W_q;
-			MatrixXd K = input * W_k;
-			MatrixXd V = input * W_v;
-			// 计算注意力分数
-			MatrixXd scores = Q * K.transpose();
-			scores = scores * (1.0 / std::sqrt(input_dim));
-			// 应用 softmax 函数
-			MatrixXd attention_weights = scores;
-			
-			for (int i = 0; i < attention_weights.getRows(); ++i) {
-				double max_val = attention_weights(i, 0);
+		for (int j0 = 0; j0 < keyEnd; j0 += ATTENTION_BLOCK_COLS) {
+			int cols = std::min(ATTENTION_BLOCK_COLS, seqK - j0);
+			
+			// 分块计算分数 S = Q_block * K_block^T * scale
+			for (int r = 0; r < rows; ++r) {
+				const T* q = Q + static_cast<size_t>(i0 + r) * stride;
+				int visible = attentionVisible(causal, i0 + r, j0, cols, seqQ, seqK);
 				
-				for (int j = 1; j < attention_weights.getCols(); ++j) {
-					if (attention_weights(i, j) > max_val) {
-						max_val = attention_weights(i, j);
-					}
+				for (int c = 0; c < visible; ++c) {
+					S[r * ATTENTION_BLOCK_COLS + c] = dot(q, K + static_cast<size_t>(j0 + c) * stride, headDim) * scale;
+				}
+			}
+			
+			// 在线 softmax：用新的行最大值修正已有的累加结果，再累加本块的贡献
+			for (int r = 0; r < rows; ++r) {
+				int visible = attentionVisible(causal, i0 + r, j0, cols, seqQ, seqK);
+				
+				if (visible == 0) {
+					continue;
+				}
+				
+				T* s = S + r * ATTENTION_BLOCK_COLS;
+				T* o = O + static_cast<size_t>(i0 + r) * stride;
+				T blockMax = s[0];
+				
+				for (int c = 1; c < visible; ++c) {
+					blockMax = std::max(blockMax, s[c]);
 				}
 				
-				double sum = 0.0;
+				T newMax = std::max(rowMax[r], blockMax);
+				T correction = static_cast<T>(fastExp(rowMax[r] - newMax));
+				rowSum[r] *= correction;
 				
-				for (int j = 0; j < attention_weights.getCols(); ++j) {
-					attention_weights(i, j) = std::exp(attention_weights(i, j) - max_val);
-					sum += attention_weights(i, j);
+				for (int d = 0; d < headDim; ++d) {
+					o[d] *= correction;
 				}
 				
-				for (int j = 0; j < attention_weights.getCols(); ++j) {
-					attention_weights(i, j) /= sum;
+				for (int c = 0; c < visible; ++c) {
+					s[c] -= newMax;
 				}
+				
+				applyElementwise<ExpActivation>(s, visible);
+				
+				for (int c = 0; c < visible; ++c) {
+					rowSum[r] += s[c];
+					axpy(o, V + static_cast<size_t>(j0 + c) * stride, s[c], headDim);
+				}
+				
+				rowMax[r] = newMax;
+			}
+		}
+		
+		for (int r = 0; r < rows; ++r) {
+			T* o = O + static_cast<size_t>(i0 + r) * stride;
+			T inverse = T(1) / rowSum[r];
+			
+			for (int d = 0; d < headDim; ++d) {
+				o[d] *= inverse;
 			}
 			
-			// 计算加权值
-			MatrixXd output = attention_weights * V;
-			// 应用输出权重矩阵
-			output = output * W_o;
-			return output;
+			if (lse != nullptr) {
+				lse[i0 + r] = rowMax[r] + std::log(rowSum[r]);
+			}
 		}
+	}
+}
+
+// 单头注意力反向（与前向相同的分块方式，用 lse 逐块重算概率，不物化分数矩阵）
+// dO 为输出梯度，结果累加到 dQ、dK、dV（调用方负责清零）；所有矩阵的行间距均为 stride
+template<class T>
+inline void flashAttentionBackward(const T* Q, const T* K, const T* V, const T* O, const T* dO, int stride,
+                                   int seqQ, int seqK, int headDim, typename KernelScalar<T>::type scale, bool causal, const T* lse,
+                                   T* dQ, T* dK, T* dV, T* work) {
+	T* P = work;
+	T* D = P + ATTENTION_BLOCK_ROWS * ATTENTION_BLOCK_COLS;
+	
+	for (int i0 = 0; i0 < seqQ; i0 += ATTENTION_BLOCK_ROWS) {
+		int rows = std::min(ATTENTION_BLOCK_ROWS, seqQ - i0);
 		
-		// 反向传播方法
-		void backward(const MatrixXd& grad_output, const MatrixXd& input, double learning_rate) {
-			MatrixXd Q = input * W_q;
-			MatrixXd K = input * W_k;
-			MatrixXd V = input * W_v;
-			MatrixXd scores = Q * K.transpose();
-			scores = scores * (1.0 / std::sqrt(input_dim));
-			MatrixXd attention_weights = scores;
+		// D_i = dO_i · O_i，即 softmax 反向中的 sum_j P_ij * dP_ij
+		for (int r = 0; r < rows; ++r) {
+			D[r] = dot(dO + static_cast<size_t>(i0 + r) * stride, O + static_cast<size_t>(i0 + r) * stride, headDim);
+		}
+		
+		int keyEnd = causal ? std::min(seqK, i0 + rows + seqK - seqQ) : seqK;
+		
+		for (int j0 = 0; j0 < keyEnd; j0 += ATTENTION_BLOCK_COLS) {
+			int cols = std::min(ATTENTION_BLOCK_COLS, seqK - j0);
 			
-			for (int i = 0; i < attention_weights.getRows(); ++i) {
-				double sum = 0.0;
+			for (int r = 0; r < rows; ++r) {
+				const T* q = Q + static_cast<size_t>(i0 + r) * stride;
+				T* p = P + r * ATTENTION_BLOCK_COLS;
+				int visible = attentionVisible(causal, i0 + r, j0, cols, seqQ, seqK);
 				
-				for (int j = 0; j < attention_weights.getCols(); ++j) {
-					attention_weights(i, j) = std::exp(attention_weights(i, j));
-					sum += attention_weights(i, j);
+				for (int c = 0; c < visible; ++c) {
+					p[c] = dot(q, K + static_cast<size_t>(j0 + c) * stride, headDim) * scale - lse[i0 + r];
 				}
 				
-				for (int j = 0; j < attention_weights.getCols(); ++j) {
-					attention_weights(i, j) /= sum;
+				applyElementwise<ExpActivation>(p, visible);
+			}
+			
+			for (int r = 0; r < rows; ++r) {
+				const T* q = Q + static_cast<size_t>(i0 + r) * stride;
+				const T* dout = dO + static_cast<size_t>(i0 + r) * stride;
+				T* dq = dQ + static_cast<size_t>(i0 + r) * stride;
+				int visible = attentionVisible(causal, i0 + r, j0, cols, seqQ, seqK);
+				
+				for (int c = 0; c < visible; ++c) {
+					T p = P[r * ATTENTION_BLOCK_COLS + c];
+					size_t j = static_cast<size_t>(j0 + c) * stride;
+					// dV_j += P_ij * dO_i；dS_ij = P_ij * (dO_i · V_j - D_i)
+					axpy(dV + j, dout, p, headDim);
+					T ds = p * (dot(dout, V + j, headDim) - D[r]) * scale;
+					axpy(dq, K + j, ds, headDim);
+					axpy(dK + j, q, ds, headDim);
 				}
 			}
+		}
+	}
+}
+
+// 计算全部注意力头：Q、O 按 query 描述的批存放，K、V 按 memory 描述的批存放，每行 dim 列且各头交错存放，
+// 第 h 个头占第 h * headDim 起的 headDim 列；第 b 个序列只使用前 query.valid(b) 行查询与前 memory.valid(b) 行键/值，
+// 填充位置的键被屏蔽，填充位置的查询输出为 0；lse 非空时按 [序列][头][行] 记录 log-sum-exp
+// 计算量足够大时各（序列，头）组合在计算线程池中并行执行（写入互不重叠的区域）
+template<class T, class W>
+inline void attentionHeadsForward(const BasicAttentionView<W>& w, const T* Q, const T* K, const T* V, const SequenceBatch& query,
+                                  const SequenceBatch& memory, bool causal, T* O, typename KernelScalar<T>::type* lse, BasicActivationArena<T>& arena) {
+	int headDim = w.dim / w.heads;
+	T scale = static_cast<T>(1.0 / std::sqrt(headDim));
+	int items = query.batch * w.heads;
+	T* work = arena.allocate(static_cast<size_t>(items) * attentionHeadWorkspace());
+	auto item = [&](int index) {
+		int b = index / w.heads;
+		int h = index % w.heads;
+		int rows = query.valid(b);
+		size_t q0 = static_cast<size_t>(b) * query.length * w.dim + h * headDim;
+		size_t k0 = static_cast<size_t>(b) * memory.length * w.dim + h * headDim;
+		flashAttentionForward(Q + q0, K + k0, V + k0, w.dim, rows, memory.valid(b), headDim, scale, causal, O + q0,
+		                      lse == nullptr ? nullptr : lse + static_cast<size_t>(index) * query.length, work + index * attentionHeadWorkspace());
+		
+		for (int r = rows; r < query.length; ++r) {
+			std::fill(O + q0 + static_cast<size_t>(r) * w.dim, O + q0 + static_cast<size_t>(r) * w.dim + headDim, 0.0);
 			
-			MatrixXd grad_V = attention_weights.transpose() * grad_output;
-			MatrixXd grad_attention_weights = grad_output * V.transpose();
-			MatrixXd grad_scores = grad_attention_weights;
+			if (lse != nullptr) {
+				lse[static_cast<size_t>(index) * query.length + r] = 0.0;
+			}
+		}
+	};
+	
+	if (static_cast<double>(query.rows()) * memory.length * w.dim >= ATTENTION_PARALLEL_THRESHOLD) {
+		parallelFor(items, item);
+	}
+	else {
+		for (int index = 0; index < items; ++index) {
+			item(index);
+		}
+	}
+}
+
+// 全部注意力头的反向传播，布局与并行方式与前向一致；填充位置的梯度保持为 0
+template<class T, class W>
+inline void attentionHeadsBackward(const BasicAttentionView<W>& w, const T* Q, const T* K, const T* V, const T* O, const T* dO,
+                                   const SequenceBatch& query, const SequenceBatch& memory, bool causal, const T* lse,
+                                   T* dQ, T* dK, T* dV, BasicActivationArena<T>& arena) {
+	int headDim = w.dim / w.heads;
+	T scale = static_cast<T>(1.0 / std::sqrt(headDim));
+	int items = query.batch * w.heads;
+	T* work = arena.allocate(static_cast<size_t>(items) * attentionHeadWorkspace());
+	auto item = [&](int index) {
+		int b = index / w.heads;
+		int h = index % w.heads;
+		size_t q0 = static_cast<size_t>(b) * query.length * w.dim + h * headDim;
+		size_t k0 = static_cast<size_t>(b) * memory.length * w.dim + h * headDim;
+		flashAttentionBackward(Q + q0, K + k0, V + k0, O + q0, dO + q0, w.dim, query.valid(b), memory.valid(b), headDim, scale, causal,
+		                       lse + static_cast<size_t>(index) * query.length, dQ + q0, dK + k0, dV + k0, work + index * attentionHeadWorkspace());
+	};
+	
+	if (static_cast<double>(query.rows()) * memory.length * w.dim >= ATTENTION_PARALLEL_THRESHOLD) {
+		parallelFor(items, item);
+	}
+	else {
+		for (int index = 0; index < items; ++index) {
+			item(index);
+		}
+	}
+}
+
+// 注意力前向：查询来自 x（seq 行），键/值来自 memory（memorySeq 行，自注意力时即 x），结果写入 out
+// causal 为真时使用因果掩码；临时空间从 arena 中分配并在返回前归还
+template<class T, class W>
+inline void attentionForward(const BasicAttentionView<W>& w, const T* x, int seq, const T* memory, int memorySeq, bool causal,
+                             T* out, BasicActivationArena<T>& arena) {
+	PROFILE_SCOPE("Attention", ProfilePhase::Forward, attentionFlops(seq, memorySeq, memorySeq, w.dim));
+	size_t position = arena.mark();
+	size_t n = static_cast<size_t>(seq) * w.dim;
+	size_t m = static_cast<size_t>(memorySeq) * w.dim;
+	// 计算查询、键和值
+	T* Q = arena.allocateZeroed(n);
+	T* K = arena.allocateZeroed(m);
+	T* V = arena.allocateZeroed(m);
+	gemm(x, w.Wq, Q, seq, w.dim, w.dim);
+	gemm(memory, w.Wk, K, memorySeq, w.dim, w.dim);
+	gemm(memory, w.Wv, V, memorySeq, w.dim, w.dim);
+	// 各头分别计算 softmax(Q_h * K_h^T / sqrt(headDim)) * V_h，拼接后应用输出权重矩阵
+	T* heads = arena.allocate(n);
+	attentionHeadsForward(w, Q, K, V, singleSequence(seq), singleSequence(memorySeq), causal, heads, nullptr, arena);
+	std::fill(out, out + n, 0.0);
+	gemm(heads, w.Wo, out, seq, w.dim, w.dim);
+	arena.release(position);
+}
+
+#define LAYER_NORM_EPSILON 1e-5
+
+// 层归一化：y = gamma * (x - mean) / sqrt(var + eps) + beta，按行计算
+// stats 非空时按行记录均值与标准差倒数（每行 2 个 double），供反向传播使用
+template<class T, class W>
+inline void layerNorm(const BasicLayerNormView<W>& norm, const T* x, int rows, int dim, T* y, typename KernelScalar<T>::type* stats) {
+	for (int i = 0; i < rows; ++i) {
+		const T* xi = x + static_cast<size_t>(i) * dim;
+		T* yi = y + static_cast<size_t>(i) * dim;
+		T mean = T(0);
+		T variance = T(0);
+		
+		for (int j = 0; j < dim; ++j) {
+			mean += xi[j];
+		}
+		
+		mean /= dim;
+		
+		for (int j = 0; j < dim; ++j) {
+			variance += (xi[j] - mean) * (xi[j] - mean);
+		}
+		
+		T rstd = static_cast<T>(1.0 / std::sqrt(variance / dim + LAYER_NORM_EPSILON));
+		
+		for (int j = 0; j < dim; ++j) {
+			yi[j] = (xi[j] - mean) * rstd * norm.gamma[j] + norm.beta[j];
+		}
+		
+		if (stats != nullptr) {
+			stats[2 * i] = mean;
+			stats[2 * i + 1] = rstd;
+		}
+	}
+}
+
+// 融合的残差相加与层归一化：r = x + a，y = LayerNorm(r)
+// 逐行完成，相加结果仍在缓存中时立即归一化，省去单独一遍对 r 的读取
+template<class T, class W>
+inline void residualLayerNorm(const BasicLayerNormView<W>& norm, const T* x, const T* a, int rows, int dim, T* r, T* y, typename KernelScalar<T>::type* stats) {
+	for (int i = 0; i < rows; ++i) {
+		size_t offset = static_cast<size_t>(i) * dim;
+		
+		for (int j = 0; j < dim; ++j) {
+			r[offset + j] = x[offset + j] + a[offset + j];
+		}
+		
+		layerNorm(norm, r + offset, 1, dim, y + offset, stats == nullptr ? nullptr : stats + 2 * i);
+	}
+}
+
+// 层归一化的反向：dx 为累加写入（便于与残差支路的梯度合并），dGamma、dBeta 同样为累加写入
+template<class T, class W>
+inline void layerNormBackward(const BasicLayerNormView<W>& norm, const T* x, const T* stats, const T* dy, int rows, int dim,
+                              T* dx, T* dGamma, T* dBeta) {
+	for (int i = 0; i < rows; ++i) {
+		const T* xi = x + static_cast<size_t>(i) * dim;
+		const T* dyi = dy + static_cast<size_t>(i) * dim;
+		T* dxi = dx + static_cast<size_t>(i) * dim;
+		T mean = stats[2 * i];
+		T rstd = stats[2 * i + 1];
+		T sum = T(0);
+		T weighted = T(0);
+		
+		for (int j = 0; j < dim; ++j) {
+			T normalized = (xi[j] - mean) * rstd;
+			T g = dyi[j] * norm.gamma[j];
+			dGamma[j] += dyi[j] * normalized;
+			dBeta[j] += dyi[j];
+			sum += g;
+			weighted += g * normalized;
+		}
+		
+		sum /= dim;
+		weighted /= dim;
+		
+		for (int j = 0; j < dim; ++j) {
+			T normalized = (xi[j] - mean) * rstd;
+			dxi[j] += rstd * (dyi[j] * norm.gamma[j] - sum - normalized * weighted);
+		}
+	}
+}
+
+// 融合前馈网络并叠加残差：out = residual + GELU(input * W1) * W2
+// 按 FEED_FORWARD_BLOCK_ROWS 行分块：每块的隐藏层算完后立即在缓存中施加 GELU（GEMM 的尾处理），
+// 随即乘以 W2 累加到以残差为初值的输出上，完整的隐藏层矩阵从不写回内存
+// preactivation 非空时保存 GELU 之前的隐藏层供反向传播使用
+template<class T, class W>
+inline void feedForwardResidual(const W* Wff1, const W* Wff2, int dim, const T* input, const T* residual, int rows,
+                                T* out, typename KernelScalar<T>::type* preactivation, BasicActivationArena<T>& arena) {
+	PROFILE_SCOPE("FeedForward", ProfilePhase::Forward, denseFlops(rows, dim, 2 * dim));
+	size_t position = arena.mark();
+	T* hidden = arena.allocate(static_cast<size_t>(FEED_FORWARD_BLOCK_ROWS) * dim);
+	
+	for (int i0 = 0; i0 < rows; i0 += FEED_FORWARD_BLOCK_ROWS) {
+		int block = std::min(FEED_FORWARD_BLOCK_ROWS, rows - i0);
+		size_t offset = static_cast<size_t>(i0) * dim;
+		size_t count = static_cast<size_t>(block) * dim;
+		std::fill(hidden, hidden + count, 0.0);
+		gemm(input + offset, Wff1, hidden, block, dim, dim);
+		
+		if (preactivation != nullptr) {
+			std::copy(hidden, hidden + count, preactivation + offset);
+		}
+		
+		applyElementwise<GELUActivation>(hidden, count);
+		
+		// 以残差为初值累加第二个矩阵乘积，省去单独的残差相加
+		for (size_t i = 0; i < count; ++i) {
+			out[offset + i] = residual[offset + i];
+		}
+		
+		gemm(hidden, Wff2, out + offset, block, dim, dim);
+	}
+	
+	arena.release(position);
+}
+
+// 在 x 的有效行上叠加位置编码（填充行保持不变）；x 按 batch 描述的方式存放，start 为第一行的位置编号
+template<class T, class W>
+inline void addPositionalEncoding(const BasicPositionalView<W>& p, T* x, const SequenceBatch& batch, int dim, int start = 0) {
+	if (p.kind == PositionalEncoding::None) {
+		return;
+	}
+	
+	for (int b = 0; b < batch.batch; ++b) {
+		for (int t = 0; t < batch.valid(b); ++t) {
+			T* row = x + (static_cast<size_t>(b) * batch.length + t) * dim;
+			int position = start + t;
 			
-			for (int i = 0; i < grad_scores.getRows(); ++i) {
-				double sum = 0.0;
-				
-				for (int j = 0; j < grad_scores.getCols(); ++j) {
-					sum += attention_weights(i, j);
+			if (p.kind == PositionalEncoding::Learned) {
+				if (position >= p.maxLength) {
+					throw std::out_of_range("Sequence is longer than the learned positional table.");
 				}
 				
-				for (int j = 0; j < grad_scores.getCols(); ++j) {
-					grad_scores(i, j) *= attention_weights(i, j) * (1 - attention_weights(i, j));
+				axpy(row, p.table + static_cast<size_t>(position) * dim, 1.0, dim);
+				continue;
+			}
+			
+			// PE(pos, 2i) = sin(pos / 10000^(2i / dim))，PE(pos, 2i + 1) = cos(pos / 10000^(2i / dim))
+			for (int j = 0; j < dim; j += 2) {
+				double angle = position / std::pow(10000.0, static_cast<double>(j) / dim);
+				row[j] += static_cast<T>(std::sin(angle));
+				
+				if (j + 1 < dim) {
+					row[j + 1] += static_cast<T>(std::cos(angle));
 				}
 			}
+		}
+	}
+}
+
+// 编码器层前向（pre-LN）：r1 = x + MHA(LN1(x))，out = r1 + FFN(LN2(r1))
+template<class T, class W>
+inline void encoderLayerForward(const BasicEncoderView<W>& w, const T* x, int seq, T* out, BasicActivationArena<T>& arena) {
+	PROFILE_SCOPE("EncoderLayer", ProfilePhase::Forward, encoderLayerFlops(seq, seq, w.attention.dim));
+	size_t position = arena.mark();
+	int dim = w.attention.dim;
+	size_t n = static_cast<size_t>(seq) * dim;
+	T* normalized = arena.allocate(n);
+	T* attention = arena.allocate(n);
+	T* residual1 = arena.allocate(n);
+	layerNorm(w.norm1, x, seq, dim, normalized, nullptr);
+	attentionForward(w.attention, normalized, seq, normalized, seq, false, attention, arena);
+	residualLayerNorm(w.norm2, x, attention, seq, dim, residual1, normalized, nullptr);
+	feedForwardResidual(w.Wff1, w.Wff2, dim, normalized, residual1, seq, out, nullptr, arena);
+	arena.release(position);
+}
+
+// 解码器层前向（pre-LN）：r1 = x + CausalSelfAttention(LN1(x))，r2 = r1 + CrossAttention(LN2(r1), memory)，out = r2 + FFN(LN3(r2))
+// memory 为编码器输出（memorySeq 行）
+template<class T, class W>
+inline void decoderLayerForward(const BasicDecoderView<W>& w, const T* x, int seq, const T* memory, int memorySeq, T* out, BasicActivationArena<T>& arena) {
+	PROFILE_SCOPE("DecoderLayer", ProfilePhase::Forward, decoderLayerFlops(seq, seq, memorySeq, memorySeq, w.selfAttention.dim));
+	size_t position = arena.mark();
+	int dim = w.selfAttention.dim;
+	size_t n = static_cast<size_t>(seq) * dim;
+	T* normalized = arena.allocate(n);
+	T* attention = arena.allocate(n);
+	T* residual1 = arena.allocate(n);
+	T* residual2 = arena.allocate(n);
+	layerNorm(w.norm1, x, seq, dim, normalized, nullptr);
+	attentionForward(w.selfAttention, normalized, seq, normalized, seq, true, attention, arena);
+	residualLayerNorm(w.norm2, x, attention, seq, dim, residual1, normalized, nullptr);
+	attentionForward(w.crossAttention, normalized, seq, memory, memorySeq, false, attention, arena);
+	residualLayerNorm(w.norm3, residual1, attention, seq, dim, residual2, normalized, nullptr);
+	feedForwardResidual(w.Wff1, w.Wff2, dim, normalized, residual2, seq, out, nullptr, arena);
+	arena.release(position);
+}
+
+// 训练时保存的注意力中间结果，均位于激活带（tape）中，只在一次训练步内有效
+template<class T>
+struct BasicAttentionCache {
+	SequenceBatch query;
+	SequenceBatch memory;
+	bool causal;
+	const T* input; // 查询的输入
+	const T* memoryInput; // 键/值的输入，自注意力时与 input 相同
+	T* Q;
+	T* K;
+	T* V;
+	T* heads; // 拼接后的各头输出
+	T* lse; // 每个序列每个头每行的 log-sum-exp
+};
+
+// 编码器/解码器层训练时保存的中间结果（编码器不使用 norm3、residual2 与 memory）
+// 开启梯度检查点时只记录输入与激活带，其余指针为空，反向传播时再重新计算
+template<class T>
+struct BasicLayerCache {
+	SequenceBatch batch;
+	SequenceBatch memory;
+	const T* input;
+	const T* memoryInput;
+	BasicActivationArena<T>* tape;
+	T* norm[3]; // 各层归一化的输出
+	T* stats[3]; // 各层归一化每行的均值与标准差倒数
+	T* residual1;
+	T* residual2;
+	T* preactivation; // 前馈网络 GELU 之前的隐藏层
+	BasicAttentionCache<T> attention[2]; // 自注意力与交叉注意力（编码器只使用第一个）
+};
+
+using AttentionCache = BasicAttentionCache<double>;
+using LayerCache = BasicLayerCache<double>;
+
+// 一个注意力块保存的中间结果占用的空间（以 double 计）
+inline size_t attentionActivations(const SequenceBatch& query, const SequenceBatch& memory, int dim, int heads) {
+	return 2 * ActivationArena::footprint(static_cast<size_t>(query.rows()) * dim) + 2 * ActivationArena::footprint(static_cast<size_t>(memory.rows()) * dim)
+	       + ActivationArena::footprint(static_cast<size_t>(heads) * query.rows());
+}
+
+// 注意力前向所需的分块空间（每个序列的每个头一份）
+inline size_t attentionHeadsWorkspace(const SequenceBatch& query, int heads) {
+	return static_cast<size_t>(query.batch) * heads * attentionHeadWorkspace();
+}
+
+// 注意力反向传播所需的临时空间：输出梯度、Q/K/V 的梯度以及分块空间
+inline size_t attentionBackwardWorkspace(const SequenceBatch& query, const SequenceBatch& memory, int dim, int heads) {
+	return 2 * ActivationArena::footprint(static_cast<size_t>(query.rows()) * dim) + 2 * ActivationArena::footprint(static_cast<size_t>(memory.rows()) * dim)
+	       + attentionHeadsWorkspace(query, heads);
+}
+
+// 编码器层保存的中间结果：注意力块、两个归一化的输出与统计量、residual1 与前馈隐藏层
+inline size_t encoderActivations(const SequenceBatch& batch, int dim, int heads) {
+	return attentionActivations(batch, batch, dim, heads) + 4 * ActivationArena::footprint(static_cast<size_t>(batch.rows()) * dim)
+	       + 2 * ActivationArena::footprint(2 * static_cast<size_t>(batch.rows()));
+}
+
+// 解码器层保存的中间结果：自注意力块、交叉注意力块、三个归一化的输出与统计量、residual1、residual2 与前馈隐藏层
+inline size_t decoderActivations(const SequenceBatch& batch, const SequenceBatch& memory, int dim, int heads) {
+	return attentionActivations(batch, batch, dim, heads) + attentionActivations(batch, memory, dim, heads)
+	       + 6 * ActivationArena::footprint(static_cast<size_t>(batch.rows()) * dim) + 3 * ActivationArena::footprint(2 * static_cast<size_t>(batch.rows()));
+}
+
+// 注意力前向并保存中间结果：Q、K、V、各头输出与 log-sum-exp 分配在 tape 中，分块空间取自 arena
+// x 按 query 描述的批存放，memory 按 memoryBatch 描述的批存放（两者的 batch 必须相同）
+template<class T, class W>
+inline void attentionForwardSaved(const BasicAttentionView<W>& w, const T* x, const SequenceBatch& query, const T* memory, const SequenceBatch& memoryBatch,
+                                  bool causal, T* out, BasicAttentionCache<T>& cache, BasicActivationArena<T>& tape, BasicActivationArena<T>& arena) {
+	int rows = query.rows();
+	int memoryRows = memoryBatch.rows();
+	PROFILE_SCOPE("Attention", ProfilePhase::Forward, attentionFlops(rows, memoryRows, memoryBatch.length, w.dim));
+	size_t n = static_cast<size_t>(rows) * w.dim;
+	size_t m = static_cast<size_t>(memoryRows) * w.dim;
+	cache = BasicAttentionCache<T> {query, memoryBatch, causal, x, memory, tape.allocateZeroed(n), tape.allocateZeroed(m), tape.allocateZeroed(m),
+	                                tape.allocate(n), tape.allocate(static_cast<size_t>(w.heads) * rows)};
+	gemm(x, w.Wq, cache.Q, rows, w.dim, w.dim);
+	gemm(memory, w.Wk, cache.K, memoryRows, w.dim, w.dim);
+	gemm(memory, w.Wv, cache.V, memoryRows, w.dim, w.dim);
+	size_t position = arena.mark();
+	attentionHeadsForward(w, cache.Q, cache.K, cache.V, query, memoryBatch, causal, cache.heads, cache.lse, arena);
+	arena.release(position);
+	std::fill(out, out + n, 0.0);
+	gemm(cache.heads, w.Wo, out, rows, w.dim, w.dim);
+}
+
+// 由保存的中间结果计算注意力的反向传播，均为覆盖写入：
+// dx 为查询输入的梯度，dMemory 为键/值输入的梯度（自注意力时可与 dx 相同，此时两部分相加），dWq 等为 dim x dim 的权重梯度
+// dOut 的填充行必须为 0，这样填充位置不会对权重梯度产生贡献
+template<class T, class W>
+inline void attentionBackwardSaved(const BasicAttentionView<W>& w, const BasicAttentionCache<T>& cache, const T* dOut, T* dx, T* dMemory,
+                                   T* dWq, T* dWk, T* dWv, T* dWo, BasicActivationArena<T>& arena) {
+	size_t position = arena.mark();
+	int rows = cache.query.rows();
+	int memoryRows = cache.memory.rows();
+	PROFILE_SCOPE("Attention", ProfilePhase::Backward, 2 * attentionFlops(rows, memoryRows, cache.memory.length, w.dim));
+	size_t n = static_cast<size_t>(rows) * w.dim;
+	size_t m = static_cast<size_t>(memoryRows) * w.dim;
+	size_t weights = static_cast<size_t>(w.dim) * w.dim;
+	std::fill(dx, dx + n, 0.0);
+	std::fill(dMemory, dMemory + m, 0.0);
+	std::fill(dWq, dWq + weights, 0.0);
+	std::fill(dWk, dWk + weights, 0.0);
+	std::fill(dWv, dWv + weights, 0.0);
+	std::fill(dWo, dWo + weights, 0.0);
+	// 输出投影的反向
+	T* dHeads = arena.allocateZeroed(n);
+	gemmTransA(cache.heads, dOut, dWo, w.dim, w.dim, rows);
+	gemmTransB(dOut, w.Wo, dHeads, rows, w.dim, w.dim);
+	// 各头注意力的反向
+	T* dQ = arena.allocateZeroed(n);
+	T* dK = arena.allocateZeroed(m);
+	T* dV = arena.allocateZeroed(m);
+	attentionHeadsBackward(w, cache.Q, cache.K, cache.V, cache.heads, dHeads, cache.query, cache.memory, cache.causal, cache.lse, dQ, dK, dV, arena);
+	// 输入投影的反向
+	gemmTransB(dQ, w.Wq, dx, rows, w.dim, w.dim);
+	gemmTransB(dK, w.Wk, dMemory, memoryRows, w.dim, w.dim);
+	gemmTransB(dV, w.Wv, dMemory, memoryRows, w.dim, w.dim);
+	gemmTransA(cache.input, dQ, dWq, w.dim, w.dim, rows);
+	gemmTransA(cache.memoryInput, dK, dWk, w.dim, w.dim, memoryRows);
+	gemmTransA(cache.memoryInput, dV, dWv, w.dim, w.dim, memoryRows);
+	arena.release(position);
+}
+
+// 前馈网络的反向：dInput 为覆盖写入的输入梯度（残差支路的梯度由调用方处理），dW1、dW2 为覆盖写入的权重梯度
+// preactivation 为前向保存的 GELU 之前的隐藏层，GELU 的输出在此重新计算而不保存
+template<class T, class W>
+inline void feedForwardBackward(const W* Wff1, const W* Wff2, int dim, const T* input, const T* preactivation, int rows,
+                                const T* dOut, T* dInput, T* dW1, T* dW2, BasicActivationArena<T>& arena) {
+	PROFILE_SCOPE("FeedForward", ProfilePhase::Backward, 2 * denseFlops(rows, dim, 2 * dim));
+	size_t position = arena.mark();
+	size_t n = static_cast<size_t>(rows) * dim;
+	size_t weights = static_cast<size_t>(dim) * dim;
+	std::fill(dW1, dW1 + weights, 0.0);
+	std::fill(dW2, dW2 + weights, 0.0);
+	std::fill(dInput, dInput + n, 0.0);
+	T* hidden = arena.allocate(n);
+	T* dHidden = arena.allocateZeroed(n);
+	std::copy(preactivation, preactivation + n, hidden);
+	applyElementwise<GELUActivation>(hidden, n);
+	gemmTransA(hidden, dOut, dW2, dim, dim, rows);
+	gemmTransB(dOut, Wff2, dHidden, rows, dim, dim);
+	// GELU 的导数
+	applyElementwiseDerivative<GELUActivation>(preactivation, hidden, n);
+	
+	for (size_t i = 0; i < n; ++i) {
+		dHidden[i] *= hidden[i];
+	}
+	
+	gemmTransA(input, dHidden, dW1, dim, dim, rows);
+	gemmTransB(dHidden, Wff1, dInput, rows, dim, dim);
+	arena.release(position);
+}
+
+// 一个注意力块的权重梯度（均为 dim x dim）
+template<class T>
+struct BasicAttentionGradients {
+	T* dWq;
+	T* dWk;
+	T* dWv;
+	T* dWo;
+};
+
+// 层归一化参数的梯度（各 dim 个）
+template<class T>
+struct BasicLayerNormGradients {
+	T* dGamma;
+	T* dBeta;
+};
+
+// 编码器层的全部权重梯度，布局与 BasicEncoderView 一一对应
+template<class T>
+struct BasicEncoderGradients {
+	BasicAttentionGradients<T> attention;
+	T* dWff1;
+	T* dWff2;
+	BasicLayerNormGradients<T> norm1;
+	BasicLayerNormGradients<T> norm2;
+};
+
+// 解码器层的全部权重梯度，布局与 BasicDecoderView 一一对应
+template<class T>
+struct BasicDecoderGradients {
+	BasicAttentionGradients<T> selfAttention;
+	BasicAttentionGradients<T> crossAttention;
+	T* dWff1;
+	T* dWff2;
+	BasicLayerNormGradients<T> norm1;
+	BasicLayerNormGradients<T> norm2;
+	BasicLayerNormGradients<T> norm3;
+};
+
+// 连续存放的层参数：依次为各注意力块的 Wq、Wk、Wv、Wo，前馈网络的 W1、W2，各层归一化的 gamma、beta
+// 混合精度训练时权重工作副本与梯度都按这一布局连续登记，视图与梯度可以由同一个起始偏移得到
+inline size_t encoderParameterCount(int dim) {
+	return 6 * static_cast<size_t>(dim) * dim + 4 * static_cast<size_t>(dim);
+}
+
+inline size_t decoderParameterCount(int dim) {
+	return 10 * static_cast<size_t>(dim) * dim + 6 * static_cast<size_t>(dim);
+}
+
+template<class W>
+inline BasicEncoderView<W> packedEncoderView(const W* p, int dim, int heads) {
+	size_t n = static_cast<size_t>(dim) * dim;
+	const W* norm = p + 6 * n;
+	return BasicEncoderView<W> {BasicAttentionView<W>{dim, heads, p, p + n, p + 2 * n, p + 3 * n}, p + 4 * n, p + 5 * n,
+	                            BasicLayerNormView<W>{norm, norm + dim}, BasicLayerNormView<W>{norm + 2 * dim, norm + 3 * dim}};
+}
+
+template<class W>
+inline BasicDecoderView<W> packedDecoderView(const W* p, int dim, int heads) {
+	size_t n = static_cast<size_t>(dim) * dim;
+	const W* norm = p + 10 * n;
+	return BasicDecoderView<W> {BasicAttentionView<W>{dim, heads, p, p + n, p + 2 * n, p + 3 * n},
+	                            BasicAttentionView<W>{dim, heads, p + 4 * n, p + 5 * n, p + 6 * n, p + 7 * n}, p + 8 * n, p + 9 * n,
+	                            BasicLayerNormView<W>{norm, norm + dim}, BasicLayerNormView<W>{norm + 2 * dim, norm + 3 * dim},
+	                            BasicLayerNormView<W>{norm + 4 * dim, norm + 5 * dim}};
+}
+
+template<class T>
+inline BasicEncoderGradients<T> packedEncoderGradients(T* p, int dim) {
+	size_t n = static_cast<size_t>(dim) * dim;
+	T* norm = p + 6 * n;
+	return BasicEncoderGradients<T> {BasicAttentionGradients<T>{p, p + n, p + 2 * n, p + 3 * n}, p + 4 * n, p + 5 * n,
+	                                 BasicLayerNormGradients<T>{norm, norm + dim}, BasicLayerNormGradients<T>{norm + 2 * dim, norm + 3 * dim}};
+}
+
+template<class T>
+inline BasicDecoderGradients<T> packedDecoderGradients(T* p, int dim) {
+	size_t n = static_cast<size_t>(dim) * dim;
+	T* norm = p + 10 * n;
+	return BasicDecoderGradients<T> {BasicAttentionGradients<T>{p, p + n, p + 2 * n, p + 3 * n},
+	                                 BasicAttentionGradients<T>{p + 4 * n, p + 5 * n, p + 6 * n, p + 7 * n}, p + 8 * n, p + 9 * n,
+	                                 BasicLayerNormGradients<T>{norm, norm + dim}, BasicLayerNormGradients<T>{norm + 2 * dim, norm + 3 * dim},
+	                                 BasicLayerNormGradients<T>{norm + 4 * dim, norm + 5 * dim}};
+}
+
+// 层前向（保存中间结果）所需的临时空间：注意力的分块空间或前馈网络的行块
+inline size_t layerSaveWorkspace(const SequenceBatch& batch, int dim, int heads) {
+	return std::max(attentionHeadsWorkspace(batch, heads), feedForwardWorkspace(dim));
+}
+
+// 编码器层反向传播所需的临时空间：两个行梯度缓冲，再加注意力或前馈网络反向的临时空间
+inline size_t encoderBackwardWorkspace(const SequenceBatch& batch, int dim, int heads) {
+	size_t n = ActivationArena::footprint(static_cast<size_t>(batch.rows()) * dim);
+	return 2 * n + std::max(attentionBackwardWorkspace(batch, batch, dim, heads), 2 * n);
+}
+
+// 解码器层反向传播所需的临时空间：三个行梯度缓冲，再加注意力或前馈网络反向的临时空间
+inline size_t decoderBackwardWorkspace(const SequenceBatch& batch, const SequenceBatch& memory, int dim, int heads) {
+	size_t n = ActivationArena::footprint(static_cast<size_t>(batch.rows()) * dim);
+	return 3 * n + std::max(std::max(attentionBackwardWorkspace(batch, batch, dim, heads), attentionBackwardWorkspace(batch, memory, dim, heads)), 2 * n);
+}
+
+// 编码器层训练用前向（pre-LN）：中间结果分配在 tape 中并记录到 cache，临时空间取自 scratch（容量至少为 layerSaveWorkspace）
+template<class T, class W>
+inline void encoderLayerSave(const BasicEncoderView<W>& w, const T* x, const SequenceBatch& batch, T* out, BasicLayerCache<T>& cache,
+                             BasicActivationArena<T>& tape, BasicActivationArena<T>& scratch) {
+	int dim = w.attention.dim;
+	int rows = batch.rows();
+	PROFILE_SCOPE("EncoderLayer", ProfilePhase::Forward, encoderLayerFlops(rows, batch.length, dim));
+	size_t n = static_cast<size_t>(rows) * dim;
+	cache = BasicLayerCache<T> {};
+	cache.batch = batch;
+	cache.input = x;
+	cache.tape = &tape;
+	
+	for (int k = 0; k < 2; ++k) {
+		cache.norm[k] = tape.allocate(n);
+		cache.stats[k] = tape.allocate(2 * static_cast<size_t>(rows));
+	}
+	
+	cache.residual1 = tape.allocate(n);
+	cache.preactivation = tape.allocate(n);
+	layerNorm(w.norm1, x, rows, dim, cache.norm[0], cache.stats[0]);
+	// 注意力输出先写入 residual1，再原地与输入相加并归一化
+	attentionForwardSaved(w.attention, cache.norm[0], batch, cache.norm[0], batch, false, cache.residual1, cache.attention[0], tape, scratch);
+	residualLayerNorm(w.norm2, x, cache.residual1, rows, dim, cache.residual1, cache.norm[1], cache.stats[1]);
+	feedForwardResidual(w.Wff1, w.Wff2, dim, cache.norm[1], cache.residual1, rows, out, cache.preactivation, scratch);
+}
+
+// 编码器层的反向传播：使用 encoderLayerSave 保存的中间结果，dX 与全部权重梯度均为覆盖写入
+// dOut 的填充行必须为 0；scratch 的容量至少为 encoderBackwardWorkspace
+template<class T, class W>
+inline void encoderLayerBackward(const BasicEncoderView<W>& w, const BasicLayerCache<T>& cache, const T* dOut, T* dX,
+                                 const BasicEncoderGradients<T>& g, BasicActivationArena<T>& scratch) {
+	size_t position = scratch.mark();
+	int dim = w.attention.dim;
+	int rows = cache.batch.rows();
+	PROFILE_SCOPE("EncoderLayer", ProfilePhase::Backward, 2 * encoderLayerFlops(rows, cache.batch.length, dim));
+	size_t n = static_cast<size_t>(rows) * dim;
+	T* dNorm = scratch.allocate(n);
+	T* dResidual1 = scratch.allocate(n);
+	std::fill(g.norm1.dGamma, g.norm1.dGamma + dim, T(0));
+	std::fill(g.norm1.dBeta, g.norm1.dBeta + dim, T(0));
+	std::fill(g.norm2.dGamma, g.norm2.dGamma + dim, T(0));
+	std::fill(g.norm2.dBeta, g.norm2.dBeta + dim, T(0));
+	// out = r1 + FFN(LN2(r1))
+	feedForwardBackward(w.Wff1, w.Wff2, dim, cache.norm[1], cache.preactivation, rows, dOut, dNorm, g.dWff1, g.dWff2, scratch);
+	std::copy(dOut, dOut + n, dResidual1);
+	layerNormBackward(w.norm2, cache.residual1, cache.stats[1], dNorm, rows, dim, dResidual1, g.norm2.dGamma, g.norm2.dBeta);
+	// r1 = x + MHA(LN1(x))
+	const BasicAttentionGradients<T>& a = g.attention;
+	attentionBackwardSaved(w.attention, cache.attention[0], dResidual1, dNorm, dNorm, a.dWq, a.dWk, a.dWv, a.dWo, scratch);
+	std::copy(dResidual1, dResidual1 + n, dX);
+	layerNormBackward(w.norm1, cache.input, cache.stats[0], dNorm, rows, dim, dX, g.norm1.dGamma, g.norm1.dBeta);
+	scratch.release(position);
+}
+
+// 解码器层训练用前向（pre-LN），memory 为编码器输出（按 memoryBatch 描述的方式存放）
+template<class T, class W>
+inline void decoderLayerSave(const BasicDecoderView<W>& w, const T* x, const SequenceBatch& batch, const T* memory, const SequenceBatch& memoryBatch,
+                             T* out, BasicLayerCache<T>& cache, BasicActivationArena<T>& tape, BasicActivationArena<T>& scratch) {
+	int dim = w.selfAttention.dim;
+	int rows = batch.rows();
+	PROFILE_SCOPE("DecoderLayer", ProfilePhase::Forward, decoderLayerFlops(rows, batch.length, memoryBatch.rows(), memoryBatch.length, dim));
+	size_t n = static_cast<size_t>(rows) * dim;
+	cache = BasicLayerCache<T> {};
+	cache.batch = batch;
+	cache.memory = memoryBatch;
+	cache.input = x;
+	cache.memoryInput = memory;
+	cache.tape = &tape;
+	
+	for (int k = 0; k < 3; ++k) {
+		cache.norm[k] = tape.allocate(n);
+		cache.stats[k] = tape.allocate(2 * static_cast<size_t>(rows));
+	}
+	
+	cache.residual1 = tape.allocate(n);
+	cache.residual2 = tape.allocate(n);
+	cache.preactivation = tape.allocate(n);
+	layerNorm(w.norm1, x, rows, dim, cache.norm[0], cache.stats[0]);
+	// 自注意力使用因果掩码，交叉注意力的键/值来自编码器输出；注意力输出先写入残差缓冲再原地相加
+	attentionForwardSaved(w.selfAttention, cache.norm[0], batch, cache.norm[0], batch, true, cache.residual1, cache.attention[0], tape, scratch);
+	residualLayerNorm(w.norm2, x, cache.residual1, rows, dim, cache.residual1, cache.norm[1], cache.stats[1]);
+	attentionForwardSaved(w.crossAttention, cache.norm[1], batch, memory, memoryBatch, false, cache.residual2, cache.attention[1], tape, scratch);
+	residualLayerNorm(w.norm3, cache.residual1, cache.residual2, rows, dim, cache.residual2, cache.norm[2], cache.stats[2]);
+	feedForwardResidual(w.Wff1, w.Wff2, dim, cache.norm[2], cache.residual2, rows, out, cache.preactivation, scratch);
+}
+
+// 解码器层的反向传播：dX 为输入的梯度，dMemory 为编码器输出的梯度，与全部权重梯度一样为覆盖写入
+template<class T, class W>
+inline void decoderLayerBackward(const BasicDecoderView<W>& w, const BasicLayerCache<T>& cache, const T* dOut, T* dX, T* dMemory,
+                                 const BasicDecoderGradients<T>& g, BasicActivationArena<T>& scratch) {
+	size_t position = scratch.mark();
+	int dim = w.selfAttention.dim;
+	int rows = cache.batch.rows();
+	PROFILE_SCOPE("DecoderLayer", ProfilePhase::Backward, 2 * decoderLayerFlops(rows, cache.batch.length, cache.memory.rows(), cache.memory.length, dim));
+	size_t n = static_cast<size_t>(rows) * dim;
+	T* dNorm = scratch.allocate(n);
+	T* dResidual2 = scratch.allocate(n);
+	T* dResidual1 = scratch.allocate(n);
+	
+	for (const BasicLayerNormGradients<T>& norm : {g.norm1, g.norm2, g.norm3}) {
+		std::fill(norm.dGamma, norm.dGamma + dim, T(0));
+		std::fill(norm.dBeta, norm.dBeta + dim, T(0));
+	}
+	
+	// out = r2 + FFN(LN3(r2))
+	feedForwardBackward(w.Wff1, w.Wff2, dim, cache.norm[2], cache.preactivation, rows, dOut, dNorm, g.dWff1, g.dWff2, scratch);
+	std::copy(dOut, dOut + n, dResidual2);
+	layerNormBackward(w.norm3, cache.residual2, cache.stats[2], dNorm, rows, dim, dResidual2, g.norm3.dGamma, g.norm3.dBeta);
+	// r2 = r1 + CrossAttention(LN2(r1), memory)：键/值支路的梯度流向编码器输出
+	const BasicAttentionGradients<T>& cross = g.crossAttention;
+	attentionBackwardSaved(w.crossAttention, cache.attention[1], dResidual2, dNorm, dMemory, cross.dWq, cross.dWk, cross.dWv, cross.dWo, scratch);
+	std::copy(dResidual2, dResidual2 + n, dResidual1);
+	layerNormBackward(w.norm2, cache.residual1, cache.stats[1], dNorm, rows, dim, dResidual1, g.norm2.dGamma, g.norm2.dBeta);
+	// r1 = x + CausalSelfAttention(LN1(x))
+	const BasicAttentionGradients<T>& self = g.selfAttention;
+	attentionBackwardSaved(w.selfAttention, cache.attention[0], dResidual1, dNorm, dNorm, self.dWq, self.dWk, self.dWv, self.dWo, scratch);
+	std::copy(dResidual1, dResidual1 + n, dX);
+	layerNormBackward(w.norm1, cache.input, cache.stats[0], dNorm, rows, dim, dX, g.norm1.dGamma, g.norm1.dBeta);
+	scratch.release(position);
+}
+
+#define TRANSFORMER_CLIP_NORM 5.0 // Transformer 各权重矩阵（向量）梯度的裁剪范数
+
+// 层归一化的参数：gamma 初始化为 1，beta 初始化为 0
+class LayerNorm {
+	public:
+		LayerNorm(int dim) : gamma(1, dim), beta(1, dim) {
+			for (int j = 0; j < dim; ++j) {
+				gamma(0, j) = 1.0;
+			}
+		}
+		
+		~LayerNorm() {}
+		
+		LayerNormView getView() const {
+			return LayerNormView{gamma.data(), beta.data()};
+		}
+		
+		void loadWeights(const LayerNormView& w) {
+			std::copy(w.gamma, w.gamma + gamma.getCols(), gamma.data());
+			std::copy(w.beta, w.beta + beta.getCols(), beta.data());
+		}
+		
+		// 与其它权重一样裁剪梯度后更新
+		void update(const BasicLayerNormGradients<double>& g, double learning_rate) {
+			applyClippedGradient(gamma.data(), g.dGamma, gamma.getCols(), 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(beta.data(), g.dBeta, beta.getCols(), 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+		}
+		
+		// 把 gamma、beta 依次登记到混合精度参数中，各自单独裁剪
+		void bindParameters(MixedPrecisionParameters& registry) {
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(gamma.data(), gamma.getCols());
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(beta.data(), beta.getCols());
+		}
+		
+	private:
+		MatrixXd gamma;
+		MatrixXd beta;
+};
+
+// 多头注意力机制类
+class MultiHeadAttention {
+	public:
+		MultiHeadAttention(int input_dim, int num_heads) : input_dim(input_dim), num_heads(num_heads) {
+			if (num_heads <= 0 || input_dim % num_heads != 0) {
+				throw std::invalid_argument("input_dim must be divisible by num_heads.");
+			}
+			
+			// 初始化权重
+			W_q = Xavier(input_dim, input_dim); // 使用 Xavier 初始化
+			W_k = Xavier(input_dim, input_dim);
+			W_v = Xavier(input_dim, input_dim);
+			W_o = Xavier(input_dim, input_dim);
+		}
+		
+		~MultiHeadAttention() {}
+		
+		MatrixXd forward(const MatrixXd& input) {
+			MatrixXd output(input.getRows(), input_dim);
+			scratch.reserve(attentionWorkspace(input.getRows(), input.getRows(), input_dim, num_heads));
+			scratch.reset();
+			attentionForward(getView(), input.data(), input.getRows(), input.data(), input.getRows(), false, output.data(), scratch);
+			return output;
+		}
+		
+		// 获取权重的只读视图
+		AttentionView getView() const {
+			return AttentionView{input_dim, num_heads, W_q.data(), W_k.data(), W_v.data(), W_o.data()};
+		}
+		
+		// 从权重视图拷贝权重（维度需与当前模型一致）
+		void loadWeights(const AttentionView& w) {
+			if (w.dim != input_dim) {
+				throw std::invalid_argument("Attention dimension does not match.");
+			}
+			
+			size_t n = static_cast<size_t>(input_dim) * input_dim;
+			std::copy(w.Wq, w.Wq + n, W_q.data());
+			std::copy(w.Wk, w.Wk + n, W_k.data());
+			std::copy(w.Wv, w.Wv + n, W_v.data());
+			std::copy(w.Wo, w.Wo + n, W_o.data());
+		}
+		
+		// 训练用前向：把反向传播所需的中间结果保存在 tape 中，随后的 backward 不再重新计算
+		MatrixXd forward(const MatrixXd& input, ActivationArena& tape) {
+			MatrixXd output(input.getRows(), input_dim);
+			SequenceBatch batch = singleSequence(input.getRows());
+			forward(input.data(), batch, input.data(), batch, false, output.data(), tape);
+			return output;
+		}
+		
+		// 训练用前向（指针版本）：查询来自 input，键/值来自 memory（自注意力时两者相同），
+		// 两者与批描述中的长度数组须在 backward 之前保持有效
+		void forward(const double* input, const SequenceBatch& batch, const double* memory, const SequenceBatch& memoryBatch, bool causal,
+		             double* output, ActivationArena& tape) {
+			scratch.reserve(attentionHeadsWorkspace(batch, num_heads));
+			scratch.reset();
+			attentionForwardSaved(getView(), input, batch, memory, memoryBatch, causal, output, cache, tape, scratch);
+		}
+		
+		// 反向传播方法，返回损失对输入的梯度
+		// 若之前以同一输入调用过训练用前向则直接使用保存的中间结果，否则先重新计算
+		MatrixXd backward(const MatrixXd& grad_output, const MatrixXd& input, double learning_rate) {
+			int seq = input.getRows();
+			SequenceBatch batch = singleSequence(seq);
+			
+			if (cache.input != input.data() || cache.memoryInput != input.data() || !sameBatch(cache.query, batch)) {
+				size_t n = static_cast<size_t>(seq) * input_dim;
+				activations.reserve(attentionActivations(batch, batch, input_dim, num_heads) + ActivationArena::footprint(n));
+				activations.reset();
+				forward(input.data(), batch, input.data(), batch, false, activations.allocate(n), activations);
+			}
 			
-			grad_scores = grad_scores * (1.0 / std::sqrt(input_dim));
-			MatrixXd grad_Q = grad_scores * K;
-			MatrixXd grad_K = grad_scores.transpose() * Q;
-			MatrixXd grad_W_q = input.transpose() * grad_Q;
-			MatrixXd grad_W_k = input.transpose() * grad_K;
-			MatrixXd grad_W_v = input.transpose() * grad_V;
-			MatrixXd grad_W_o = (attention_weights * V).transpose() * grad_output;
-			MatrixXd grad_W_q_clipped = grad_W_q.clipGradient(5.0);
-			MatrixXd grad_W_k_clipped = grad_W_k.clipGradient(5.0);
-			MatrixXd grad_W_v_clipped = grad_W_v.clipGradient(5.0);
-			MatrixXd grad_W_o_clipped = grad_W_o.clipGradient(5.0);
-			W_q -= learning_rate * grad_W_q_clipped;
-			W_k -= learning_rate * grad_W_k_clipped;
-			W_v -= learning_rate * grad_W_v_clipped;
-			W_o -= learning_rate * grad_W_o_clipped;
+			MatrixXd grad_input(seq, input_dim);
+			backward(grad_output.data(), grad_input.data(), grad_input.data(), learning_rate);
+			return grad_input;
+		}
+		
+		// 反向传播（指针版本）：使用最近一次训练用前向保存的中间结果
+		// grad_input、grad_memory 为覆盖写入，自注意力时可传入同一块内存
+		void backward(const double* grad_output, double* grad_input, double* grad_memory, double learning_rate) {
+			if (cache.input == nullptr) {
+				throw std::logic_error("MultiHeadAttention::backward requires a saved forward pass.");
+			}
+			
+			MatrixXd grad_W_q(input_dim, input_dim);
+			MatrixXd grad_W_k(input_dim, input_dim);
+			MatrixXd grad_W_v(input_dim, input_dim);
+			MatrixXd grad_W_o(input_dim, input_dim);
+			scratch.reserve(attentionBackwardWorkspace(cache.query, cache.memory, input_dim, num_heads));
+			scratch.reset();
+			attentionBackwardSaved(getView(), cache, grad_output, grad_input, grad_memory, grad_W_q.data(), grad_W_k.data(), grad_W_v.data(), grad_W_o.data(), scratch);
+			// 中间结果只对应更新前的权重，使用一次后作废
+			cache = AttentionCache{};
+			PROFILE_SCOPE("MultiHeadAttention", ProfilePhase::Update, 0.0);
+			update(BasicAttentionGradients<double> {grad_W_q.data(), grad_W_k.data(), grad_W_v.data(), grad_W_o.data()}, learning_rate);
+		}
+		
+		// 各权重矩阵的梯度分别裁剪后更新
+		void update(const BasicAttentionGradients<double>& g, double learning_rate) {
+			size_t n = static_cast<size_t>(input_dim) * input_dim;
+			applyClippedGradient(W_q.data(), g.dWq, n, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(W_k.data(), g.dWk, n, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(W_v.data(), g.dWv, n, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(W_o.data(), g.dWo, n, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+		}
+		
+		// 把 Wq、Wk、Wv、Wo 依次登记到混合精度参数中，每个矩阵单独裁剪
+		void bindParameters(MixedPrecisionParameters& registry) {
+			size_t n = static_cast<size_t>(input_dim) * input_dim;
+			
+			for (MatrixXd* w : {&W_q, &W_k, &W_v, &W_o}) {
+				registry.beginGroup(TRANSFORMER_CLIP_NORM);
+				registry.add(w->data(), n);
+			}
 		}
 		
 	private:
@@ -137,173 +1111,306 @@ class MultiHeadAttention {
 		MatrixXd W_k;
 		MatrixXd W_v;
 		MatrixXd W_o;
+		AttentionCache cache = AttentionCache{}; // 训练用前向保存的中间结果
+		ActivationArena activations; // 没有保存中间结果时重新计算所用的空间
+		ActivationArena scratch; // 前向计算的临时空间，容量足够后不再分配
 };
 
 // 编码器层类
 class EncoderLayer {
 	public:
-		EncoderLayer(int input_dim, int num_heads) : mha(input_dim, num_heads) {
+		EncoderLayer(int input_dim, int num_heads) : mha(input_dim, num_heads), norm1(input_dim), norm2(input_dim) {
 			// 初始化前馈网络的权重矩阵
-			W_ff1 = MatrixXd(input_dim, input_dim);
-			W_ff2 = MatrixXd(input_dim, input_dim);
-			
-			// 随机初始化矩阵元素
-			for (int i = 0; i < input_dim; ++i) {
-				for (int j = 0; j < input_dim; ++j) {
-					W_ff1(i, j) = (double)rand() / RAND_MAX;
-					W_ff2(i, j) = (double)rand() / RAND_MAX;
-				}
-			}
+			W_ff1 = Xavier(input_dim, input_dim);
+			W_ff2 = Xavier(input_dim, input_dim);
 		}
 		
 		~EncoderLayer() {}
 		
 		MatrixXd forward(const MatrixXd& input) {
-			// 多头注意力机制
-			MatrixXd mha_output = mha.forward(input);
-			// 残差连接
-			MatrixXd residual1 = input + mha_output;
-			// 前馈网络
-			MatrixXd ff_output = residual1 * W_ff1;
-			
-			// ReLU 激活函数
-			for (int i = 0; i < ff_output.getRows(); ++i) {
-				for (int j = 0; j < ff_output.getCols(); ++j) {
-					ff_output(i, j) = std::max(0.0, ff_output(i, j));
-				}
+			MatrixXd output(input.getRows(), input.getCols());
+			scratch.reserve(encoderWorkspace(input.getRows(), input.getCols(), mha.getView().heads));
+			scratch.reset();
+			encoderLayerForward(getView(), input.data(), input.getRows(), output.data(), scratch);
+			return output;
+		}
+		
+		// 获取权重的只读视图
+		EncoderView getView() const {
+			return EncoderView{mha.getView(), W_ff1.data(), W_ff2.data(), norm1.getView(), norm2.getView()};
+		}
+		
+		// 从权重视图拷贝权重
+		void loadWeights(const EncoderView& w) {
+			mha.loadWeights(w.attention);
+			size_t n = static_cast<size_t>(W_ff1.getRows()) * W_ff1.getCols();
+			std::copy(w.Wff1, w.Wff1 + n, W_ff1.data());
+			std::copy(w.Wff2, w.Wff2 + n, W_ff2.data());
+			norm1.loadWeights(w.norm1);
+			norm2.loadWeights(w.norm2);
+		}
+		
+		// 按 packedEncoderView 的布局把全部权重登记到混合精度参数中，返回起始偏移
+		size_t bindParameters(MixedPrecisionParameters& registry) {
+			size_t first = registry.size();
+			size_t n = static_cast<size_t>(W_ff1.getRows()) * W_ff1.getCols();
+			mha.bindParameters(registry);
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(W_ff1.data(), n);
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(W_ff2.data(), n);
+			norm1.bindParameters(registry);
+			norm2.bindParameters(registry);
+			return first;
+		}
+		
+		// 训练用前向：把中间结果保存在 tape 中；开启梯度检查点时只记录输入，反向传播时再在 tape 上重新计算
+		MatrixXd forward(const MatrixXd& input, ActivationArena& tape) {
+			return forward(input, singleSequence(input.getRows()), tape);
+		}
+		
+		// 批量训练用前向：input 按 batch 描述的方式存放（batch.rows() 行），填充行应为 0
+		MatrixXd forward(const MatrixXd& input, const SequenceBatch& batch, ActivationArena& tape) {
+			MatrixXd output(input.getRows(), input.getCols());
+			
+			if (checkpointing) {
+				// 只借用激活带完成本层计算，中间结果随即丢弃
+				size_t position = tape.mark();
+				save(input.data(), batch, output.data(), tape);
+				tape.release(position);
+				cache = LayerCache{};
+				cache.batch = batch;
+				cache.input = input.data();
+				cache.tape = &tape;
+				return output;
 			}
 			
-			ff_output = ff_output * W_ff2;
-			// 残差连接
-			MatrixXd output = residual1 + ff_output;
+			save(input.data(), batch, output.data(), tape);
 			return output;
 		}
 		
-		// 反向传播方法
-		void backward(const MatrixXd& grad_output, const MatrixXd& input, double learning_rate) {
-			MatrixXd mha_output = mha.forward(input);
-			MatrixXd residual1 = input + mha_output;
-			MatrixXd ff_output = residual1 * W_ff1;
+		// 是否开启梯度检查点：以一次重新计算换取不在前向与反向之间保留本层的中间结果
+		void setCheckpointing(bool enabled) {
+			checkpointing = enabled;
+		}
+		
+		bool getCheckpointing() const {
+			return checkpointing;
+		}
+		
+		// 反向传播方法，返回损失对输入的梯度
+		MatrixXd backward(const MatrixXd& grad_output, const MatrixXd& input, double learning_rate) {
+			return backward(grad_output, input, singleSequence(input.getRows()), learning_rate);
+		}
+		
+		// 批量反向传播：grad_output 的填充行必须为 0
+		MatrixXd backward(const MatrixXd& grad_output, const MatrixXd& input, const SequenceBatch& batch, double learning_rate) {
+			int dim = input.getCols();
+			int rows = batch.rows();
+			size_t n = static_cast<size_t>(rows) * dim;
 			
-			for (int i = 0; i < ff_output.getRows(); ++i) {
-				for (int j = 0; j < ff_output.getCols(); ++j) {
-					ff_output(i, j) = std::max(0.0, ff_output(i, j));
-				}
+			if (input.getRows() != rows || grad_output.getRows() != rows || grad_output.getCols() != dim) {
+				throw std::invalid_argument("Matrix dimensions must match for backward.");
 			}
 			
-			ff_output = ff_output * W_ff2;
-			MatrixXd grad_ff_output = grad_output;
-			MatrixXd grad_ff2 = ff_output.transpose() * grad_ff_output;
-			MatrixXd grad_ff1_output = grad_ff_output * W_ff2.transpose();
+			// 没有保存的中间结果时在激活带上重新计算，结束后归还
+			bool matched = cache.input == input.data() && sameBatch(cache.batch, batch);
+			ActivationArena* tape = matched ? cache.tape : &activations;
+			size_t position = tape->mark();
 			
-			for (int i = 0; i < grad_ff1_output.getRows(); ++i) {
-				for (int j = 0; j < grad_ff1_output.getCols(); ++j) {
-					if (ff_output(i, j) <= 0) {
-						grad_ff1_output(i, j) = 0;
-					}
-				}
+			if (!matched) {
+				activations.reserve(encoderActivations(batch, dim, mha.getView().heads) + ActivationArena::footprint(n));
+				activations.reset();
+				position = 0;
 			}
 			
-			MatrixXd grad_ff1 = residual1.transpose() * grad_ff1_output;
-			MatrixXd grad_residual1 = grad_ff1_output * W_ff1.transpose() + grad_output;
-			MatrixXd grad_mha_output = grad_residual1;
-			MatrixXd grad_input = grad_residual1;
-			mha.backward(grad_mha_output, input, learning_rate);
-			W_ff1 -= learning_rate * grad_ff1;
-			W_ff2 -= learning_rate * grad_ff2;
+			if (!matched || cache.preactivation == nullptr) {
+				save(input.data(), batch, tape->allocate(n), *tape);
+			}
+			
+			// 全部权重梯度按连续布局放在临时空间中，反向传播结束后逐矩阵裁剪并更新
+			MatrixXd grad_input(rows, dim);
+			size_t parameters = encoderParameterCount(dim);
+			scratch.reserve(ActivationArena::footprint(parameters) + encoderBackwardWorkspace(batch, dim, mha.getView().heads));
+			scratch.reset();
+			BasicEncoderGradients<double> gradients = packedEncoderGradients(scratch.allocate(parameters), dim);
+			encoderLayerBackward(getView(), cache, grad_output.data(), grad_input.data(), gradients, scratch);
+			tape->release(position);
+			cache = LayerCache{};
+			PROFILE_SCOPE("EncoderLayer", ProfilePhase::Update, 0.0);
+			mha.update(gradients.attention, learning_rate);
+			applyClippedGradient(W_ff1.data(), gradients.dWff1, static_cast<size_t>(dim) * dim, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(W_ff2.data(), gradients.dWff2, static_cast<size_t>(dim) * dim, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			norm1.update(gradients.norm1, learning_rate);
+			norm2.update(gradients.norm2, learning_rate);
+			return grad_input;
 		}
 		
 	private:
 		MultiHeadAttention mha;
 		MatrixXd W_ff1;
 		MatrixXd W_ff2;
+		LayerNorm norm1;
+		LayerNorm norm2;
+		ActivationArena scratch;
+		ActivationArena activations; // 没有保存中间结果时重新计算所用的空间
+		LayerCache cache = LayerCache{};
+		bool checkpointing = false;
+		
+		// 前向并把中间结果保存到 tape 中
+		void save(const double* x, const SequenceBatch& batch, double* out, ActivationArena& tape) {
+			scratch.reserve(layerSaveWorkspace(batch, W_ff1.getRows(), mha.getView().heads));
+			scratch.reset();
+			encoderLayerSave(getView(), x, batch, out, cache, tape, scratch);
+		}
 };
 
 // 解码器层类
 class DecoderLayer {
 	public:
-		DecoderLayer(int input_dim, int num_heads) : mha_self(input_dim, num_heads), mha_cross(input_dim, num_heads) {
+		DecoderLayer(int input_dim, int num_heads)
+			: mha_self(input_dim, num_heads), mha_cross(input_dim, num_heads), norm1(input_dim), norm2(input_dim), norm3(input_dim) {
 			// 初始化前馈网络的权重矩阵
-			W_ff1 = MatrixXd(input_dim, input_dim);
-			W_ff2 = MatrixXd(input_dim, input_dim);
-			
-			// 随机初始化矩阵元素
-			for (int i = 0; i < input_dim; ++i) {
-				for (int j = 0; j < input_dim; ++j) {
-					W_ff1(i, j) = (double)rand() / RAND_MAX;
-					W_ff2(i, j) = (double)rand() / RAND_MAX;
-				}
-			}
+			W_ff1 = Xavier(input_dim, input_dim);
+			W_ff2 = Xavier(input_dim, input_dim);
 		}
 		
 		~DecoderLayer() {}
 		
 		// DecoderLayer 类中的 forward 方法
 		MatrixXd forward(const MatrixXd& input, const MatrixXd& encoder_output) {
-			// 自注意力机制
-			MatrixXd mha_self_output = mha_self.forward(input);
-			// 残差连接
-			MatrixXd residual1 = input + mha_self_output;
-			// 交叉注意力机制（使用编码器输出）
-			MatrixXd mha_cross_output = mha_cross.forward(residual1);
-			// 残差连接
-			MatrixXd residual2 = residual1 + mha_cross_output;
-			// 前馈网络
-			MatrixXd ff_output = residual2 * W_ff1;
-			
-			// ReLU 激活函数
-			for (int i = 0; i < ff_output.getRows(); ++i) {
-				for (int j = 0; j < ff_output.getCols(); ++j) {
-					ff_output(i, j) = std::max(0.0, ff_output(i, j));
-				}
+			MatrixXd output(input.getRows(), input.getCols());
+			scratch.reserve(decoderWorkspace(input.getRows(), encoder_output.getRows(), input.getCols(), mha_self.getView().heads));
+			scratch.reset();
+			decoderLayerForward(getView(), input.data(), input.getRows(), encoder_output.data(), encoder_output.getRows(), output.data(), scratch);
+			return output;
+		}
+		
+		// 获取权重的只读视图
+		DecoderView getView() const {
+			return DecoderView{mha_self.getView(), mha_cross.getView(), W_ff1.data(), W_ff2.data(), norm1.getView(), norm2.getView(), norm3.getView()};
+		}
+		
+		// 从权重视图拷贝权重
+		void loadWeights(const DecoderView& w) {
+			mha_self.loadWeights(w.selfAttention);
+			mha_cross.loadWeights(w.crossAttention);
+			size_t n = static_cast<size_t>(W_ff1.getRows()) * W_ff1.getCols();
+			std::copy(w.Wff1, w.Wff1 + n, W_ff1.data());
+			std::copy(w.Wff2, w.Wff2 + n, W_ff2.data());
+			norm1.loadWeights(w.norm1);
+			norm2.loadWeights(w.norm2);
+			norm3.loadWeights(w.norm3);
+		}
+		
+		// 按 packedDecoderView 的布局把全部权重登记到混合精度参数中，返回起始偏移
+		size_t bindParameters(MixedPrecisionParameters& registry) {
+			size_t first = registry.size();
+			size_t n = static_cast<size_t>(W_ff1.getRows()) * W_ff1.getCols();
+			mha_self.bindParameters(registry);
+			mha_cross.bindParameters(registry);
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(W_ff1.data(), n);
+			registry.beginGroup(TRANSFORMER_CLIP_NORM);
+			registry.add(W_ff2.data(), n);
+			norm1.bindParameters(registry);
+			norm2.bindParameters(registry);
+			norm3.bindParameters(registry);
+			return first;
+		}
+		
+		// 训练用前向：与 EncoderLayer::forward(input, tape) 相同的保存与检查点策略
+		MatrixXd forward(const MatrixXd& input, const MatrixXd& encoder_output, ActivationArena& tape) {
+			return forward(input, singleSequence(input.getRows()), encoder_output, singleSequence(encoder_output.getRows()), tape);
+		}
+		
+		// 批量训练用前向：input 与 encoder_output 分别按 batch 与 memory 描述的方式存放，两者的 batch 必须相同
+		MatrixXd forward(const MatrixXd& input, const SequenceBatch& batch, const MatrixXd& encoder_output, const SequenceBatch& memory, ActivationArena& tape) {
+			if (batch.batch != memory.batch || input.getRows() != batch.rows() || encoder_output.getRows() != memory.rows()) {
+				throw std::invalid_argument("Decoder and encoder batches do not match.");
 			}
 			
-			ff_output = ff_output * W_ff2;
-			// 残差连接
-			MatrixXd output = residual2 + ff_output;
+			MatrixXd output(input.getRows(), input.getCols());
+			
+			if (checkpointing) {
+				size_t position = tape.mark();
+				save(input.data(), batch, encoder_output.data(), memory, output.data(), tape);
+				tape.release(position);
+				cache = LayerCache{};
+				cache.batch = batch;
+				cache.memory = memory;
+				cache.input = input.data();
+				cache.memoryInput = encoder_output.data();
+				cache.tape = &tape;
+				return output;
+			}
+			
+			save(input.data(), batch, encoder_output.data(), memory, output.data(), tape);
 			return output;
 		}
 		
-		// DecoderLayer 类中的 backward 方法
-		void backward(const MatrixXd& grad_output, const MatrixXd& input, const MatrixXd& encoder_output, double learning_rate) {
-			// 前向传播计算中间值（需要重新计算以获取正确的中间值）
-			MatrixXd mha_self_output = mha_self.forward(input);
-			MatrixXd residual1 = input + mha_self_output;
-			MatrixXd mha_cross_output = mha_cross.forward(residual1);
-			MatrixXd residual2 = residual1 + mha_cross_output;
-			MatrixXd ff_output = residual2 * W_ff1;
+		void setCheckpointing(bool enabled) {
+			checkpointing = enabled;
+		}
+		
+		bool getCheckpointing() const {
+			return checkpointing;
+		}
+		
+		// DecoderLayer 类中的 backward 方法，返回损失对输入的梯度；对编码器输出的梯度通过 getEncoderGradient 获取
+		MatrixXd backward(const MatrixXd& grad_output, const MatrixXd& input, const MatrixXd& encoder_output, double learning_rate) {
+			return backward(grad_output, input, singleSequence(input.getRows()), encoder_output, singleSequence(encoder_output.getRows()), learning_rate);
+		}
+		
+		// 批量反向传播：grad_output 的填充行必须为 0
+		MatrixXd backward(const MatrixXd& grad_output, const MatrixXd& input, const SequenceBatch& batch, const MatrixXd& encoder_output,
+		                  const SequenceBatch& memory, double learning_rate) {
+			int dim = input.getCols();
+			int rows = batch.rows();
+			size_t n = static_cast<size_t>(rows) * dim;
 			
-			for (int i = 0; i < ff_output.getRows(); ++i) {
-				for (int j = 0; j < ff_output.getCols(); ++j) {
-					ff_output(i, j) = std::max(0.0, ff_output(i, j));
-				}
+			if (input.getRows() != rows || grad_output.getRows() != rows || grad_output.getCols() != dim
+			        || encoder_output.getRows() != memory.rows() || batch.batch != memory.batch) {
+				throw std::invalid_argument("Matrix dimensions must match for backward.");
 			}
 			
-			ff_output = ff_output * W_ff2;
-			// 反向传播（与之前相同）
-			MatrixXd grad_ff_output = grad_output;
-			MatrixXd grad_ff2 = ff_output.transpose() * grad_ff_output;
-			MatrixXd grad_ff1_output = grad_ff_output * W_ff2.transpose();
+			bool matched = cache.input == input.data() && sameBatch(cache.batch, batch) && cache.memoryInput == encoder_output.data() && sameBatch(cache.memory, memory);
+			ActivationArena* tape = matched ? cache.tape : &activations;
+			size_t position = tape->mark();
 			
-			for (int i = 0; i < grad_ff1_output.getRows(); ++i) {
-				for (int j = 0; j < grad_ff1_output.getCols(); ++j) {
-					if (ff_output(i, j) <= 0) {
-						grad_ff1_output(i, j) = 0;
-					}
-				}
+			if (!matched) {
+				activations.reserve(decoderActivations(batch, memory, dim, mha_self.getView().heads) + ActivationArena::footprint(n));
+				activations.reset();
+				position = 0;
+			}
+			
+			if (!matched || cache.preactivation == nullptr) {
+				save(input.data(), batch, encoder_output.data(), memory, tape->allocate(n), *tape);
 			}
 			
-			MatrixXd grad_ff1 = residual2.transpose() * grad_ff1_output;
-			MatrixXd grad_residual2 = grad_ff1_output * W_ff1.transpose() + grad_output;
-			MatrixXd grad_mha_cross_output = grad_residual2;
-			MatrixXd grad_residual1 = grad_residual2;
-			// 交叉注意力反向传播（使用编码器输出）
-			mha_cross.backward(grad_mha_cross_output, residual1, learning_rate);
-			MatrixXd grad_mha_self_output = grad_residual1;
-			MatrixXd grad_input = grad_residual1;
-			mha_self.backward(grad_mha_self_output, input, learning_rate);
-			W_ff1 -= learning_rate * grad_ff1;
-			W_ff2 -= learning_rate * grad_ff2;
+			MatrixXd grad_input(rows, dim);
+			grad_encoder = MatrixXd(memory.rows(), dim);
+			size_t parameters = decoderParameterCount(dim);
+			scratch.reserve(ActivationArena::footprint(parameters) + decoderBackwardWorkspace(batch, memory, dim, mha_self.getView().heads));
+			scratch.reset();
+			BasicDecoderGradients<double> gradients = packedDecoderGradients(scratch.allocate(parameters), dim);
+			decoderLayerBackward(getView(), cache, grad_output.data(), grad_input.data(), grad_encoder.data(), gradients, scratch);
+			tape->release(position);
+			cache = LayerCache{};
+			PROFILE_SCOPE("DecoderLayer", ProfilePhase::Update, 0.0);
+			mha_self.update(gradients.selfAttention, learning_rate);
+			mha_cross.update(gradients.crossAttention, learning_rate);
+			applyClippedGradient(W_ff1.data(), gradients.dWff1, static_cast<size_t>(dim) * dim, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			applyClippedGradient(W_ff2.data(), gradients.dWff2, static_cast<size_t>(dim) * dim, 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			norm1.update(gradients.norm1, learning_rate);
+			norm2.update(gradients.norm2, learning_rate);
+			norm3.update(gradients.norm3, learning_rate);
+			return grad_input;
+		}
+		
+		// 最近一次 backward 中损失对编码器输出的梯度
+		const MatrixXd& getEncoderGradient() const {
+			return grad_encoder;
 		}
 		
 	private:
@@ -311,6 +1418,20 @@ class DecoderLayer {
 		MultiHeadAttention mha_cross;
 		MatrixXd W_ff1;
 		MatrixXd W_ff2;
+		LayerNorm norm1;
+		LayerNorm norm2;
+		LayerNorm norm3;
+		ActivationArena scratch;
+		ActivationArena activations;
+		LayerCache cache = LayerCache{};
+		MatrixXd grad_encoder;
+		bool checkpointing = false;
+		
+		void save(const double* x, const SequenceBatch& batch, const double* memory, const SequenceBatch& memoryBatch, double* out, ActivationArena& tape) {
+			scratch.reserve(layerSaveWorkspace(batch, W_ff1.getRows(), mha_self.getView().heads));
+			scratch.reset();
+			decoderLayerSave(getView(), x, batch, memory, memoryBatch, out, cache, tape, scratch);
+		}
 };
 
 // Transformer 类
@@ -320,9 +1441,153 @@ class Transformer {
 		DecoderLayer DL;
 		int input_dim;
 		int num_heads;
+		PositionalEncoding positional;
+		int max_length;
+		MatrixXd position_table; // Learned 时的 max_length x input_dim 位置向量表
+		ActivationArena tape; // 训练时每一步的激活带，保存前向传播的中间结果
+		PrecisionPolicy policy = doublePrecision(); // 训练精度
+		LossScaler scaler;
+		MixedPrecisionParameters parameters; // 编码器、解码器与位置向量表的混合精度参数
+		size_t encoderOffset = 0;
+		size_t decoderOffset = 0;
+		size_t positionOffset = 0;
+		BasicActivationArena<float> mixedTape; // 混合精度训练的激活带
+		BasicActivationArena<float> mixedScratch; // 混合精度训练的临时空间
+		
+		// 把位置编码表的梯度累加到 grad 中：序列 batch 中第 t 个有效行对应位置 t
+		template<class T>
+		void accumulatePositionalGradient(const T* grad_input, const SequenceBatch& batch, T* grad) const {
+			for (int b = 0; b < batch.batch; ++b) {
+				for (int t = 0; t < batch.valid(b); ++t) {
+					axpy(grad + static_cast<size_t>(t) * input_dim, grad_input + (static_cast<size_t>(b) * batch.length + t) * input_dim, 1.0, input_dim);
+				}
+			}
+		}
+		
+		// 有效位置的均方误差（在 double 中累加），梯度乘以 scale 后写入 grad（填充位置为 0）
+		template<class T>
+		double maskedSquaredError(const T* output, const MatrixXd& target, const SequenceBatch& batch, T* grad, double scale) const {
+			double loss = 0.0;
+			double count = 0.0;
+			std::fill(grad, grad + static_cast<size_t>(batch.rows()) * input_dim, T(0));
+			
+			for (int b = 0; b < batch.batch; ++b) {
+				count += static_cast<double>(batch.valid(b)) * input_dim;
+			}
+			
+			for (int b = 0; b < batch.batch; ++b) {
+				for (int t = 0; t < batch.valid(b); ++t) {
+					int i = b * batch.length + t;
+					
+					for (int j = 0; j < input_dim; ++j) {
+						size_t k = static_cast<size_t>(i) * input_dim + j;
+						double difference = output[k] - target(i, j);
+						loss += difference * difference;
+						grad[k] = static_cast<T>(2 * difference / count * scale);
+					}
+				}
+			}
+			
+			return loss / count;
+		}
+		
+		// 混合精度的训练步：激活值与梯度为 float，权重读取低精度工作副本；输出梯度乘以损失缩放系数后反向传播，
+		// 整批梯度全部有限时才以缩放系数的倒数更新 double 主权重，否则跳过本步
+		template<class W>
+		double trainBatchMixed(const MatrixXd& encoder_input, const SequenceBatch& encoder, const MatrixXd& decoder_input, const SequenceBatch& decoder,
+		                       const MatrixXd& target, double learning_rate) {
+			if (parameters.empty()) {
+				encoderOffset = EL.bindParameters(parameters);
+				decoderOffset = DL.bindParameters(parameters);
+				
+				if (positional == PositionalEncoding::Learned) {
+					parameters.beginGroup(TRANSFORMER_CLIP_NORM);
+					positionOffset = parameters.add(position_table.data(), static_cast<size_t>(max_length) * input_dim);
+				}
+				
+				parameters.allocate(policy.precision);
+			}
+			
+			const W* working = parameters.template working<W>();
+			BasicEncoderView<W> encoderView = packedEncoderView(working + encoderOffset, input_dim, num_heads);
+			BasicDecoderView<W> decoderView = packedDecoderView(working + decoderOffset, input_dim, num_heads);
+			BasicPositionalView<W> positionalView{positional, max_length, positional == PositionalEncoding::Learned ? working + positionOffset : nullptr};
+			size_t encoderSize = static_cast<size_t>(encoder.rows()) * input_dim;
+			size_t decoderSize = static_cast<size_t>(decoder.rows()) * input_dim;
+			// 激活带：嵌入后的输入、各层输出与输入梯度，以及各层保存的中间结果
+			mixedTape.reserve(4 * ActivationArena::footprint(encoderSize) + 4 * ActivationArena::footprint(decoderSize) + trainingWorkspace(encoder, decoder));
+			mixedScratch.reserve(std::max(std::max(layerSaveWorkspace(encoder, input_dim, num_heads), layerSaveWorkspace(decoder, input_dim, num_heads)),
+			                              std::max(encoderBackwardWorkspace(encoder, input_dim, num_heads), decoderBackwardWorkspace(decoder, encoder, input_dim, num_heads))));
+			mixedTape.reset();
+			mixedScratch.reset();
+			float* encoderEmbedded = mixedTape.allocate(encoderSize);
+			float* decoderEmbedded = mixedTape.allocate(decoderSize);
+			float* encoderOutput = mixedTape.allocate(encoderSize);
+			float* decoderOutput = mixedTape.allocate(decoderSize);
+			float* gradOutput = mixedTape.allocate(decoderSize);
+			float* gradDecoder = mixedTape.allocate(decoderSize);
+			float* gradMemory = mixedTape.allocate(encoderSize);
+			float* gradEncoder = mixedTape.allocate(encoderSize);
+			narrowCopy(encoder_input.data(), encoderEmbedded, encoderSize);
+			narrowCopy(decoder_input.data(), decoderEmbedded, decoderSize);
+			addPositionalEncoding(positionalView, encoderEmbedded, encoder, input_dim);
+			addPositionalEncoding(positionalView, decoderEmbedded, decoder, input_dim);
+			// 前向传播；开启梯度检查点时各层的中间结果随即丢弃，反向传播前再重新计算
+			bool checkpointing = getCheckpointing();
+			BasicLayerCache<float> encoderCache{};
+			BasicLayerCache<float> decoderCache{};
+			size_t position = mixedTape.mark();
+			encoderLayerSave(encoderView, encoderEmbedded, encoder, encoderOutput, encoderCache, mixedTape, mixedScratch);
+			
+			if (checkpointing) {
+				mixedTape.release(position);
+			}
+			
+			size_t decoderPosition = mixedTape.mark();
+			decoderLayerSave(decoderView, decoderEmbedded, decoder, encoderOutput, encoder, decoderOutput, decoderCache, mixedTape, mixedScratch);
+			double scale = scaler.getScale();
+			double loss = maskedSquaredError(decoderOutput, target, decoder, gradOutput, scale);
+			// 反向传播，梯度写入混合精度参数的梯度缓冲（与工作副本同样的布局）
+			float* gradient = parameters.gradient();
+			
+			if (checkpointing) {
+				mixedTape.release(decoderPosition);
+				decoderLayerSave(decoderView, decoderEmbedded, decoder, encoderOutput, encoder, decoderOutput, decoderCache, mixedTape, mixedScratch);
+			}
+			
+			decoderLayerBackward(decoderView, decoderCache, gradOutput, gradDecoder, gradMemory, packedDecoderGradients(gradient + decoderOffset, input_dim), mixedScratch);
+			
+			if (checkpointing) {
+				mixedTape.release(position);
+				encoderLayerSave(encoderView, encoderEmbedded, encoder, encoderOutput, encoderCache, mixedTape, mixedScratch);
+			}
+			
+			encoderLayerBackward(encoderView, encoderCache, gradMemory, gradEncoder, packedEncoderGradients(gradient + encoderOffset, input_dim), mixedScratch);
+			mixedTape.release(position);
+			
+			if (positional == PositionalEncoding::Learned) {
+				float* gradTable = gradient + positionOffset;
+				std::fill(gradTable, gradTable + static_cast<size_t>(max_length) * input_dim, 0.0f);
+				accumulatePositionalGradient(gradEncoder, encoder, gradTable);
+				accumulatePositionalGradient(gradDecoder, decoder, gradTable);
+			}
+			
+			if (scaler.update(parameters.finite())) {
+				parameters.apply(learning_rate, 1.0 / scale);
+			}
+			
+			return loss;
+		}
 		
 	public:
-		Transformer(int input_dim, int num_heads) : MA(input_dim, num_heads), EL(input_dim, num_heads), DL(input_dim, num_heads), input_dim(input_dim), num_heads(num_heads) {}
+		// positional 选择位置编码方式；max_length 只约束 Learned 位置向量表的长度
+		Transformer(int input_dim, int num_heads, PositionalEncoding positional = PositionalEncoding::Sinusoidal, int max_length = 512)
+			: MA(input_dim, num_heads), EL(input_dim, num_heads), DL(input_dim, num_heads), input_dim(input_dim), num_heads(num_heads),
+			  positional(positional), max_length(max_length) {
+			if (positional == PositionalEncoding::Learned) {
+				position_table = MatrixXd::Random(max_length, input_dim) * 0.02;
+			}
+		}
 		
 		~Transformer() {}
 		
@@ -339,51 +1604,191 @@ class Transformer {
 			return loss / (output.getRows() * output.getCols());
 		}
 		
+		// 只统计有效位置的均方误差损失，并把对应的梯度写入 grad_output（填充位置为 0）
+		double masked_mse_loss(const MatrixXd& output, const MatrixXd& target, const SequenceBatch& batch, MatrixXd& grad_output) {
+			int dim = output.getCols();
+			grad_output = MatrixXd(output.getRows(), dim);
+			return maskedSquaredError(output.data(), target, batch, grad_output.data(), 1.0);
+		}
+		
+		// 对一批补齐后的序列做一次前向与反向传播，返回本批的平均损失
+		// 编码器输入按 encoder 描述的方式存放，解码器输入与目标按 decoder 描述的方式存放，填充行应为 0
+		double trainBatch(const MatrixXd& encoder_input, const SequenceBatch& encoder, const MatrixXd& decoder_input, const SequenceBatch& decoder,
+		                  const MatrixXd& target, double learning_rate) {
+			PROFILE_STEP("Transformer::trainBatch");
+			
+			if (policy.precision == Precision::Float32) {
+				return trainBatchMixed<float>(encoder_input, encoder, decoder_input, decoder, target, learning_rate);
+			}
+			
+			if (policy.precision == Precision::BFloat16) {
+				return trainBatchMixed<bfloat16>(encoder_input, encoder, decoder_input, decoder, target, learning_rate);
+			}
+			
+			tape.reserve(trainingWorkspace(encoder, decoder));
+			// 叠加位置编码后的输入要一直保留到反向传播结束
+			MatrixXd encoder_embedded = encoder_input;
+			MatrixXd decoder_embedded = decoder_input;
+			addPositionalEncoding(getPositional(), encoder_embedded.data(), encoder, input_dim);
+			addPositionalEncoding(getPositional(), decoder_embedded.data(), decoder, input_dim);
+			// 前向传播，中间结果保存在本步的激活带中
+			tape.reset();
+			MatrixXd encoder_output = EL.forward(encoder_embedded, encoder, tape);
+			MatrixXd decoder_output = DL.forward(decoder_embedded, decoder, encoder_output, encoder, tape);
+			// 计算损失
+			MatrixXd grad_output;
+			double loss = masked_mse_loss(decoder_output, target, decoder, grad_output);
+			// 反向传播
+			MatrixXd grad_decoder = DL.backward(grad_output, decoder_embedded, decoder, encoder_output, encoder, learning_rate);
+			MatrixXd grad_encoder = EL.backward(DL.getEncoderGradient(), encoder_embedded, encoder, learning_rate);
+			
+			if (positional == PositionalEncoding::Learned) {
+				// 位置向量直接加在输入上，其梯度就是各位置上输入梯度之和
+				MatrixXd grad_table(max_length, input_dim);
+				accumulatePositionalGradient(grad_encoder.data(), encoder, grad_table.data());
+				accumulatePositionalGradient(grad_decoder.data(), decoder, grad_table.data());
+				PROFILE_SCOPE("PositionalEncoding", ProfilePhase::Update, 0.0);
+				applyClippedGradient(position_table.data(), grad_table.data(), grad_table.getRows() * static_cast<size_t>(input_dim), 1.0, learning_rate, TRANSFORMER_CLIP_NORM);
+			}
+			
+			return loss;
+		}
+		
+		double trainBatch(const SequenceMiniBatch& batch, double learning_rate) {
+			return trainBatch(batch.encoder_input, batch.encoderBatch(), batch.decoder_input, batch.decoderBatch(), batch.target, learning_rate);
+		}
+		
 		void train(const MatrixXd& encoder_input, const MatrixXd& decoder_input, const MatrixXd& target, int epochs, double learning_rate) {
 			for (int epoch = 0; epoch < epochs; ++epoch) {
-				// 前向传播
-				MatrixXd encoder_output = EL.forward(encoder_input);
-				MatrixXd decoder_output = DL.forward(decoder_input, encoder_output);
-				// 计算损失
-				double loss = mse_loss(decoder_output, target);
+				double loss = trainBatch(encoder_input, singleSequence(encoder_input.getRows()), decoder_input, singleSequence(decoder_input.getRows()),
+				                         target, learning_rate);
 				
 				// 打印更多监控信息
 				if (epoch % 100 == 0) {
 					std::cout << "Epoch " << epoch << ", Loss: " << loss << std::endl;
-					// 检查是否有 nan
-					bool has_nan = false;
 					
-					for (int i = 0; i < decoder_output.getRows(); ++i) {
-						for (int j = 0; j < decoder_output.getCols(); ++j) {
-							if (std::isnan(decoder_output(i, j))) {
-								has_nan = true;
-								break;
-							}
-						}
-						
-						if (has_nan)
-							break;
+					// 检查是否有 nan
+					if (std::isnan(loss)) {
+						std::cout << "警告: 输出中检测到 NaN!" << std::endl;
 					}
+				}
+			}
+		}
+		
+		// 按 mini-batch 训练整个数据集：每轮重新分桶，依次训练各批
+		void train(MiniBatchIterator& batches, int epochs, double learning_rate) {
+			SequenceMiniBatch batch;
+			
+			for (int epoch = 0; epoch < epochs; ++epoch) {
+				double total = 0.0;
+				int count = 0;
+				batches.reset();
+				
+				while (batches.next(batch)) {
+					total += trainBatch(batch, learning_rate);
+					++count;
+				}
+				
+				if (epoch % 100 == 0) {
+					std::cout << "Epoch " << epoch << ", Loss: " << total / std::max(count, 1) << std::endl;
 					
-					if (has_nan) {
+					if (std::isnan(total)) {
 						std::cout << "警告: 输出中检测到 NaN!" << std::endl;
-						// 可以在这里添加调试代码，例如打印中间值
 					}
 				}
-				
-				// 反向传播
-				MatrixXd grad_output = 2 * (decoder_output - target) / (decoder_output.getRows() * decoder_output.getCols());
-				DL.backward(grad_output, decoder_input, encoder_output, learning_rate);
-				EL.backward(grad_output, encoder_input, learning_rate);
 			}
 		}
 		
 		// 推理方法
 		MatrixXd inference(const MatrixXd& encoder_input, const MatrixXd& decoder_input) {
+			MatrixXd encoder_embedded = encoder_input;
+			MatrixXd decoder_embedded = decoder_input;
+			addPositionalEncoding(getPositional(), encoder_embedded.data(), singleSequence(encoder_input.getRows()), input_dim);
+			addPositionalEncoding(getPositional(), decoder_embedded.data(), singleSequence(decoder_input.getRows()), input_dim);
 			// 编码器前向传播
-			MatrixXd encoder_output = EL.forward(encoder_input);
+			MatrixXd encoder_output = EL.forward(encoder_embedded);
 			// 解码器前向传播
-			MatrixXd decoder_output = DL.forward(decoder_input, encoder_output);
+			MatrixXd decoder_output = DL.forward(decoder_embedded, encoder_output);
 			return decoder_output;
 		}
+		
+		const EncoderLayer& getEncoder() const {
+			return EL;
+		}
+		
+		const DecoderLayer& getDecoder() const {
+			return DL;
+		}
+		
+		int getInputDim() const {
+			return input_dim;
+		}
+		
+		int getNumHeads() const {
+			return num_heads;
+		}
+		
+		// 位置编码的只读视图
+		PositionalView getPositional() const {
+			return PositionalView{positional, max_length, positional == PositionalEncoding::Learned ? position_table.data() : nullptr};
+		}
+		
+		// 开启或关闭梯度检查点：开启后各层只在自己的反向传播期间占用激活带，
+		// 峰值内存从所有层的中间结果之和降到单层的大小，代价是每层多做一次前向计算
+		void setCheckpointing(bool enabled) {
+			EL.setCheckpointing(enabled);
+			DL.setCheckpointing(enabled);
+		}
+		
+		bool getCheckpointing() const {
+			return EL.getCheckpointing();
+		}
+		
+		// 一个训练步所需的激活带大小（以 double 计）
+		size_t trainingWorkspace(const SequenceBatch& encoder_batch, const SequenceBatch& decoder_batch) const {
+			size_t encoder = encoderActivations(encoder_batch, input_dim, num_heads);
+			size_t decoder = decoderActivations(decoder_batch, encoder_batch, input_dim, num_heads);
+			
+			if (getCheckpointing()) {
+				// 重新计算时还需要一块层输出的空间
+				return std::max(encoder + ActivationArena::footprint(static_cast<size_t>(encoder_batch.rows()) * input_dim),
+				                decoder + ActivationArena::footprint(static_cast<size_t>(decoder_batch.rows()) * input_dim));
+			}
+			
+			return encoder + decoder;
+		}
+		
+		const ActivationArena& getTape() const {
+			return tape;
+		}
+		
+		// 设置训练精度；Float32/BFloat16 时 trainBatch 在 float 上计算，主权重仍为 double，推理与序列化不受影响
+		void setPrecision(const PrecisionPolicy& precision) {
+			policy = precision;
+			scaler = LossScaler(precision);
+			parameters.clear();
+		}
+		
+		const PrecisionPolicy& getPrecision() const {
+			return policy;
+		}
+		
+		const LossScaler& getLossScaler() const {
+			return scaler;
+		}
+		
+		// 从权重视图拷贝编码器、解码器与位置编码的权重
+		void loadWeights(const EncoderView& encoder, const DecoderView& decoder, const PositionalView& positional_view) {
+			if (positional_view.kind != positional || positional_view.maxLength != max_length) {
+				throw std::invalid_argument("Positional encoding does not match the model.");
+			}
+			
+			EL.loadWeights(encoder);
+			DL.loadWeights(decoder);
+			parameters.clear();
+			
+			if (positional == PositionalEncoding::Learned) {
+				std::copy(positional_view.table, positional_view.table + static_cast<size_t>(max_length) * input_dim, position_table.data());
+			}
+		}
 };